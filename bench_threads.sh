@@ -0,0 +1,28 @@
+#!/bin/bash
+# Training throughput by number of threads, with per-vector locks and in Hogwild mode.
+# usage: bench_threads.sh <dataset> [iterations] [thread counts...]
+# Prints words/sec of the whole training as reported by the tool at the end of training.
+# Numbers are meaningful only while thread count doesn't exceed number of cores.
+
+DATASET=$1
+ITERATIONS=${2:-1}
+THREADS=${@:3}
+THREADS=${THREADS:-1 2 4 8 16 32 64}
+BINARY=${BINARY:-./source/doc2vec}
+
+if [ -z "$DATASET" ]; then
+  echo "usage: bench_threads.sh <dataset> [iterations] [thread counts...]"
+  exit 1
+fi
+
+echo "cores: $(nproc), dataset: $DATASET, iterations: $ITERATIONS"
+printf "%8s %16s %16s\n" threads "locks, kw/s" "hogwild, kw/s"
+for t in $THREADS; do
+  row=""
+  for mode in "" "--hogwild"; do
+    speed=$($BINARY train --data "$DATASET" --iter "$ITERATIONS" --thread "$t" $mode 2>&1 \
+      | tr '\r' '\n' | grep -o 'Words/Sec: [0-9.]*' | tail -1 | cut -d' ' -f2)
+    row="$row $(printf "%16s" "$speed")"
+  done
+  printf "%8s%s\n" "$t" "$row"
+done
@@ -4,34 +4,38 @@
 #include <set>
 #include <cassert>
 #include <cmath>
+#include <algorithm>
 
 using namespace std;
 
-double VectorSimilarity(const TLayerVector<double>& vec1, const TLayerVector<double>& vec2) {
+template <typename T>
+double VectorSimilarity(const TLayerVector<T>& vec1, const TLayerVector<T>& vec2) {
     assert(vec1.Size() == vec2.Size());
-    double res = 0;
-    for (size_t i = 0; i < vec1.Size(); ++i)
-        res += vec1[i] * vec2[i];
-    return res;
+    return GetVectorKernels<T>().Dot(vec1.Begin(), vec2.Begin(), vec1.Size());
 }
 
 
-double VectorDistance(const TLayerVector<double>& vec1, const TLayerVector<double>& vec2) {
+template <typename T>
+double VectorDistance(const TLayerVector<T>& vec1, const TLayerVector<T>& vec2) {
     assert(vec1.Size() == vec2.Size());
-    double res = 0;
+    T res = 0;
     for (size_t i = 0; i < vec1.Size(); ++i)
         res += pow(vec1[i] - vec2[i], 2);
     return sqrt(res);
 }
 
-vector<TSimilarObject> FindSimilarObjects(unsigned int targetIndex, const TLayer<double>& layer, unsigned int num) {
+template <typename T>
+vector<TSimilarObject> FindSimilarObjects(unsigned int targetIndex, const TLayer<T>& layer, unsigned int num) {
     set<TSimilarObject> heap;
-    const auto& targetVec = layer[targetIndex];
+    if (targetIndex >= layer.Size())
+        throw runtime_error("FindSimilarObjects - out of range");
+    const TVectorKernels<T>& kernels = GetVectorKernels<T>(layer.Dim());
+    const T* targetVec = layer.Row(targetIndex);
     for (size_t i = 0; i < layer.Size(); ++i) {
         if (i == targetIndex)
             continue;
 
-        double similarity = VectorSimilarity(targetVec, layer[i]);
+        T similarity = kernels.Dot(targetVec, layer.Row(i), layer.Dim());
         if (heap.size() < num) {
             heap.insert(TSimilarObject(similarity, i));
         } else {
@@ -44,52 +48,160 @@ vector<TSimilarObject> FindSimilarObjects(unsigned int targetIndex, const TLayer
     return vector<TSimilarObject>(heap.rbegin(), heap.rend());
 }
 
-vector<TSimilarWordObject> FindSimilarWords(const TDoc2Vec& doc2VecModel, const string& word, unsigned int num) {
+template <typename TIndex, typename T>
+vector<TSimilarObject> FindSimilarObjects(
+    unsigned int targetIndex,
+    const TIndex& index,
+    const TLayer<T>& layer,
+    unsigned int num,
+    unsigned int rerankNum
+) {
+    if (targetIndex >= layer.Size() || index.Size() != layer.Size())
+        throw runtime_error("FindSimilarObjects - out of range");
+    const T* targetVec = layer.Row(targetIndex);
+    vector<float> query(targetVec, targetVec + layer.Dim());
+    vector<float> scores;
+    index.Score(query.data(), scores);
+
+    vector<TSimilarObject> candidates;
+    candidates.reserve(layer.Size());
+    for (size_t i = 0; i < layer.Size(); ++i) {
+        if (i != targetIndex)
+            candidates.emplace_back(scores[i], i);
+    }
+    auto greater = [](const TSimilarObject& lhs, const TSimilarObject& rhs) {
+        return rhs < lhs;
+    };
+    size_t candidateNum = min(candidates.size(), static_cast<size_t>(max(num, rerankNum)));
+    partial_sort(candidates.begin(), candidates.begin() + candidateNum, candidates.end(), greater);
+    candidates.erase(candidates.begin() + candidateNum, candidates.end());
+
+    if (rerankNum > 0) {
+        const TVectorKernels<T>& kernels = GetVectorKernels<T>(layer.Dim());
+        for (auto& candidate : candidates)
+            candidate.Similarity = kernels.Dot(targetVec, layer.Row(candidate.Index), layer.Dim());
+        sort(candidates.begin(), candidates.end(), greater);
+    }
+    if (candidates.size() > num)
+        candidates.erase(candidates.begin() + num, candidates.end());
+    return candidates;
+}
+
+template <typename T>
+void PrintVector(const TLayerVector<T>& vec) {
+    ostream_iterator<T> outIt(cout, " ");
+    copy(vec.Begin(), vec.End(), outIt);
+    cout << endl;
+}
+
+vector<TSimilarWordObject> FindSimilarWords(const TDoc2Vec& doc2VecModel, const string& word, unsigned int num, unsigned int rerankNum) {
     vector<TSimilarWordObject> res;
     TWord wordStruct;
-    const auto& wordsVoc = doc2VecModel.GetWordsVocabulary();
-    const auto& neuralNetwork = doc2VecModel.GetNeuralNetwork();
+    unsigned int wordIndex;
     auto normWord = NormalizeWord(word);
 
-    if (!wordsVoc.GetWord(normWord, wordStruct))
+    if (!doc2VecModel.GetWordIndex(normWord, wordIndex))
         return res;
 
-    const auto& layer = neuralNetwork.GetWordsNormLayer();
-    auto similarObjects = FindSimilarObjects(wordStruct.Index, layer, num);
+    vector<TSimilarObject> similarObjects;
+    const TQuantizedLayer* quantizedLayer = doc2VecModel.GetWordsQuantizedLayer();
+    if (doc2VecModel.GetPrecision() == EPrecision::Float) {
+        const auto& layer = doc2VecModel.GetNeuralNetwork<float>().GetWordsNormLayer();
+        similarObjects = quantizedLayer
+            ? FindSimilarObjects(wordIndex, *quantizedLayer, layer, num, rerankNum)
+            : FindSimilarObjects(wordIndex, layer, num);
+    } else {
+        const auto& layer = doc2VecModel.GetNeuralNetwork<double>().GetWordsNormLayer();
+        similarObjects = quantizedLayer
+            ? FindSimilarObjects(wordIndex, *quantizedLayer, layer, num, rerankNum)
+            : FindSimilarObjects(wordIndex, layer, num);
+    }
 
     for (const auto& similarObject : similarObjects) {
-        if (!wordsVoc.GetWord(similarObject.Index, wordStruct))
+        if (!doc2VecModel.GetWord(similarObject.Index, wordStruct))
             throw runtime_error("Cannot find object by index.");
         res.emplace_back(wordStruct, similarObject);
     }
     return res;
 }
 
-vector<TSimilarDocumentObject> FindSimilarDocs(const TDoc2Vec& doc2VecModel, unsigned int docIndex, unsigned int num) {
+template <typename T>
+vector<TSimilarObject> FindSimilarDocObjects(
+    const TDoc2Vec& doc2VecModel,
+    const TLayer<T>& layer,
+    unsigned int docIndex,
+    unsigned int num,
+    unsigned int rerankNum
+) {
+    if (doc2VecModel.GetDocsIndex())
+        return FindSimilarObjects(docIndex, *doc2VecModel.GetDocsIndex(), layer, num, rerankNum);
+    if (doc2VecModel.GetDocsQuantizedLayer())
+        return FindSimilarObjects(docIndex, *doc2VecModel.GetDocsQuantizedLayer(), layer, num, rerankNum);
+    return FindSimilarObjects(docIndex, layer, num);
+}
+
+template <typename T>
+double EvaluateIndexRecall(const TProductQuantizer& index, const TLayer<T>& layer, unsigned int k, unsigned int queryNum, unsigned int rerankNum) {
+    queryNum = min(queryNum, layer.Size());
+    if (queryNum == 0 || k == 0)
+        return 0;
+    size_t found = 0, total = 0;
+    for (unsigned int q = 0; q < queryNum; ++q) {
+        unsigned int targetIndex = static_cast<unsigned long long>(q) * layer.Size() / queryNum;
+        auto exact = FindSimilarObjects(targetIndex, layer, k);
+        auto approximate = FindSimilarObjects(targetIndex, index, layer, k, rerankNum);
+        set<unsigned int> exactIndexes;
+        for (const auto& object : exact)
+            exactIndexes.insert(object.Index);
+        for (const auto& object : approximate)
+            found += exactIndexes.count(object.Index);
+        total += exact.size();
+    }
+    return total > 0 ? static_cast<double>(found) / total : 0;
+}
+
+double EvaluateDocsIndexRecall(const TDoc2Vec& doc2VecModel, unsigned int k, unsigned int queryNum, unsigned int rerankNum) {
+    const TProductQuantizer* index = doc2VecModel.GetDocsIndex();
+    if (!index)
+        throw runtime_error("EvaluateDocsIndexRecall - model doesn't have documents index.");
+    if (doc2VecModel.GetPrecision() == EPrecision::Float)
+        return EvaluateIndexRecall(*index, doc2VecModel.GetNeuralNetwork<float>().GetDocsNormLayer(), k, queryNum, rerankNum);
+    return EvaluateIndexRecall(*index, doc2VecModel.GetNeuralNetwork<double>().GetDocsNormLayer(), k, queryNum, rerankNum);
+}
+
+void PrintDocsIndexRecall(const TDoc2Vec& doc2VecModel) {
+    cout << "Documents index recall@" << PQ_RECALL_NUM << " over " << PQ_RECALL_QUERY_NUMBER << " queries:" << endl;
+    for (unsigned int rerankNum : {0u, PQ_RECALL_NUM * 10}) {
+        cout << '\t' << "rerank " << rerankNum << ": "
+            << EvaluateDocsIndexRecall(doc2VecModel, PQ_RECALL_NUM, PQ_RECALL_QUERY_NUMBER, rerankNum) << endl;
+    }
+}
+
+vector<TSimilarDocumentObject> FindSimilarDocs(const TDoc2Vec& doc2VecModel, unsigned int docIndex, unsigned int num, unsigned int rerankNum) {
     vector<TSimilarDocumentObject> res;
-    const auto& neuralNetwork = doc2VecModel.GetNeuralNetwork();
-    const auto& docsHolder = doc2VecModel.GetDocsHolder();
-    const auto& layer = neuralNetwork.GetDocsNormLayer();
 
-    auto similarObjects = FindSimilarObjects(docIndex, layer, num);
+    vector<TSimilarObject> similarObjects;
+    if (doc2VecModel.GetPrecision() == EPrecision::Float) {
+        similarObjects = FindSimilarDocObjects(doc2VecModel, doc2VecModel.GetNeuralNetwork<float>().GetDocsNormLayer(), docIndex, num, rerankNum);
+    } else {
+        similarObjects = FindSimilarDocObjects(doc2VecModel, doc2VecModel.GetNeuralNetwork<double>().GetDocsNormLayer(), docIndex, num, rerankNum);
+    }
     for (const auto& similarObject : similarObjects) {
-        const auto& doc = docsHolder.GetDocument(similarObject.Index);
-        res.emplace_back(doc, similarObject);
+        res.emplace_back(doc2VecModel.GetDocument(similarObject.Index), similarObject);
     }
     return res;
 }
 
-void FindAndPrintSimilarWords(const TDoc2Vec& doc2VecModel, const string& word, unsigned int num) {
-    TWord wordStruct;
-    const auto& wordsVoc = doc2VecModel.GetWordsVocabulary();
+void FindAndPrintSimilarWords(const TDoc2Vec& doc2VecModel, const string& word, unsigned int num, unsigned int rerankNum) {
+    unsigned int wordIndex;
     auto normWord = NormalizeWord(word);
 
-    if (!wordsVoc.GetWord(normWord, wordStruct)) {
+    if (!doc2VecModel.GetWordIndex(normWord, wordIndex)) {
         cout << "Word " << '"' << word << '"' << " isn't in vocabulary." << endl;
         return;
     }
 
-    auto similarWords = FindSimilarWords(doc2VecModel, word, num);
+    auto similarWords = FindSimilarWords(doc2VecModel, word, num, rerankNum);
     cout << '"' << word << '"' << " similar words:" << endl;
     if (similarWords.empty()) {
         cout << "No similar words were found" << endl;
@@ -99,9 +211,9 @@ void FindAndPrintSimilarWords(const TDoc2Vec& doc2VecModel, const string& word,
         cout << "\t" << '"' << simWord.Word.Word << '"' << " -> " << simWord.Similarity << endl;
 }
 
-void FindAndPrintSimilarDocs(const TDoc2Vec& doc2VecModel, unsigned int docIndex, unsigned int num) {
-    auto similarDocs = FindSimilarDocs(doc2VecModel, docIndex, num);
-    const auto& doc = doc2VecModel.GetDocsHolder().GetDocument(docIndex);
+void FindAndPrintSimilarDocs(const TDoc2Vec& doc2VecModel, unsigned int docIndex, unsigned int num, unsigned int rerankNum) {
+    auto similarDocs = FindSimilarDocs(doc2VecModel, docIndex, num, rerankNum);
+    const auto& doc = doc2VecModel.GetDocument(docIndex);
     cout << "Document:" << endl;
     cout << '"' << doc->GetRawDocument() << '"' << endl << endl;
 
@@ -116,46 +228,54 @@ void FindAndPrintSimilarDocs(const TDoc2Vec& doc2VecModel, unsigned int docIndex
     }
 }
 
-void FindAndPrintSimilarDocs(const TDoc2Vec& doc2VecModel, const std::string& docTag, unsigned int num) {
-    const auto& docsHolder = doc2VecModel.GetDocsHolder();
-    TDocument doc;
-    if (!docsHolder.GetDocument(docTag, doc)) {
+void FindAndPrintSimilarDocs(const TDoc2Vec& doc2VecModel, const std::string& docTag, unsigned int num, unsigned int rerankNum) {
+    unsigned int docIndex;
+    if (!doc2VecModel.GetDocumentIndex(docTag, docIndex)) {
         cout << "No document with tag " << '"' << docTag << '"' << "." << endl;
         return;
     }
-    FindAndPrintSimilarDocs(doc2VecModel, doc.GetIndex(), num);
+    FindAndPrintSimilarDocs(doc2VecModel, docIndex, num, rerankNum);
 }
 
 void PrintWordVector(const TDoc2Vec& doc2VecModel, const std::string& word) {
-    TWord wordStruct;
-    const auto& wordsVoc = doc2VecModel.GetWordsVocabulary();
-    const auto& neuralNetwork = doc2VecModel.GetNeuralNetwork();
+    unsigned int wordIndex;
     auto normWord = NormalizeWord(word);
 
-    if (!wordsVoc.GetWord(normWord, wordStruct)) {
+    if (!doc2VecModel.GetWordIndex(normWord, wordIndex)) {
         cout << "Word " << '"' << word << '"' << " isn't in vocabulary." << endl;
         return;
     }
 
-    const auto& wordVector = neuralNetwork.GetWordNormVector(wordStruct.Index);
     cout << "Vector for word " << '"' << word << '"' << ":" << endl;
-    ostream_iterator<double> outIt(cout, " ");
-    copy(wordVector.Begin(), wordVector.End(), outIt);
-    cout << endl;
+    if (doc2VecModel.GetPrecision() == EPrecision::Float) {
+        PrintVector(doc2VecModel.GetNeuralNetwork<float>().GetWordNormVector(wordIndex));
+    } else {
+        PrintVector(doc2VecModel.GetNeuralNetwork<double>().GetWordNormVector(wordIndex));
+    }
 }
 
 void PrintDocVector(const TDoc2Vec& doc2VecModel, const std::string& docTag) {
-    const auto& docsHolder = doc2VecModel.GetDocsHolder();
-    TDocument doc;
-    if (!docsHolder.GetDocument(docTag, doc)) {
+    unsigned int docIndex;
+    if (!doc2VecModel.GetDocumentIndex(docTag, docIndex)) {
         cout << "No document with tag " << '"' << docTag << '"' << "." << endl;
         return;
     }
 
-    const auto& neuralNetwork = doc2VecModel.GetNeuralNetwork();
-    const auto& docVector = neuralNetwork.GetDocumentNormVector(doc.GetIndex());
     cout << "Vector for document " << '"' << docTag << '"' << ":" << endl;
-    ostream_iterator<double> outIt(cout, " ");
-    copy(docVector.Begin(), docVector.End(), outIt);
-    cout << endl;
+    if (doc2VecModel.GetPrecision() == EPrecision::Float) {
+        PrintVector(doc2VecModel.GetNeuralNetwork<float>().GetDocumentNormVector(docIndex));
+    } else {
+        PrintVector(doc2VecModel.GetNeuralNetwork<double>().GetDocumentNormVector(docIndex));
+    }
 }
+
+template double VectorSimilarity(const TLayerVector<float>&, const TLayerVector<float>&);
+template double VectorSimilarity(const TLayerVector<double>&, const TLayerVector<double>&);
+template double VectorDistance(const TLayerVector<float>&, const TLayerVector<float>&);
+template double VectorDistance(const TLayerVector<double>&, const TLayerVector<double>&);
+template vector<TSimilarObject> FindSimilarObjects(unsigned int, const TLayer<float>&, unsigned int);
+template vector<TSimilarObject> FindSimilarObjects(unsigned int, const TLayer<double>&, unsigned int);
+template vector<TSimilarObject> FindSimilarObjects(unsigned int, const TQuantizedLayer&, const TLayer<float>&, unsigned int, unsigned int);
+template vector<TSimilarObject> FindSimilarObjects(unsigned int, const TQuantizedLayer&, const TLayer<double>&, unsigned int, unsigned int);
+template vector<TSimilarObject> FindSimilarObjects(unsigned int, const TProductQuantizer&, const TLayer<float>&, unsigned int, unsigned int);
+template vector<TSimilarObject> FindSimilarObjects(unsigned int, const TProductQuantizer&, const TLayer<double>&, unsigned int, unsigned int);
@@ -2,14 +2,19 @@
 #include "NeuralNetwork.h"
 #include "Vocabulary.h"
 #include "Doc2Vec.h"
+#include "Quantization.h"
+#include "ProductQuantization.h"
+#include "VectorKernels.h"
 
 #include <vector>
 #include <cassert>
 #include <cmath>
 #include <memory>
 
-double VectorSimilarity(const TLayerVector<double>& vec1, const TLayerVector<double>& vec2);
-double VectorDistance(const TLayerVector<double>& vec1, const TLayerVector<double>& vec2);
+template <typename T>
+double VectorSimilarity(const TLayerVector<T>& vec1, const TLayerVector<T>& vec2);
+template <typename T>
+double VectorDistance(const TLayerVector<T>& vec1, const TLayerVector<T>& vec2);
 
 struct TSimilarObject {
     TSimilarObject(double similarity, unsigned int index)
@@ -43,14 +48,31 @@ struct TSimilarDocumentObject: public TSimilarObject {
     std::shared_ptr<TDocument> Document;
 };
 
-std::vector<TSimilarObject> FindSimilarObjects(const std::vector<double>& targetVec, const TLayer<double>& layer, unsigned int num);
+template <typename T>
+std::vector<TSimilarObject> FindSimilarObjects(unsigned int targetIndex, const TLayer<T>& layer, unsigned int num);
+// Scans compressed index (TQuantizedLayer or TProductQuantizer),
+// then if rerankNum > 0 the best max(num, rerankNum) candidates are rescored against exact layer
+template <typename TIndex, typename T>
+std::vector<TSimilarObject> FindSimilarObjects(
+    unsigned int targetIndex,
+    const TIndex& index,
+    const TLayer<T>& layer,
+    unsigned int num,
+    unsigned int rerankNum
+);
 
-std::vector<TSimilarWordObject> FindSimilarWords(const TDoc2Vec& doc2VecModel, const std::string& word, unsigned int num);
-std::vector<TSimilarDocumentObject> FindSimilarDocs(const TDoc2Vec& doc2VecModel, unsigned int docIndex, unsigned int num);
+// Compressed vectors are used when model has them: product quantization index for documents,
+// then quantized layers, see TDoc2Vec::BuildDocsIndex and TDoc2Vec::Quantize
+std::vector<TSimilarWordObject> FindSimilarWords(const TDoc2Vec& doc2VecModel, const std::string& word, unsigned int num, unsigned int rerankNum = DEFAULT_RERANK_NUMBER);
+std::vector<TSimilarDocumentObject> FindSimilarDocs(const TDoc2Vec& doc2VecModel, unsigned int docIndex, unsigned int num, unsigned int rerankNum = DEFAULT_RERANK_NUMBER);
 
-void FindAndPrintSimilarWords(const TDoc2Vec& doc2VecModel, const std::string& word, unsigned int num);
-void FindAndPrintSimilarDocs(const TDoc2Vec& doc2VecModel, unsigned int docIndex, unsigned int num);
-void FindAndPrintSimilarDocs(const TDoc2Vec& doc2VecModel, const std::string& docTag, unsigned int num);
+void FindAndPrintSimilarWords(const TDoc2Vec& doc2VecModel, const std::string& word, unsigned int num, unsigned int rerankNum = DEFAULT_RERANK_NUMBER);
+void FindAndPrintSimilarDocs(const TDoc2Vec& doc2VecModel, unsigned int docIndex, unsigned int num, unsigned int rerankNum = DEFAULT_RERANK_NUMBER);
+void FindAndPrintSimilarDocs(const TDoc2Vec& doc2VecModel, const std::string& docTag, unsigned int num, unsigned int rerankNum = DEFAULT_RERANK_NUMBER);
+
+// Recall@k of search with documents index against exact scan, averaged over queryNum documents
+double EvaluateDocsIndexRecall(const TDoc2Vec& doc2VecModel, unsigned int k, unsigned int queryNum, unsigned int rerankNum);
+void PrintDocsIndexRecall(const TDoc2Vec& doc2VecModel);
 
 void PrintWordVector(const TDoc2Vec& doc2VecModel, const std::string& word);
 void PrintDocVector(const TDoc2Vec& doc2VecModel, const std::string& docTag);
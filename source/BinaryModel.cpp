@@ -0,0 +1,220 @@
+#include "BinaryModel.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+bool IsBinaryModel(const string& filename) {
+    ifstream in(filename, ios::binary);
+    char magic[sizeof(BINARY_MODEL_MAGIC)];
+    if (!in.read(magic, sizeof(magic)))
+        return false;
+    return memcmp(magic, BINARY_MODEL_MAGIC, sizeof(magic)) == 0;
+}
+
+TBinaryModelWriter::TBinaryModelWriter(ofstream& out)
+    : Out(out)
+    , Position(0)
+{
+    // Header is rewritten by Finish, when section table offset is known
+    TBinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    Write(&header, sizeof(header));
+}
+
+void TBinaryModelWriter::BeginSection(EBinarySection id, uint32_t elementSize, uint64_t rows, uint64_t dim, uint64_t stride) {
+    Align();
+    TBinarySection section;
+    section.Id = static_cast<uint32_t>(id);
+    section.ElementSize = elementSize;
+    section.Offset = Position;
+    section.Size = 0;
+    section.Rows = rows;
+    section.Dim = dim;
+    section.Stride = stride;
+    Sections.push_back(section);
+}
+
+void TBinaryModelWriter::Write(const void* data, size_t bytes) {
+    Out.write(static_cast<const char*>(data), bytes);
+    if (!Out)
+        throw runtime_error("TBinaryModelWriter::Write - cannot write model.");
+    Position += bytes;
+}
+
+void TBinaryModelWriter::EndSection() {
+    Sections.back().Size = Position - Sections.back().Offset;
+}
+
+void TBinaryModelWriter::Align() {
+    static const char zeros[BINARY_SECTION_ALIGNMENT] = {};
+    size_t padding = (BINARY_SECTION_ALIGNMENT - Position % BINARY_SECTION_ALIGNMENT) % BINARY_SECTION_ALIGNMENT;
+    Write(zeros, padding);
+}
+
+void TBinaryModelWriter::Finish() {
+    Align();
+    TBinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.Magic, BINARY_MODEL_MAGIC, sizeof(header.Magic));
+    header.Version = BINARY_MODEL_VERSION;
+    header.ByteOrderMark = BINARY_BYTE_ORDER_MARK;
+    header.SectionCount = Sections.size();
+    header.SectionTableOffset = Position;
+    Write(Sections.data(), Sections.size() * sizeof(TBinarySection));
+
+    Out.seekp(0);
+    Out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    Out.seekp(0, ios::end);
+    if (!Out)
+        throw runtime_error("TBinaryModelWriter::Finish - cannot write model.");
+}
+
+TBinaryModelReader::TBinaryModelReader(const string& filename)
+    : Data(nullptr)
+    , Size(0)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw runtime_error("Cannot open file <" + filename + ">.");
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(TBinaryHeader)) {
+        close(fd);
+        throw runtime_error("TBinaryModelReader - wrong model file <" + filename + ">.");
+    }
+    Size = st.st_size;
+    void* ptr = mmap(nullptr, Size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED)
+        throw runtime_error("TBinaryModelReader - cannot map file <" + filename + ">.");
+    Data = static_cast<const char*>(ptr);
+
+    // Copy stays valid for error messages after the file is unmapped
+    const TBinaryHeader header = *reinterpret_cast<const TBinaryHeader*>(Data);
+    if (memcmp(header.Magic, BINARY_MODEL_MAGIC, sizeof(header.Magic)) != 0
+        || header.ByteOrderMark != BINARY_BYTE_ORDER_MARK
+    ) {
+        munmap(ptr, Size);
+        throw runtime_error("TBinaryModelReader - wrong header.");
+    }
+    if (header.Version != BINARY_MODEL_VERSION) {
+        munmap(ptr, Size);
+        throw runtime_error("TBinaryModelReader - unsupported version " + to_string(header.Version) + ".");
+    }
+    if (header.SectionTableOffset + header.SectionCount * sizeof(TBinarySection) > Size) {
+        munmap(ptr, Size);
+        throw runtime_error("TBinaryModelReader - truncated model file.");
+    }
+    const TBinarySection* sections = reinterpret_cast<const TBinarySection*>(Data + header.SectionTableOffset);
+    Sections.assign(sections, sections + header.SectionCount);
+    for (const auto& section : Sections) {
+        if (section.Offset + section.Size > Size) {
+            munmap(ptr, Size);
+            throw runtime_error("TBinaryModelReader - truncated model file.");
+        }
+    }
+}
+
+TBinaryModelReader::~TBinaryModelReader() {
+    if (Data)
+        munmap(const_cast<char*>(Data), Size);
+}
+
+bool TBinaryModelReader::HasSection(EBinarySection id) const {
+    for (const auto& section : Sections) {
+        if (section.Id == static_cast<uint32_t>(id))
+            return true;
+    }
+    return false;
+}
+
+const TBinarySection& TBinaryModelReader::GetSection(EBinarySection id) const {
+    for (const auto& section : Sections) {
+        if (section.Id == static_cast<uint32_t>(id))
+            return section;
+    }
+    throw runtime_error("TBinaryModelReader - no section " + to_string(static_cast<uint32_t>(id)) + ".");
+}
+
+TMappedVocabulary::TMappedVocabulary(const TBinaryModelReader& reader)
+    : Records(reader.GetSectionData<TBinaryWordRecord>(EBinarySection::Words))
+    , Pool(reader.GetSectionData<char>(EBinarySection::WordsPool))
+    , Lookup(reader.GetSectionData<uint32_t>(EBinarySection::WordsLookup))
+    , Size(reader.GetSectionLength<TBinaryWordRecord>(EBinarySection::Words))
+{
+    if (reader.GetSectionLength<uint32_t>(EBinarySection::WordsLookup) != Size)
+        throw runtime_error("TMappedVocabulary - wrong lookup size.");
+}
+
+bool TMappedVocabulary::GetWordIndex(const string& word, unsigned int& index) const {
+    size_t lo = 0, hi = Size;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        const auto& record = Records[Lookup[mid]];
+        int cmp = word.compare(0, string::npos, Pool + record.Offset, record.Length);
+        if (cmp == 0) {
+            index = Lookup[mid];
+            return true;
+        }
+        if (cmp > 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return false;
+}
+
+bool TMappedVocabulary::GetWord(unsigned int index, TWord& word) const {
+    if (index >= Size)
+        return false;
+    const auto& record = Records[index];
+    word = TWord(string(Pool + record.Offset, record.Length), index);
+    word.Frequency = record.Frequency;
+    return true;
+}
+
+TMappedDocuments::TMappedDocuments(const TBinaryModelReader& reader)
+    : Records(reader.GetSectionData<TBinaryDocRecord>(EBinarySection::Docs))
+    , Pool(reader.GetSectionData<char>(EBinarySection::DocsPool))
+    , Lookup(reader.GetSectionData<uint32_t>(EBinarySection::DocsLookup))
+    , Size(reader.GetSectionLength<TBinaryDocRecord>(EBinarySection::Docs))
+{
+    if (reader.GetSectionLength<uint32_t>(EBinarySection::DocsLookup) != Size)
+        throw runtime_error("TMappedDocuments - wrong lookup size.");
+}
+
+bool TMappedDocuments::GetDocumentIndex(const string& docTag, unsigned int& index) const {
+    size_t lo = 0, hi = Size;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        const auto& record = Records[Lookup[mid]];
+        int cmp = docTag.compare(0, string::npos, Pool + record.Offset, record.TagLength);
+        if (cmp == 0) {
+            index = Lookup[mid];
+            return true;
+        }
+        if (cmp > 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return false;
+}
+
+string TMappedDocuments::GetRawDocument(unsigned int index) const {
+    if (index >= Size)
+        throw runtime_error("GetRawDocument - out of range");
+    const auto& record = Records[index];
+    return string(Pool + record.Offset, record.Length);
+}
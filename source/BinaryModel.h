@@ -0,0 +1,210 @@
+#pragma once
+#include "Common.h"
+#include "Vocabulary.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * Binary model layout (version 2), all numbers are in native byte order:
+ *   TBinaryHeader
+ *   sections, every section starts at BINARY_SECTION_ALIGNMENT boundary
+ *   section table - TBinaryHeader::SectionCount of TBinarySection
+ * Layer sections keep rows padded to the same stride as TLayer, so a mapped file can be used in place.
+ * Quantized sections are optional, element size tells int8 (1) from fp16 (2), scales are written for int8 only.
+ * Product quantization index of documents is optional, see TProductQuantizer.
+ * Corpus cache has the same layout: Corpus* sections, vocabulary and documents, see TCorpus.
+ * Version is increased whenever the set of sections or their layout changes, files of other versions are rejected.
+ * Version 1 kept raw and normalized word and document layers and had no quantized, PQ or corpus sections.
+ */
+
+const char BINARY_MODEL_MAGIC[8] = {'D', '2', 'V', 'B', 'I', 'N', '\0', '\0'};
+const uint32_t BINARY_MODEL_VERSION = 2;
+const uint32_t BINARY_BYTE_ORDER_MARK = 0x01020304;
+const size_t BINARY_SECTION_ALIGNMENT = 4096;
+
+enum class EBinarySection : uint32_t {
+    Spec = 1,
+    Syn0,
+    DSyn0,
+    Syn0Norm,
+    DSyn0Norm,
+    Syn1,
+    Syn1Neg,
+    Words,
+    WordsPool,
+    WordsLookup,
+    Docs,
+    DocsPool,
+    DocsLookup,
+    Syn0Quantized,
+    DSyn0Quantized,
+    Syn0QuantizedScale,
+    DSyn0QuantizedScale,
+    DSyn0PQCentroids,
+    DSyn0PQCodes,
+    CorpusSource,
+    CorpusTokens,
+    CorpusOffsets
+};
+
+struct TBinaryHeader {
+    char Magic[8];
+    uint32_t Version;
+    uint32_t ByteOrderMark;
+    uint32_t SectionCount;
+    uint32_t Reserved;
+    uint64_t SectionTableOffset;
+};
+
+struct TBinarySection {
+    uint32_t Id;
+    uint32_t ElementSize;
+    uint64_t Offset;
+    uint64_t Size;
+    uint64_t Rows;
+    uint64_t Dim;
+    uint64_t Stride;
+};
+
+// Fixed part of Spec section, it is followed by train filename
+struct TBinarySpec {
+    uint32_t DimensionSize;
+    uint32_t HierarchicalSoftmax;
+    uint32_t CBOW;
+    int32_t NegativeSampleNum;
+    uint32_t IterationNumber;
+    uint32_t WindowSize;
+    uint32_t ThreadCount;
+    uint32_t Precision;
+    double Sample;
+    double Alpha;
+};
+
+// Words section is indexed by word index, strings are in WordsPool
+struct TBinaryWordRecord {
+    uint64_t Offset;
+    uint32_t Length;
+    uint32_t Frequency;
+};
+
+// Docs section is indexed by document index, raw documents are in DocsPool, tag is prefix of raw document
+struct TBinaryDocRecord {
+    uint64_t Offset;
+    uint32_t Length;
+    uint32_t TagLength;
+};
+
+// Increased whenever tokenization or the corpus sections change, caches of other versions are rebuilt
+const uint32_t CORPUS_CACHE_VERSION = 1;
+
+// CorpusSource section of corpus cache, dataset file is identified by size and modification time in nanoseconds
+struct TBinaryCorpusSource {
+    uint32_t Version;
+    uint32_t Reserved;
+    uint64_t DatasetSize;
+    int64_t DatasetModificationTime;
+};
+
+bool IsBinaryModel(const std::string& filename);
+
+class TBinaryModelWriter {
+public:
+    TBinaryModelWriter(std::ofstream& out);
+
+    void BeginSection(EBinarySection id, uint32_t elementSize = 1, uint64_t rows = 0, uint64_t dim = 0, uint64_t stride = 0);
+    void Write(const void* data, size_t bytes);
+    void EndSection();
+    void Finish();
+
+private:
+    void Align();
+
+private:
+    std::ofstream& Out;
+    std::vector<TBinarySection> Sections;
+    uint64_t Position;
+};
+
+// Maps model file read-only, sections are used in place
+class TBinaryModelReader {
+public:
+    TBinaryModelReader(const std::string& filename);
+    ~TBinaryModelReader();
+
+    TBinaryModelReader(const TBinaryModelReader&) = delete;
+    TBinaryModelReader& operator=(const TBinaryModelReader&) = delete;
+
+    bool HasSection(EBinarySection id) const;
+    const TBinarySection& GetSection(EBinarySection id) const;
+
+    template <typename T>
+    const T* GetSectionData(EBinarySection id) const {
+        return reinterpret_cast<const T*>(Data + GetSection(id).Offset);
+    }
+
+    template <typename T>
+    size_t GetSectionLength(EBinarySection id) const {
+        return GetSection(id).Size / sizeof(T);
+    }
+
+private:
+    const char* Data;
+    size_t Size;
+    std::vector<TBinarySection> Sections;
+};
+
+// Read-only vocabulary on top of mapped sections, lookup is a binary search over WordsLookup
+class TMappedVocabulary {
+public:
+    TMappedVocabulary()
+        : Records(nullptr)
+        , Pool(nullptr)
+        , Lookup(nullptr)
+        , Size(0)
+    {}
+
+    TMappedVocabulary(const TBinaryModelReader& reader);
+
+    bool GetWordIndex(const std::string& word, unsigned int& index) const;
+    bool GetWord(unsigned int index, TWord& word) const;
+
+    size_t GetSize() const {
+        return Size;
+    }
+
+private:
+    const TBinaryWordRecord* Records;
+    const char* Pool;
+    const uint32_t* Lookup;
+    size_t Size;
+};
+
+// Read-only documents on top of mapped sections, lookup by tag is a binary search over DocsLookup
+class TMappedDocuments {
+public:
+    TMappedDocuments()
+        : Records(nullptr)
+        , Pool(nullptr)
+        , Lookup(nullptr)
+        , Size(0)
+    {}
+
+    TMappedDocuments(const TBinaryModelReader& reader);
+
+    bool GetDocumentIndex(const std::string& docTag, unsigned int& index) const;
+    std::string GetRawDocument(unsigned int index) const;
+
+    size_t GetSize() const {
+        return Size;
+    }
+
+private:
+    const TBinaryDocRecord* Records;
+    const char* Pool;
+    const uint32_t* Lookup;
+    size_t Size;
+};
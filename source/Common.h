@@ -1,22 +1,77 @@
 #pragma once
 #include <string>
+#include <cstddef>
 
 const int SUCCESS_RETURN = 0;
 const int FAIL_RETURN = 1;
 
 const int MAX_EXP = 6;
-const int EXP_TABLE_SIZE = 1000;
-const unsigned int NEGATIVE_SAMPLE_TABLE_SIZE = 1e8;
-const long long UPDATE_WORD_NUMBER = 10e4;
+// Number of sigmoid table intervals over [-MAX_EXP, MAX_EXP]
+const unsigned int SIGMOID_TABLE_SIZE = 1024;
+const double NEGATIVE_SAMPLE_POWER = 0.75;
+// Reporter thread publishes learning rate every PROGRESS_UPDATE_INTERVAL_MS and prints progress every PROGRESS_PRINT_INTERVAL_MS
+const unsigned int PROGRESS_UPDATE_INTERVAL_MS = 10;
+const unsigned int PROGRESS_PRINT_INTERVAL_MS = 200;
+// Train threads take documents in chunks of about this many tokens
+const unsigned long long SCHEDULER_CHUNK_TOKEN_NUMBER = 10000;
+// Streaming training reads dataset in chunks of about this many tokens, one reader thread works for this many train threads
+const unsigned long long STREAM_CHUNK_TOKEN_NUMBER = 1 << 16;
+const unsigned int STREAM_TRAIN_THREADS_PER_READER = 2;
+// Dataset text is parsed by parts of at least this size in bytes, one per hardware thread
+const size_t DATASET_MIN_PART_SIZE = 1 << 20;
+// Tag index of documents is split into this many hash maps filled in parallel
+const size_t DOCUMENT_TAG_SHARD_NUMBER = 64;
 const double ALPHA_MAX_REDUCE_COEFFICENT = 0.0001;
 const unsigned int MAX_CODE_LENGTH = 40;
+const size_t CACHE_LINE_SIZE = 64;
+// Vector kernels are fully unrolled for these dimensions, see CreateKernelsSet
+constexpr unsigned int SPECIALIZED_DIMENSIONS[] = {50, 100, 200, 300};
+// Register tiles of matrix kernels: DotMatrix keeps DOT_TILE_ROWS x DOT_TILE_COLS accumulators,
+// AxpyMatrix updates AXPY_TILE_ROWS output rows at once, both fit in 16 vector registers
+const size_t DOT_TILE_ROWS = 4;
+const size_t DOT_TILE_COLS = 2;
+const size_t AXPY_TILE_ROWS = 4;
 
 const char SERIALIZE_DELIM = ' ';
+// Text model format version, written on the line after TDoc2Vec header. Files without the line are version 1:
+// their spec has no precision field, weights are double and normalized word and document layers follow raw ones.
+const unsigned int TEXT_MODEL_VERSION = 2;
+
+enum class EPrecision {
+    Float,
+    Double
+};
+
+enum class EHugePages {
+    None,
+    Transparent,
+    Explicit
+};
+
+enum class ESimd {
+    Auto,
+    Scalar,
+    Sse2,
+    Avx2,
+    Avx512
+};
+
+enum class ESigmoid {
+    Table,
+    Rational
+};
+
+enum class EQuantization {
+    None,
+    Int8,
+    Fp16
+};
 
 const std::string WORD_OPTION = "--word";
 const std::string DOC_OPTION = "--doc";
 const std::string LOAD_OPTION = "--load";
 const std::string SAVE_OPTION = "--save";
+const std::string SAVE_BINARY_OPTION = "--save-binary";
 const std::string NUM_OPTION = "--num";
 const std::string DATA_OPTION = "--data";
 const std::string DIMENSION_OPTION = "--dimension";
@@ -28,6 +83,18 @@ const std::string WINDOW_OPTION = "--window";
 const std::string SAMPLE_OPTION = "--sample";
 const std::string THREAD_OPTION = "--thread";
 const std::string ALPHA_OPTION = "--alpha";
+const std::string PRECISION_OPTION = "--precision";
+const std::string HOGWILD_OPTION = "--hogwild";
+const std::string HUGE_PAGES_OPTION = "--huge-pages";
+const std::string PIN_THREADS_OPTION = "--pin-threads";
+const std::string BATCH_NEGATIVES_OPTION = "--batch-negatives";
+const std::string SIGMOID_OPTION = "--sigmoid";
+const std::string CORPUS_CACHE_OPTION = "--corpus-cache";
+const std::string STREAM_OPTION = "--stream";
+const std::string QUANTIZE_OPTION = "--quantize";
+const std::string RERANK_OPTION = "--rerank";
+const std::string PQ_OPTION = "--pq";
+const std::string SIMD_OPTION = "--simd";
 const std::string HELP_OPTION = "--help";
 
 const unsigned int DEFAULT_DIMENSION_SIZE = 100;
@@ -38,5 +105,26 @@ const unsigned int DEFAULT_ITERATION_NUMBER = 5;
 const unsigned int DEFAULT_WINDOW_SIZE = 5;
 const double DEFAULT_SAMPLE = 1e-3;
 const unsigned int DEFAULT_THREAD_COUNT = 4;
-const double DEFAULT_ALPHA = 0.05;
+// Tuned for the exact linear decay of TTrainProgress
+const double DEFAULT_ALPHA = 0.055;
+const EPrecision DEFAULT_PRECISION = EPrecision::Float;
+const bool DEFAULT_HOGWILD = false;
+const EHugePages DEFAULT_HUGE_PAGES = EHugePages::None;
+const bool DEFAULT_PIN_THREADS = false;
+const bool DEFAULT_BATCH_NEGATIVES = false;
+const bool DEFAULT_STREAM = false;
+const ESigmoid DEFAULT_SIGMOID = ESigmoid::Table;
+const unsigned int DEFAULT_RERANK_NUMBER = 0;
+const ESimd DEFAULT_SIMD = ESimd::Auto;
+const unsigned int DEFAULT_PQ_ITERATION_NUMBER = 10;
+
+const unsigned long long TRAIN_RANDOM_SEED = 1;
+
+// Quantized rows are converted to float by blocks of this many rows before vector kernels score them
+const size_t QUANTIZED_SCORE_BLOCK_ROWS = 64;
+const unsigned int PQ_CENTROID_NUMBER = 256;
+const size_t PQ_MAX_TRAIN_ROWS = 32768;
+const unsigned int PQ_RANDOM_SEED = 1;
+const unsigned int PQ_RECALL_NUM = 10;
+const unsigned int PQ_RECALL_QUERY_NUMBER = 100;
 
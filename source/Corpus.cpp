@@ -0,0 +1,147 @@
+#include "Corpus.h"
+#include "VocabularyBuilder.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <sys/stat.h>
+
+using namespace std;
+
+static TBinaryCorpusSource GetCorpusSource(const string& datasetFilename) {
+    struct stat st;
+    if (stat(datasetFilename.c_str(), &st) != 0)
+        throw runtime_error("Cannot open file <" + datasetFilename + ">.");
+    TBinaryCorpusSource source;
+    source.Version = CORPUS_CACHE_VERSION;
+    source.Reserved = 0;
+    source.DatasetSize = st.st_size;
+    source.DatasetModificationTime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return source;
+}
+
+void TCorpus::Read(const string& datasetFilename, TDocumentsHolder& documents, TVocabulary& vocabulary) {
+    TMappedFile file(datasetFilename);
+    TVocabularyBuilder builder(/*keepTokens*/ true);
+    builder.Parse(file.GetData(), file.GetSize());
+    if (builder.GetLineCount() == 0)
+        throw runtime_error("No documents in dataset file");
+    builder.Merge(vocabulary);
+
+    unsigned int firstDocument = documents.GetSize();
+    vector<shared_ptr<TDocument>> docs(builder.GetLineCount());
+    const char* text = file.GetData();
+    builder.ParallelForEachLine([&docs, text, firstDocument](size_t line, const TDocumentSource& source, size_t) {
+        docs[line] = make_shared<TDocument>(string(text + source.Offset, source.Length), firstDocument + line);
+    });
+    documents.AddDocuments(move(docs));
+
+    OwnedTokens.clear();
+    OwnedOffsets.assign(1, 0);
+    builder.AppendTokens(OwnedTokens, OwnedOffsets);
+    SetOwned();
+}
+
+void TCorpus::SetOwned() {
+    Cache.reset();
+    Tokens = OwnedTokens.data();
+    Offsets = OwnedOffsets.data();
+    DocumentNum = OwnedOffsets.size() - 1;
+    MaxDocumentLength = 0;
+    for (unsigned int i = 0; i < DocumentNum; ++i)
+        MaxDocumentLength = max(MaxDocumentLength, GetDocumentLength(i));
+}
+
+bool TCorpus::LoadCache(const string& cacheFilename, const string& datasetFilename, TDocumentsHolder& documents, TVocabulary& vocabulary) {
+    struct stat st;
+    if (stat(cacheFilename.c_str(), &st) != 0 || !IsBinaryModel(cacheFilename))
+        return false;
+    // Cache of another binary or corpus version, or a broken one, is rebuilt like a stale one
+    shared_ptr<TBinaryModelReader> cache;
+    try {
+        cache = make_shared<TBinaryModelReader>(cacheFilename);
+    } catch (const runtime_error&) {
+        return false;
+    }
+    if (!cache->HasSection(EBinarySection::CorpusSource) || !cache->HasSection(EBinarySection::CorpusTokens)
+        || !cache->HasSection(EBinarySection::CorpusOffsets)
+    )
+        return false;
+
+    const auto& sourceSection = cache->GetSection(EBinarySection::CorpusSource);
+    if (sourceSection.ElementSize != sizeof(TBinaryCorpusSource) || sourceSection.Rows != 1
+        || sourceSection.Size != sizeof(TBinaryCorpusSource)
+    )
+        return false;
+    const TBinaryCorpusSource& cached = *cache->GetSectionData<TBinaryCorpusSource>(EBinarySection::CorpusSource);
+    TBinaryCorpusSource current = GetCorpusSource(datasetFilename);
+    if (cached.Version != current.Version || cached.DatasetSize != current.DatasetSize
+        || cached.DatasetModificationTime != current.DatasetModificationTime
+    )
+        return false;
+
+    const auto& offsets = cache->GetSection(EBinarySection::CorpusOffsets);
+    const auto& tokens = cache->GetSection(EBinarySection::CorpusTokens);
+    if (offsets.ElementSize != sizeof(uint64_t) || offsets.Rows == 0 || offsets.Size != offsets.Rows * sizeof(uint64_t)
+        || tokens.ElementSize != sizeof(uint32_t) || tokens.Size != tokens.Rows * sizeof(uint32_t)
+    )
+        return false;
+
+    // Arguments are changed only when the whole cache is valid
+    TVocabulary cachedVocabulary;
+    TDocumentsHolder cachedDocuments;
+    try {
+        cachedVocabulary.LoadBinary(*cache);
+        cachedDocuments.LoadBinary(*cache);
+    } catch (const runtime_error&) {
+        return false;
+    }
+    const uint32_t* cachedTokens = cache->GetSectionData<uint32_t>(EBinarySection::CorpusTokens);
+    const uint64_t* cachedOffsets = cache->GetSectionData<uint64_t>(EBinarySection::CorpusOffsets);
+    unsigned int documentNum = offsets.Rows - 1;
+    if (documentNum != cachedDocuments.GetSize() || cachedOffsets[0] != 0 || cachedOffsets[documentNum] != tokens.Rows)
+        return false;
+    size_t maxDocumentLength = 0;
+    for (unsigned int i = 0; i < documentNum; ++i) {
+        if (cachedOffsets[i + 1] < cachedOffsets[i])
+            return false;
+        maxDocumentLength = max<size_t>(maxDocumentLength, cachedOffsets[i + 1] - cachedOffsets[i]);
+    }
+    for (size_t i = 0; i < tokens.Rows; ++i) {
+        if (cachedTokens[i] >= cachedVocabulary.GetSize())
+            return false;
+    }
+
+    vocabulary = move(cachedVocabulary);
+    documents = move(cachedDocuments);
+    OwnedTokens.clear();
+    OwnedOffsets.clear();
+    Tokens = cachedTokens;
+    Offsets = cachedOffsets;
+    DocumentNum = documentNum;
+    MaxDocumentLength = maxDocumentLength;
+    Cache = cache;
+    return true;
+}
+
+void TCorpus::SaveCache(const string& cacheFilename, const string& datasetFilename, const TDocumentsHolder& documents, const TVocabulary& vocabulary) const {
+    ofstream out(cacheFilename, ios::binary);
+    if (!out.is_open())
+        throw runtime_error("Cannot open file <" + cacheFilename + ">.");
+    TBinaryCorpusSource source = GetCorpusSource(datasetFilename);
+    TBinaryModelWriter writer(out);
+    writer.BeginSection(EBinarySection::CorpusSource, sizeof(TBinaryCorpusSource), 1);
+    writer.Write(&source, sizeof(source));
+    writer.EndSection();
+    writer.BeginSection(EBinarySection::CorpusTokens, sizeof(uint32_t), GetTokenCount());
+    writer.Write(Tokens, GetTokenCount() * sizeof(uint32_t));
+    writer.EndSection();
+    writer.BeginSection(EBinarySection::CorpusOffsets, sizeof(uint64_t), DocumentNum + 1);
+    writer.Write(Offsets, (DocumentNum + 1) * sizeof(uint64_t));
+    writer.EndSection();
+    vocabulary.SaveBinary(writer);
+    documents.SaveBinary(writer);
+    writer.Finish();
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include "Common.h"
+#include "Vocabulary.h"
+#include "BinaryModel.h"
+#include "Tokenizer.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+
+// Calls func(wordBegin, wordEnd) for every word of dataset line [begin, end) after its tag,
+// the first space separated field
+template <typename Func>
+void ForEachDocumentWord(const char* begin, const char* end, Func func) {
+    const char* firstSpace = std::find(begin, end, ' ');
+    if (firstSpace == end)
+        return;
+    ForEachWord(firstSpace + 1, end, func);
+}
+
+// Documents [FirstDocument, FirstDocument + DocumentNum) given to a train thread,
+// tokens of document FirstDocument + i are [Tokens + Offsets[i], Tokens + Offsets[i + 1])
+struct TDocumentChunk {
+    unsigned int FirstDocument;
+    unsigned int DocumentNum;
+    const uint32_t* Tokens;
+    const uint64_t* Offsets;
+    // Stream buffer the chunk lives in, see TCorpusStream
+    size_t Buffer;
+};
+
+/*
+ * Dataset tokenized once into vocabulary word indexes: all tokens are in one flat uint32 buffer,
+ * tokens of document i are [Offsets[i], Offsets[i + 1]). Trainers read documents from it on every epoch
+ * without touching strings.
+ * Corpus can be cached in a binary file with the vocabulary and documents it was built with,
+ * so later runs on the same dataset skip tokenization and vocabulary building.
+ */
+class TCorpus {
+public:
+    TCorpus()
+        : Tokens(nullptr)
+        , Offsets(nullptr)
+        , DocumentNum(0)
+        , MaxDocumentLength(0)
+    {}
+
+    // Reads dataset line by line: document tag is the first space separated field, words are \w+ matches of the rest.
+    // Words get vocabulary indexes in order of first occurrence, Huffman tree isn't built here.
+    void Read(const std::string& datasetFilename, TDocumentsHolder& documents, TVocabulary& vocabulary);
+
+    // Cache is used only while dataset has the same size and modification time as when cache was saved,
+    // and cache has the current CORPUS_CACHE_VERSION. Otherwise, or if cache is broken, false is returned
+    // and documents and vocabulary are left unchanged. Tokens stay in the mapped cache file.
+    bool LoadCache(const std::string& cacheFilename, const std::string& datasetFilename, TDocumentsHolder& documents, TVocabulary& vocabulary);
+    void SaveCache(const std::string& cacheFilename, const std::string& datasetFilename, const TDocumentsHolder& documents, const TVocabulary& vocabulary) const;
+
+    unsigned int GetSize() const {
+        return DocumentNum;
+    }
+
+    bool IsLoadedFromCache() const {
+        return Cache != nullptr;
+    }
+
+    uint64_t GetTokenCount() const {
+        return Offsets ? Offsets[DocumentNum] : 0;
+    }
+
+    size_t GetMaxDocumentLength() const {
+        return MaxDocumentLength;
+    }
+
+    TDocumentChunk GetChunk(unsigned int documentBegin, unsigned int documentEnd) const {
+        TDocumentChunk chunk;
+        chunk.FirstDocument = documentBegin;
+        chunk.DocumentNum = documentEnd - documentBegin;
+        chunk.Tokens = Tokens;
+        chunk.Offsets = Offsets + documentBegin;
+        chunk.Buffer = 0;
+        return chunk;
+    }
+
+    const uint32_t* GetDocument(unsigned int docIndex) const {
+        return Tokens + Offsets[docIndex];
+    }
+
+    size_t GetDocumentLength(unsigned int docIndex) const {
+        return Offsets[docIndex + 1] - Offsets[docIndex];
+    }
+
+private:
+    void SetOwned();
+
+private:
+    std::vector<uint32_t> OwnedTokens;
+    std::vector<uint64_t> OwnedOffsets;
+    std::shared_ptr<TBinaryModelReader> Cache;
+    const uint32_t* Tokens;
+    const uint64_t* Offsets;
+    unsigned int DocumentNum;
+    size_t MaxDocumentLength;
+};
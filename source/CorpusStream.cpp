@@ -0,0 +1,202 @@
+#include "CorpusStream.h"
+#include "VocabularyBuilder.h"
+#include "Common.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+using namespace std;
+
+namespace {
+    const size_t NO_BUFFER = SIZE_MAX;
+}
+
+TCorpusStream::~TCorpusStream() {
+    JoinReaders();
+}
+
+void TCorpusStream::ReadVocabulary(TDocumentsHolder& documents, TVocabulary& vocabulary) {
+    // Mapped pages aren't counted as process memory, kernel drops them after parsing if it needs memory
+    TMappedFile file(DatasetFilename);
+    TVocabularyBuilder builder(/*keepTokens*/ false);
+    builder.Parse(file.GetData(), file.GetSize());
+    if (builder.GetLineCount() == 0)
+        throw runtime_error("No documents in dataset file");
+    builder.Merge(vocabulary);
+
+    unsigned int firstDocument = documents.GetSize();
+    vector<shared_ptr<TDocument>> docs(builder.GetLineCount());
+    vector<TDocumentSource> sources(docs.size());
+    vector<size_t> lengths(docs.size());
+    const char* text = file.GetData();
+    builder.ParallelForEachLine([&](size_t line, const TDocumentSource& source, size_t tokenCount) {
+        const char* lineBegin = text + source.Offset;
+        const char* tagEnd = find(lineBegin, lineBegin + source.Length, ' ');
+        docs[line] = make_shared<TDocument>(string(lineBegin, tagEnd), firstDocument + line);
+        sources[line] = source;
+        lengths[line] = tokenCount;
+    });
+    documents.SetSourceFilename(DatasetFilename);
+    documents.AddSourceDocuments(move(docs), sources);
+
+    TokenCount = 0;
+    MaxDocumentLength = 0;
+    Bounds.assign(1, 0);
+    uint64_t chunkTokens = 0;
+    for (size_t i = 0; i < lengths.size(); ++i) {
+        TokenCount += lengths[i];
+        MaxDocumentLength = max(MaxDocumentLength, lengths[i]);
+        chunkTokens += lengths[i];
+        if (chunkTokens >= STREAM_CHUNK_TOKEN_NUMBER) {
+            Bounds.push_back(i + 1);
+            chunkTokens = 0;
+        }
+    }
+    if (Bounds.back() != lengths.size())
+        Bounds.push_back(lengths.size());
+}
+
+void TCorpusStream::Start(const TVocabulary& vocabulary, const TDocumentsHolder& documents, unsigned int iterationNumber, unsigned int trainThreadCount) {
+    size_t chunkNum = Bounds.size() - 1;
+    unsigned int maxChunkDocuments = 0;
+    for (size_t i = 0; i < chunkNum; ++i)
+        maxChunkDocuments = max(maxChunkDocuments, Bounds[i + 1] - Bounds[i]);
+
+    // Every train thread holds a buffer and has one more read ahead, every reader fills one
+    unsigned int readerNum = (trainThreadCount + STREAM_TRAIN_THREADS_PER_READER - 1) / STREAM_TRAIN_THREADS_PER_READER;
+    size_t bufferNum = 2 * trainThreadCount + readerNum;
+    Buffers.resize(bufferNum);
+    FreeBuffers.clear();
+    FreeBuffers.reserve(bufferNum);
+    for (size_t i = 0; i < bufferNum; ++i) {
+        // Chunk ends with the document which crosses STREAM_CHUNK_TOKEN_NUMBER
+        Buffers[i].Tokens.reserve(STREAM_CHUNK_TOKEN_NUMBER + MaxDocumentLength);
+        Buffers[i].Offsets.reserve(maxChunkDocuments + 1);
+        FreeBuffers.push_back(i);
+    }
+    ReadyBuffers.assign(bufferNum, NO_BUFFER);
+    ReadyBegin = 0;
+    ReadyNum = 0;
+    Stopping = false;
+    ReaderError = nullptr;
+    Cursor = 0;
+    TicketNum = static_cast<uint64_t>(iterationNumber) * chunkNum;
+
+    ActiveReaderNum = readerNum;
+    for (unsigned int i = 0; i < readerNum; ++i)
+        Readers.emplace_back(&TCorpusStream::RunReader, this, std::cref(vocabulary), std::cref(documents));
+}
+
+void TCorpusStream::JoinReaders() {
+    {
+        lock_guard<mutex> lock(Mutex);
+        Stopping = true;
+    }
+    BufferFreed.notify_all();
+    BufferReady.notify_all();
+    for (auto& reader : Readers)
+        reader.join();
+    Readers.clear();
+}
+
+void TCorpusStream::Stop() {
+    JoinReaders();
+    if (ReaderError)
+        rethrow_exception(ReaderError);
+}
+
+bool TCorpusStream::Next(TDocumentChunk& chunk) {
+    unique_lock<mutex> lock(Mutex);
+    BufferReady.wait(lock, [this]() { return ReadyNum > 0 || ActiveReaderNum == 0 || Stopping; });
+    if (Stopping || ReadyNum == 0)
+        return false;
+    size_t buffer = ReadyBuffers[ReadyBegin];
+    ReadyBegin = (ReadyBegin + 1) % ReadyBuffers.size();
+    --ReadyNum;
+    chunk.FirstDocument = Buffers[buffer].FirstDocument;
+    chunk.DocumentNum = Buffers[buffer].Offsets.size() - 1;
+    chunk.Tokens = Buffers[buffer].Tokens.data();
+    chunk.Offsets = Buffers[buffer].Offsets.data();
+    chunk.Buffer = buffer;
+    return true;
+}
+
+void TCorpusStream::Release(const TDocumentChunk& chunk) {
+    {
+        lock_guard<mutex> lock(Mutex);
+        FreeBuffers.push_back(chunk.Buffer);
+    }
+    BufferFreed.notify_one();
+}
+
+size_t TCorpusStream::TakeFreeBuffer() {
+    unique_lock<mutex> lock(Mutex);
+    BufferFreed.wait(lock, [this]() { return Stopping || !FreeBuffers.empty(); });
+    if (Stopping)
+        return NO_BUFFER;
+    size_t buffer = FreeBuffers.back();
+    FreeBuffers.pop_back();
+    return buffer;
+}
+
+void TCorpusStream::PutReadyBuffer(size_t buffer) {
+    {
+        lock_guard<mutex> lock(Mutex);
+        ReadyBuffers[(ReadyBegin + ReadyNum) % ReadyBuffers.size()] = buffer;
+        ++ReadyNum;
+    }
+    BufferReady.notify_one();
+}
+
+void TCorpusStream::ReadChunk(ifstream& in, string& line, string& word, size_t chunk, const TVocabulary& vocabulary, const TDocumentsHolder& documents, TBuffer& buffer) {
+    unsigned int documentBegin = Bounds[chunk], documentEnd = Bounds[chunk + 1];
+    in.clear();
+    in.seekg(documents.GetSource(documentBegin).Offset);
+    buffer.FirstDocument = documentBegin;
+    buffer.Tokens.clear();
+    buffer.Offsets.assign(1, 0);
+    for (unsigned int doc = documentBegin; doc < documentEnd; ++doc) {
+        if (!getline(in, line) || line.size() != documents.GetSource(doc).Length)
+            throw runtime_error("TCorpusStream - dataset file <" + DatasetFilename + "> was changed.");
+        ForEachDocumentWord(line.data(), line.data() + line.size(), [&vocabulary, &buffer, &word](const char* wordBegin, const char* wordEnd) {
+            AssignNormalizedWord(wordBegin, wordEnd, word);
+            unsigned int index;
+            if (vocabulary.GetNormalizedWordIndex(word, index))
+                buffer.Tokens.push_back(index);
+        });
+        buffer.Offsets.push_back(buffer.Tokens.size());
+    }
+}
+
+void TCorpusStream::RunReader(const TVocabulary& vocabulary, const TDocumentsHolder& documents) {
+    try {
+        ifstream in(DatasetFilename);
+        if (!in.is_open())
+            throw runtime_error("Cannot open file <" + DatasetFilename + ">.");
+        string line, word;
+        size_t chunkNum = Bounds.size() - 1;
+        for (uint64_t ticket = Cursor.fetch_add(1); ticket < TicketNum; ticket = Cursor.fetch_add(1)) {
+            size_t buffer = TakeFreeBuffer();
+            if (buffer == NO_BUFFER)
+                break;
+            ReadChunk(in, line, word, ticket % chunkNum, vocabulary, documents, Buffers[buffer]);
+            PutReadyBuffer(buffer);
+        }
+    } catch (...) {
+        lock_guard<mutex> lock(Mutex);
+        if (!ReaderError)
+            ReaderError = current_exception();
+        Stopping = true;
+    }
+    {
+        lock_guard<mutex> lock(Mutex);
+        --ActiveReaderNum;
+    }
+    // Train threads wait for the last reader, readers wait for buffers after an error
+    BufferReady.notify_all();
+    BufferFreed.notify_all();
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "Corpus.h"
+#include "Vocabulary.h"
+#include "System.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <cstdint>
+
+/*
+ * Training corpus which isn't kept in memory: every epoch reads and tokenizes dataset file again.
+ * Reader threads fill a fixed set of buffers with chunks of about STREAM_CHUNK_TOKEN_NUMBER tokens
+ * while train threads consume filled ones, so memory is bounded by buffer count whatever dataset size is.
+ * Chunks are document ranges found by ReadVocabulary, readers seek to them independently.
+ */
+class TCorpusStream {
+public:
+    TCorpusStream(const std::string& datasetFilename)
+        : DatasetFilename(datasetFilename)
+        , TokenCount(0)
+        , MaxDocumentLength(0)
+        , Cursor(0)
+        , TicketNum(0)
+        , ReadyBegin(0)
+        , ReadyNum(0)
+        , ActiveReaderNum(0)
+        , Stopping(false)
+    {}
+    ~TCorpusStream();
+
+    TCorpusStream(const TCorpusStream&) = delete;
+    TCorpusStream& operator=(const TCorpusStream&) = delete;
+
+    // The only pass which keeps something per document: words go to vocabulary,
+    // tags and places of documents in dataset file go to documents holder.
+    // Dataset is mapped and parsed in parallel.
+    void ReadVocabulary(TDocumentsHolder& documents, TVocabulary& vocabulary);
+
+    // Vocabulary and documents of ReadVocabulary should live until Stop
+    void Start(const TVocabulary& vocabulary, const TDocumentsHolder& documents, unsigned int iterationNumber, unsigned int trainThreadCount);
+    // Joins readers, rethrows their error if any
+    void Stop();
+
+    // Blocks until a chunk is read, returns false after the last chunk of the last epoch
+    bool Next(TDocumentChunk& chunk);
+    // Gives buffer of the chunk back to readers
+    void Release(const TDocumentChunk& chunk);
+
+    uint64_t GetTokenCount() const {
+        return TokenCount;
+    }
+
+    size_t GetMaxDocumentLength() const {
+        return MaxDocumentLength;
+    }
+
+private:
+    struct TBuffer {
+        unsigned int FirstDocument;
+        std::vector<uint32_t> Tokens;
+        std::vector<uint64_t> Offsets;
+    };
+
+    void RunReader(const TVocabulary& vocabulary, const TDocumentsHolder& documents);
+    void ReadChunk(std::ifstream& in, std::string& line, std::string& word, size_t chunk, const TVocabulary& vocabulary, const TDocumentsHolder& documents, TBuffer& buffer);
+    // Waits for a free buffer, returns NO_BUFFER when stopped
+    size_t TakeFreeBuffer();
+    void PutReadyBuffer(size_t buffer);
+    void JoinReaders();
+
+private:
+    std::string DatasetFilename;
+    uint64_t TokenCount;
+    size_t MaxDocumentLength;
+    // Chunk i is documents [Bounds[i], Bounds[i + 1])
+    std::vector<unsigned int> Bounds;
+    // Readers take chunks of all epochs in order
+    std::atomic<uint64_t> Cursor;
+    uint64_t TicketNum;
+
+    std::vector<TBuffer> Buffers;
+    std::vector<size_t> FreeBuffers;
+    // Ring of filled buffers in order they were read
+    std::vector<size_t> ReadyBuffers;
+    size_t ReadyBegin;
+    size_t ReadyNum;
+    unsigned int ActiveReaderNum;
+    bool Stopping;
+    std::exception_ptr ReaderError;
+    std::mutex Mutex;
+    std::condition_variable BufferFreed;
+    std::condition_variable BufferReady;
+    std::vector<std::thread> Readers;
+};
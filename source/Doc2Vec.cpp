@@ -1,6 +1,7 @@
 #include "Doc2Vec.h"
 #include "TrainThread.h"
 #include "Common.h"
+#include "BinaryModel.h"
 
 #include <vector>
 #include <memory>
@@ -8,38 +9,70 @@
 #include <iostream>
 #include <chrono>
 #include <thread>
+#include <cstring>
+#include <cctype>
 
 using namespace std;
 
-vector<TTrainThreadSpec> TDoc2Vec::CreateThreadsSpecs() const {
-    vector<TTrainThreadSpec> res;
-    auto docsHolders = DocumentsHolder->SplitDocuments(Spec.ThreadCount);
-    for (const auto docsHolder : docsHolders) {
-        res.emplace_back(
-            Spec,
-            NeuralNetwork,
-            WordsVocabulary,
-            NegativeSampleTable,
-            ExpTable,
-            docsHolder
-        );
+string PrecisionToString(EPrecision precision) {
+    return precision == EPrecision::Float ? "float" : "double";
+}
+
+bool ParsePrecision(const string& str, EPrecision& precision) {
+    if (str == "float") {
+        precision = EPrecision::Float;
+    } else if (str == "double") {
+        precision = EPrecision::Double;
+    } else {
+        return false;
     }
-    assert(res.size() == Spec.ThreadCount);
+    return true;
+}
+
+template <typename T>
+vector<TTrainThreadSpec<T>> TDoc2Vec::CreateThreadsSpecs(
+    const shared_ptr<TNeuralNetwork<T>>& neuralNetwork,
+    const shared_ptr<TNegativeSampler>& negativeSampler,
+    const shared_ptr<TTrainProgress>& progress
+) const {
+    vector<TTrainThreadSpec<T>> res;
+    auto scheduler = CorpusStream ? make_shared<TDocumentScheduler>(CorpusStream)
+        : make_shared<TDocumentScheduler>(Corpus, Spec.IterationNumber);
+    for (unsigned int i = 0; i < Spec.ThreadCount; ++i)
+        res.emplace_back(Spec, neuralNetwork, WordsVocabulary, negativeSampler, scheduler, progress, i);
     return res;
 }
 
 void TDoc2Vec::Train() {
+    // Checked before train threads start: they can't report errors
+    if (Spec.BatchNegatives && (Spec.CBOW || Spec.HierarchicalSoftmax || Spec.NegativeSampleNum <= 0))
+        throw runtime_error("TDoc2Vec::Train - batched negatives need skip-gram with negative sampling only.");
+    if (Spec.Precision == EPrecision::Float) {
+        Train(FloatNeuralNetwork);
+    } else {
+        Train(DoubleNeuralNetwork);
+    }
+}
+
+template <typename T>
+void TDoc2Vec::Train(const shared_ptr<TNeuralNetwork<T>>& neuralNetwork) {
     using namespace chrono;
     Spec.Print();
-    auto threadsSpecs = CreateThreadsSpecs();
+    WordsVocabulary->BuildKeepThresholds(Spec.Sample);
+    // Sampler is needed by training only, it isn't built for loaded models
+    shared_ptr<TNegativeSampler> negativeSampler;
+    if (Spec.NegativeSampleNum > 0)
+        negativeSampler = make_shared<TNegativeSampler>(*WordsVocabulary);
+    // Learning rate decays with corpus tokens processed by all threads
+    Progress = make_shared<TTrainProgress>(Spec.Alpha, Spec.ThreadCount, Spec.IterationNumber * GetCorpusTokenCount());
+    auto threadsSpecs = CreateThreadsSpecs(neuralNetwork, negativeSampler, Progress);
     cout << "Training started with " << Spec.ThreadCount << " threads." << endl;
     high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    Progress->Start();
+    if (CorpusStream)
+        CorpusStream->Start(*WordsVocabulary, *DocumentsHolder, Spec.IterationNumber, Spec.ThreadCount);
 
-    // Initial values for alpha
-    Spec.Alpha->SetTotalTrainWords(Spec.IterationNumber * WordsVocabulary->GetTrainWordsCount());
-    Spec.Alpha->StartCounting();
-
-    vector<TTrainThread> trainThreadsObjects;
+    vector<TTrainThread<T>> trainThreadsObjects;
     vector<thread> threads;
     for (const auto& spec : threadsSpecs) {
         trainThreadsObjects.emplace_back(spec);
@@ -48,39 +81,66 @@ void TDoc2Vec::Train() {
 
     for (auto& thread : threads)
         thread.join();
+    Progress->Stop();
+    if (CorpusStream)
+        CorpusStream->Stop();
 
     high_resolution_clock::time_point t2 = high_resolution_clock::now();
     duration<double> time_span = duration_cast<duration<double>>(t2 - t1);
     cout << endl << "Training ended and took " << time_span.count() << " seconds." << endl;
+    if (IsAllocationCountingEnabled()) {
+        double trainWords = static_cast<double>(Spec.IterationNumber) * GetCorpusTokenCount();
+        cout << "Allocations in train threads: " << GetCountedAllocations()
+            << ", per trained word: " << GetCountedAllocations() / trainWords << endl;
+    }
+}
 
-    NeuralNetwork->Normalize();
-}
-
-void TDoc2Vec::InitTables() {
-    ExpTable = make_shared<vector<double>>(EXP_TABLE_SIZE, 0);
-    for (size_t i = 0; i < ExpTable->size(); ++i) {
-        (*ExpTable)[i] = exp((static_cast<double>(i) / EXP_TABLE_SIZE * 2 - 1) * MAX_EXP);
-        (*ExpTable)[i] /= (*ExpTable)[i] + 1;
-    }
-    if (Spec.NegativeSampleNum > 0) {
-        NegativeSampleTable = make_shared<vector<unsigned int>>(NEGATIVE_SAMPLE_TABLE_SIZE, 0);
-        double power = 0.75;
-        unsigned long long trainWordsPower = 0;
-        for (auto it = WordsVocabulary->Begin(); it != WordsVocabulary->End(); ++it)
-            trainWordsPower += static_cast<long long>(pow(it->second->Frequency, power));
-        auto it = WordsVocabulary->Begin();
-        unsigned int wordIndex = it->second->Index;
-        double d1 = pow(it->second->Frequency, power) / trainWordsPower;
-        for (size_t i = 0; i < NegativeSampleTable->size(); ++i) {
-            (*NegativeSampleTable)[i] = wordIndex;
-            if (static_cast<double>(i) / NEGATIVE_SAMPLE_TABLE_SIZE > d1) {
-                if (it != WordsVocabulary->End()) {
-                    ++it;
-                    wordIndex = it->second->Index;
-                }
-                d1 += pow(it->second->Frequency, power) / trainWordsPower;
-            }
-        }
+void TDoc2Vec::FinishTraining() {
+    if (FloatNeuralNetwork)
+        FloatNeuralNetwork->FinishTraining();
+    if (DoubleNeuralNetwork)
+        DoubleNeuralNetwork->FinishTraining();
+}
+
+void TDoc2Vec::ReadCorpus() {
+    DocumentsHolder = make_shared<TDocumentsHolder>();
+    WordsVocabulary = make_shared<TVocabulary>();
+    if (Spec.Stream) {
+        CorpusStream = make_shared<TCorpusStream>(Spec.TrainFilename);
+        CorpusStream->ReadVocabulary(*DocumentsHolder, *WordsVocabulary);
+        WordsVocabulary->BuildHuffmanTree();
+        return;
+    }
+    Corpus = make_shared<TCorpus>();
+    bool cached = !Spec.CorpusCacheFilename.empty()
+        && Corpus->LoadCache(Spec.CorpusCacheFilename, Spec.TrainFilename, *DocumentsHolder, *WordsVocabulary);
+    if (!cached)
+        Corpus->Read(Spec.TrainFilename, *DocumentsHolder, *WordsVocabulary);
+    WordsVocabulary->BuildHuffmanTree();
+    if (!cached && !Spec.CorpusCacheFilename.empty())
+        Corpus->SaveCache(Spec.CorpusCacheFilename, Spec.TrainFilename, *DocumentsHolder, *WordsVocabulary);
+}
+
+void TDoc2Vec::CreateNeuralNetwork() {
+    TLayerOptions options;
+    options.Lockable = !Spec.Hogwild;
+    options.HugePages = Spec.HugePages;
+    // Parallel init only spreads random initialization and page faults of big layers over threads
+    options.InitThreadCount = Spec.ThreadCount;
+    if (Spec.Precision == EPrecision::Float) {
+        FloatNeuralNetwork = make_shared<TNeuralNetwork<float>>(
+            WordsVocabulary->GetSize(),
+            DocumentsHolder->GetSize(),
+            Spec.DimensionSize,
+            options
+        );
+    } else {
+        DoubleNeuralNetwork = make_shared<TNeuralNetwork<double>>(
+            WordsVocabulary->GetSize(),
+            DocumentsHolder->GetSize(),
+            Spec.DimensionSize,
+            options
+        );
     }
 }
 
@@ -91,12 +151,12 @@ void TTrainSpec::Save(std::ofstream& out) const {
     out << DimensionSize << SERIALIZE_DELIM << HierarchicalSoftmax << SERIALIZE_DELIM << CBOW << SERIALIZE_DELIM
         << NegativeSampleNum << SERIALIZE_DELIM << IterationNumber << SERIALIZE_DELIM << WindowSize << SERIALIZE_DELIM
         << Sample << SERIALIZE_DELIM << ThreadCount << SERIALIZE_DELIM
-        << Alpha->Get() << endl;
+        << Alpha->Get() << SERIALIZE_DELIM << PrecisionToString(Precision) << endl;
     out << TrainFilename << endl;
     out << TTrainSpec::CLASS_TAG << endl;
 }
 
-void TTrainSpec::Load(std::ifstream& in) {
+void TTrainSpec::Load(std::ifstream& in, unsigned int version) {
     string buf;
     getline(in, buf);
     if (buf != TTrainSpec::CLASS_TAG)
@@ -106,6 +166,14 @@ void TTrainSpec::Load(std::ifstream& in) {
     double alpha;
     in >> alpha;
     Alpha = make_shared<TAlpha>(alpha);
+    if (version >= 2) {
+        string precision;
+        in >> precision;
+        if (!ParsePrecision(precision, Precision))
+            throw runtime_error("TTrainSpec::Load - unknown precision <" + precision + ">.");
+    } else {
+        Precision = EPrecision::Double;
+    }
     in >> TrainFilename;
     getline(in, buf);
     getline(in, buf);
@@ -113,8 +181,186 @@ void TTrainSpec::Load(std::ifstream& in) {
         throw runtime_error("TTrainSpec::Load - wrong tail.");
 }
 
+void TTrainSpec::SaveBinary(TBinaryModelWriter& writer) const {
+    TBinarySpec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.DimensionSize = DimensionSize;
+    spec.HierarchicalSoftmax = HierarchicalSoftmax;
+    spec.CBOW = CBOW;
+    spec.NegativeSampleNum = NegativeSampleNum;
+    spec.IterationNumber = IterationNumber;
+    spec.WindowSize = WindowSize;
+    spec.ThreadCount = ThreadCount;
+    spec.Precision = static_cast<uint32_t>(Precision);
+    spec.Sample = Sample;
+    spec.Alpha = Alpha->Get();
+
+    writer.BeginSection(EBinarySection::Spec);
+    writer.Write(&spec, sizeof(spec));
+    writer.Write(TrainFilename.data(), TrainFilename.size());
+    writer.EndSection();
+}
+
+void TTrainSpec::LoadBinary(const TBinaryModelReader& reader) {
+    const auto& section = reader.GetSection(EBinarySection::Spec);
+    if (section.Size < sizeof(TBinarySpec))
+        throw runtime_error("TTrainSpec::LoadBinary - wrong spec section.");
+    const TBinarySpec& spec = *reader.GetSectionData<TBinarySpec>(EBinarySection::Spec);
+    DimensionSize = spec.DimensionSize;
+    HierarchicalSoftmax = spec.HierarchicalSoftmax;
+    CBOW = spec.CBOW;
+    NegativeSampleNum = spec.NegativeSampleNum;
+    IterationNumber = spec.IterationNumber;
+    WindowSize = spec.WindowSize;
+    ThreadCount = spec.ThreadCount;
+    if (spec.Precision != static_cast<uint32_t>(EPrecision::Float) && spec.Precision != static_cast<uint32_t>(EPrecision::Double))
+        throw runtime_error("TTrainSpec::LoadBinary - unknown precision " + to_string(spec.Precision) + ".");
+    Precision = static_cast<EPrecision>(spec.Precision);
+    Sample = spec.Sample;
+    Alpha = make_shared<TAlpha>(spec.Alpha);
+    const char* filename = reader.GetSectionData<char>(EBinarySection::Spec) + sizeof(TBinarySpec);
+    TrainFilename.assign(filename, section.Size - sizeof(TBinarySpec));
+}
+
 string TDoc2Vec::CLASS_TAG = "TDoc2Vec";
 
+bool TDoc2Vec::GetWordIndex(const string& word, unsigned int& wordIndex) const {
+    if (BinaryModel)
+        return MappedVocabulary.GetWordIndex(word, wordIndex);
+    TWord wordStruct;
+    if (!WordsVocabulary->GetWord(word, wordStruct))
+        return false;
+    wordIndex = wordStruct.Index;
+    return true;
+}
+
+bool TDoc2Vec::GetWord(unsigned int wordIndex, TWord& word) const {
+    if (BinaryModel)
+        return MappedVocabulary.GetWord(wordIndex, word);
+    return WordsVocabulary->GetWord(wordIndex, word);
+}
+
+bool TDoc2Vec::GetDocumentIndex(const string& docTag, unsigned int& docIndex) const {
+    if (BinaryModel)
+        return MappedDocuments.GetDocumentIndex(docTag, docIndex);
+    TDocument doc;
+    if (!DocumentsHolder->GetDocument(docTag, doc))
+        return false;
+    docIndex = doc.GetIndex();
+    return true;
+}
+
+shared_ptr<TDocument> TDoc2Vec::GetDocument(unsigned int docIndex) const {
+    if (BinaryModel)
+        return make_shared<TDocument>(MappedDocuments.GetRawDocument(docIndex), docIndex);
+    return DocumentsHolder->GetDocument(docIndex);
+}
+
+void TDoc2Vec::Quantize(EQuantization quantization) {
+    if (quantization == EQuantization::None) {
+        WordsQuantized.reset();
+        DocsQuantized.reset();
+        return;
+    }
+    if (WordsQuantized && WordsQuantized->GetQuantization() == quantization
+        && DocsQuantized && DocsQuantized->GetQuantization() == quantization
+    )
+        return;
+
+    using namespace chrono;
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    if (Spec.Precision == EPrecision::Float) {
+        WordsQuantized = make_shared<TQuantizedLayer>(FloatNeuralNetwork->GetWordsNormLayer(), quantization);
+        DocsQuantized = make_shared<TQuantizedLayer>(FloatNeuralNetwork->GetDocsNormLayer(), quantization);
+    } else {
+        WordsQuantized = make_shared<TQuantizedLayer>(DoubleNeuralNetwork->GetWordsNormLayer(), quantization);
+        DocsQuantized = make_shared<TQuantizedLayer>(DoubleNeuralNetwork->GetDocsNormLayer(), quantization);
+    }
+    high_resolution_clock::time_point t2 = high_resolution_clock::now();
+    duration<double> time_span = duration_cast<duration<double>>(t2 - t1);
+    cout << "Quantization to " << QuantizationToString(quantization) << " took " << time_span.count() << " seconds." << endl;
+}
+
+void TDoc2Vec::BuildDocsIndex(unsigned int subspaceNum) {
+    if (subspaceNum == 0) {
+        DocsIndex.reset();
+        return;
+    }
+    if (DocsIndex && DocsIndex->GetSubspaceNum() == subspaceNum)
+        return;
+
+    using namespace chrono;
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+    if (Spec.Precision == EPrecision::Float) {
+        DocsIndex = make_shared<TProductQuantizer>(FloatNeuralNetwork->GetDocsNormLayer(), subspaceNum);
+    } else {
+        DocsIndex = make_shared<TProductQuantizer>(DoubleNeuralNetwork->GetDocsNormLayer(), subspaceNum);
+    }
+    high_resolution_clock::time_point t2 = high_resolution_clock::now();
+    duration<double> time_span = duration_cast<duration<double>>(t2 - t1);
+    cout << "Product quantization index with " << subspaceNum << " subspaces took " << time_span.count() << " seconds." << endl;
+}
+
+void TDoc2Vec::SaveBinary(ofstream& out) const {
+    if (BinaryModel)
+        throw runtime_error("TDoc2Vec::SaveBinary - model is already mapped from binary file.");
+    cout << "Start to save binary model." << endl;
+    using namespace chrono;
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+
+    TBinaryModelWriter writer(out);
+    Spec.SaveBinary(writer);
+    if (Spec.Precision == EPrecision::Float) {
+        FloatNeuralNetwork->SaveBinary(writer);
+    } else {
+        DoubleNeuralNetwork->SaveBinary(writer);
+    }
+    if (WordsQuantized && DocsQuantized) {
+        WordsQuantized->SaveBinary(writer, EBinarySection::Syn0Quantized, EBinarySection::Syn0QuantizedScale);
+        DocsQuantized->SaveBinary(writer, EBinarySection::DSyn0Quantized, EBinarySection::DSyn0QuantizedScale);
+    }
+    if (DocsIndex)
+        DocsIndex->SaveBinary(writer, EBinarySection::DSyn0PQCentroids, EBinarySection::DSyn0PQCodes);
+    WordsVocabulary->SaveBinary(writer);
+    DocumentsHolder->SaveBinary(writer);
+    writer.Finish();
+
+    high_resolution_clock::time_point t2 = high_resolution_clock::now();
+    duration<double> time_span = duration_cast<duration<double>>(t2 - t1);
+    cout << "Saving of binary model finished and took " << time_span.count() << " seconds." << endl;
+}
+
+void TDoc2Vec::LoadBinary(const string& filename) {
+    using namespace chrono;
+    high_resolution_clock::time_point t1 = high_resolution_clock::now();
+
+    BinaryModel = make_shared<TBinaryModelReader>(filename);
+    Spec.LoadBinary(*BinaryModel);
+    if (Spec.Precision == EPrecision::Float) {
+        FloatNeuralNetwork = make_shared<TNeuralNetwork<float>>();
+        FloatNeuralNetwork->Map(*BinaryModel);
+    } else {
+        DoubleNeuralNetwork = make_shared<TNeuralNetwork<double>>();
+        DoubleNeuralNetwork->Map(*BinaryModel);
+    }
+    MappedVocabulary = TMappedVocabulary(*BinaryModel);
+    MappedDocuments = TMappedDocuments(*BinaryModel);
+    if (BinaryModel->HasSection(EBinarySection::Syn0Quantized) && BinaryModel->HasSection(EBinarySection::DSyn0Quantized)) {
+        WordsQuantized = make_shared<TQuantizedLayer>();
+        WordsQuantized->Map(*BinaryModel, EBinarySection::Syn0Quantized, EBinarySection::Syn0QuantizedScale);
+        DocsQuantized = make_shared<TQuantizedLayer>();
+        DocsQuantized->Map(*BinaryModel, EBinarySection::DSyn0Quantized, EBinarySection::DSyn0QuantizedScale);
+    }
+    if (BinaryModel->HasSection(EBinarySection::DSyn0PQCentroids) && BinaryModel->HasSection(EBinarySection::DSyn0PQCodes)) {
+        DocsIndex = make_shared<TProductQuantizer>();
+        DocsIndex->Map(*BinaryModel, EBinarySection::DSyn0PQCentroids, EBinarySection::DSyn0PQCodes);
+    }
+
+    high_resolution_clock::time_point t2 = high_resolution_clock::now();
+    duration<double> time_span = duration_cast<duration<double>>(t2 - t1);
+    cout << "Mapping of binary model finished and took " << time_span.count() << " seconds." << endl;
+}
+
 void TDoc2Vec::Save(std::ofstream& out) const {
     cout << "Start to save model." << endl;
     const unsigned int maxSteps = 4;
@@ -122,10 +368,15 @@ void TDoc2Vec::Save(std::ofstream& out) const {
     high_resolution_clock::time_point t1 = high_resolution_clock::now();
 
     out << TDoc2Vec::CLASS_TAG << endl;
+    out << TEXT_MODEL_VERSION << endl;
     Spec.Save(out);
     PrintProgress(1, maxSteps);
 
-    NeuralNetwork->Save(out);
+    if (Spec.Precision == EPrecision::Float) {
+        FloatNeuralNetwork->Save(out);
+    } else {
+        DoubleNeuralNetwork->Save(out);
+    }
     PrintProgress(2, maxSteps);
 
     DocumentsHolder->Save(out);
@@ -167,13 +418,24 @@ void TDoc2Vec::Load(std::ifstream& in) {
     getline(in, buf);
     if (buf != TDoc2Vec::CLASS_TAG)
         throw runtime_error("TDoc2Vec::Load - wrong header.");
+    unsigned int version = 1;
+    if (isdigit(in.peek())) {
+        in >> version;
+        getline(in, buf);
+        if (version > TEXT_MODEL_VERSION)
+            throw runtime_error("TDoc2Vec::Load - unsupported format version " + to_string(version) + ".");
+    }
 
-    Spec.Load(in);
+    Spec.Load(in, version);
     PrintProgress(1, maxSteps);
 
-    TNeuralNetwork network;
-    network.Load(in);
-    NeuralNetwork = make_shared<TNeuralNetwork>(network);
+    if (Spec.Precision == EPrecision::Float) {
+        FloatNeuralNetwork = make_shared<TNeuralNetwork<float>>();
+        FloatNeuralNetwork->Load(in, version);
+    } else {
+        DoubleNeuralNetwork = make_shared<TNeuralNetwork<double>>();
+        DoubleNeuralNetwork->Load(in, version);
+    }
     PrintProgress(2, maxSteps);
 
     TDocumentsHolder docsHolder;
@@ -186,8 +448,6 @@ void TDoc2Vec::Load(std::ifstream& in) {
     WordsVocabulary = make_shared<TVocabulary>(voc);
     PrintProgress(4, maxSteps);
 
-    InitTables();
-
     getline(in, buf);
     if (buf != TDoc2Vec::CLASS_TAG)
         throw runtime_error("TDoc2Vec::Load - wrong tail.");
@@ -2,74 +2,25 @@
 #include "NeuralNetwork.h"
 #include "Vocabulary.h"
 #include "Common.h"
+#include "System.h"
+#include "BinaryModel.h"
+#include "Quantization.h"
+#include "ProductQuantization.h"
+#include "NegativeSampler.h"
+#include "Sigmoid.h"
+#include "Corpus.h"
+#include "TrainProgress.h"
+#include "DocumentScheduler.h"
 
 #include <string>
 #include <memory>
-#include <atomic>
 #include <iostream>
 #include <chrono>
-#include <mutex>
 
 void PrintProgress(unsigned int cur, unsigned int max);
 
-class TAlpha {
-public:
-    TAlpha(double init)
-        : InitialValue(init)
-        , CurrentValue(init)
-        , WordCountActual(0)
-        , LastWordCount(0)
-        , TotalTrainWords(0)
-    {}
-
-    TAlpha(const TAlpha& another)
-        : InitialValue(another.InitialValue)
-        , CurrentValue(another.CurrentValue)
-        , LastWordCount(another.LastWordCount)
-        , TotalTrainWords(another.TotalTrainWords)
-    {}
-
-    double Get() {
-        return CurrentValue;
-    }
-
-    void Update(unsigned long long processedWordCount) {
-        WordCountActual += processedWordCount;
-
-        if (WordCountActual - LastWordCount > UPDATE_WORD_NUMBER) {
-            if (!Mutex.try_lock())
-                return;
-            LastWordCount = WordCountActual;
-            std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
-            std::chrono::duration<double> time_span = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - TimePoint);
-            double wordsBySec = static_cast<double>(WordCountActual) / time_span.count() / 1000;
-            double progress = static_cast<double>(WordCountActual) / (TotalTrainWords);
-            double updatedAlpha = InitialValue * (1 - progress);
-            if (updatedAlpha > InitialValue  * ALPHA_MAX_REDUCE_COEFFICENT)
-                CurrentValue = updatedAlpha;
-
-            std::cout << "\r" << "Alpha: " << CurrentValue << " Progress: " << progress * 100
-                << "% Words/Sec: " << wordsBySec << "k"<< std::flush;
-            Mutex.unlock();
-        }
-    }
-
-    void StartCounting() {
-        TimePoint = std::chrono::high_resolution_clock::now();
-    }
-
-    void SetTotalTrainWords(unsigned long long totalTrainWords) {
-        TotalTrainWords = totalTrainWords;
-    }
-private:
-    const double InitialValue;
-    double CurrentValue;
-    std::atomic<unsigned long long> WordCountActual;
-    unsigned long long LastWordCount;
-    unsigned long long TotalTrainWords;
-    std::mutex Mutex;
-    std::chrono::high_resolution_clock::time_point TimePoint;
-};
+std::string PrecisionToString(EPrecision precision);
+bool ParsePrecision(const std::string& str, EPrecision& precision);
 
 struct TTrainSpec {
     TTrainSpec()
@@ -81,11 +32,21 @@ struct TTrainSpec {
         , WindowSize(DEFAULT_WINDOW_SIZE)
         , Sample(DEFAULT_SAMPLE)
         , ThreadCount(DEFAULT_THREAD_COUNT)
+        , Precision(DEFAULT_PRECISION)
+        , Hogwild(DEFAULT_HOGWILD)
+        , HugePages(DEFAULT_HUGE_PAGES)
+        , PinThreads(DEFAULT_PIN_THREADS)
+        , BatchNegatives(DEFAULT_BATCH_NEGATIVES)
+        , Sigmoid(DEFAULT_SIGMOID)
+        , Stream(DEFAULT_STREAM)
         , Alpha(new TAlpha(DEFAULT_ALPHA))
     {}
 
     void Save(std::ofstream& out) const;
-    void Load(std::ifstream& in);
+    // version is the text model format version, see TEXT_MODEL_VERSION
+    void Load(std::ifstream& in, unsigned int version = TEXT_MODEL_VERSION);
+    void SaveBinary(TBinaryModelWriter& writer) const;
+    void LoadBinary(const TBinaryModelReader& reader);
 
     void Print() const {
         std::cout << "Training specs:" << std::endl
@@ -97,8 +58,16 @@ struct TTrainSpec {
             << '\t' << "WindowSize: " << WindowSize << std::endl
             << '\t' << "Sample: " << Sample << std::endl
             << '\t' << "ThreadCount: " << ThreadCount << std::endl
+            << '\t' << "Precision: " << PrecisionToString(Precision) << std::endl
+            << '\t' << "Hogwild: " << Hogwild << std::endl
+            << '\t' << "HugePages: " << HugePagesToString(HugePages) << std::endl
+            << '\t' << "PinThreads: " << PinThreads << std::endl
+            << '\t' << "BatchNegatives: " << BatchNegatives << std::endl
+            << '\t' << "Sigmoid: " << SigmoidToString(Sigmoid) << std::endl
             << '\t' << "Alpha: " << Alpha->Get() << std::endl
-            << '\t' << "Dataset filename: " << TrainFilename << std::endl;
+            << '\t' << "Dataset filename: " << TrainFilename << std::endl
+            << '\t' << "Corpus cache filename: " << CorpusCacheFilename << std::endl
+            << '\t' << "Stream: " << Stream << std::endl;
     }
 
 public:
@@ -110,20 +79,34 @@ public:
     unsigned int WindowSize;
     double Sample;
     unsigned int ThreadCount;
+    EPrecision Precision;
+    bool Hogwild;
+    EHugePages HugePages;
+    bool PinThreads;
+    // Skip-gram with negative sampling only: context words and document vector of a window are trained against
+    // its central word and negatives shared by all of them, plain skip-gram trains every context word against itself
+    bool BatchNegatives;
+    ESigmoid Sigmoid;
     std::string TrainFilename;
+    // Tokenized dataset cache, empty to tokenize dataset on every run
+    std::string CorpusCacheFilename;
+    // Dataset is read from disk on every epoch instead of being kept in memory
+    bool Stream;
     std::shared_ptr<TAlpha> Alpha;
 
     static std::string CLASS_TAG;
 };
 
+template <typename T>
 struct TTrainThreadSpec {
     TTrainThreadSpec(
         const TTrainSpec& Spec,
-        const std::shared_ptr<TNeuralNetwork>& neuralNetwork,
+        const std::shared_ptr<TNeuralNetwork<T>>& neuralNetwork,
         const std::shared_ptr<TVocabulary>& wordsVocabulary,
-        const std::shared_ptr<std::vector<unsigned int>>& negativeSampleTable,
-        const std::shared_ptr<std::vector<double>>& expTable,
-        const TDocumentsHolder& documentsHolder
+        const std::shared_ptr<TNegativeSampler>& negativeSampler,
+        const std::shared_ptr<TDocumentScheduler>& scheduler,
+        const std::shared_ptr<TTrainProgress>& progress,
+        unsigned int threadIndex
     )
         : IterationNumber(Spec.IterationNumber)
         , Alpha(Spec.Alpha)
@@ -133,11 +116,15 @@ struct TTrainThreadSpec {
         , NegativeSampleNum(Spec.NegativeSampleNum)
         , DimensionSize(Spec.DimensionSize)
         , Sample(Spec.Sample)
+        , PinThreads(Spec.PinThreads)
+        , BatchNegatives(Spec.BatchNegatives)
+        , Sigmoid(Spec.Sigmoid)
+        , ThreadIndex(threadIndex)
         , NeuralNetwork(neuralNetwork)
         , WordsVocabulary(wordsVocabulary)
-        , NegativeSampleTable(negativeSampleTable)
-        , ExpTable(expTable)
-        , DocumentsHolder(documentsHolder)
+        , NegativeSampler(negativeSampler)
+        , Scheduler(scheduler)
+        , Progress(progress)
     {}
 
 public:
@@ -149,11 +136,17 @@ public:
     unsigned int NegativeSampleNum;
     unsigned int DimensionSize;
     double Sample;
-    std::shared_ptr<TNeuralNetwork> NeuralNetwork;
+    bool PinThreads;
+    bool BatchNegatives;
+    ESigmoid Sigmoid;
+    unsigned int ThreadIndex;
+    std::shared_ptr<TNeuralNetwork<T>> NeuralNetwork;
     std::shared_ptr<TVocabulary> WordsVocabulary;
-    std::shared_ptr<std::vector<unsigned int>> NegativeSampleTable;
-    std::shared_ptr<std::vector<double>> ExpTable;
-    TDocumentsHolder DocumentsHolder;
+    // nullptr without negative sampling
+    std::shared_ptr<TNegativeSampler> NegativeSampler;
+    // Shared by all threads of training
+    std::shared_ptr<TDocumentScheduler> Scheduler;
+    std::shared_ptr<TTrainProgress> Progress;
 };
 
 class TDoc2Vec {
@@ -164,26 +157,24 @@ public:
         : Spec(spec)
     {
         std::cout << "Model creation started." << std::endl;
-        unsigned int maxSteps = 4;
+        unsigned int maxSteps = 3;
         using namespace std::chrono;
         high_resolution_clock::time_point t1 = high_resolution_clock::now();
 
         PrintProgress(0, maxSteps);
-        DocumentsHolder = std::make_shared<TDocumentsHolder>(Spec.TrainFilename);
-        PrintProgress(1, maxSteps);
-        WordsVocabulary = std::make_shared<TVocabulary>(DocumentsHolder->CreateWordsVocabulary());
+        ReadCorpus();
         PrintProgress(2, maxSteps);
-        NeuralNetwork = std::make_shared<TNeuralNetwork>(
-            WordsVocabulary->GetSize(),
-            DocumentsHolder->GetSize(),
-            Spec.DimensionSize
-        );
-        PrintProgress(3, maxSteps);
-        InitTables();
+        CreateNeuralNetwork();
         PrintProgress(maxSteps, maxSteps);
 
         DocumentsHolder->PrintInfo();
         WordsVocabulary->PrintInfo("Words vocabulary");
+        if (Corpus) {
+            std::cout << "Corpus of " << Corpus->GetTokenCount() << " tokens was "
+                << (Corpus->IsLoadedFromCache() ? "loaded from cache" : "tokenized") << "." << std::endl;
+        } else {
+            std::cout << "Corpus of " << CorpusStream->GetTokenCount() << " tokens will be streamed from dataset." << std::endl;
+        }
 
         high_resolution_clock::time_point t2 = high_resolution_clock::now();
         duration<double> time_span = duration_cast<duration<double>>(t2 - t1);
@@ -191,32 +182,103 @@ public:
     }
 
     void Train();
+    // Normalizes raw word and document vectors in place instead of keeping normalized copies,
+    // the model can't be trained or saved as text after it
+    void FinishTraining();
 
-    const TNeuralNetwork& GetNeuralNetwork() const {
-        return *NeuralNetwork;
+    EPrecision GetPrecision() const {
+        return Spec.Precision;
     }
 
-    const TVocabulary& GetWordsVocabulary() const {
-        return *WordsVocabulary;
+    // Progress of the last Train call, nullptr before training
+    const TTrainProgress* GetTrainProgress() const {
+        return Progress.get();
     }
 
-    const TDocumentsHolder& GetDocsHolder() const {
-        return *DocumentsHolder;
+    template <typename T>
+    const TNeuralNetwork<T>& GetNeuralNetwork() const;
+
+    // Queries work both for models loaded from text and for mapped binary models
+    bool GetWordIndex(const std::string& word, unsigned int& wordIndex) const;
+    bool GetWord(unsigned int wordIndex, TWord& word) const;
+    bool GetDocumentIndex(const std::string& docTag, unsigned int& docIndex) const;
+    std::shared_ptr<TDocument> GetDocument(unsigned int docIndex) const;
+
+    // Builds quantized copies of normalized word and document layers, None drops them.
+    // Quantized layers mapped from binary model are reused when quantization matches.
+    void Quantize(EQuantization quantization);
+    // nullptr if model isn't quantized
+    const TQuantizedLayer* GetWordsQuantizedLayer() const {
+        return WordsQuantized.get();
+    }
+    const TQuantizedLayer* GetDocsQuantizedLayer() const {
+        return DocsQuantized.get();
+    }
+
+    // Trains product quantization index of normalized document vectors, 0 subspaces drops it.
+    // Index mapped from binary model is reused when number of subspaces matches.
+    void BuildDocsIndex(unsigned int subspaceNum);
+    // nullptr if model doesn't have index
+    const TProductQuantizer* GetDocsIndex() const {
+        return DocsIndex.get();
     }
 
     void Save(std::ofstream& out) const;
     void Load(std::ifstream& in);
+    void SaveBinary(std::ofstream& out) const;
+    // Maps binary model file, nothing is parsed or copied
+    void LoadBinary(const std::string& filename);
 
 private:
-    void InitTables();
-    std::vector<TTrainThreadSpec> CreateThreadsSpecs() const;
+    // Tokenizes dataset into Corpus with DocumentsHolder and WordsVocabulary, or loads them from corpus cache.
+    // Streaming training builds DocumentsHolder and WordsVocabulary only and sets CorpusStream.
+    void ReadCorpus();
+    uint64_t GetCorpusTokenCount() const {
+        return Corpus ? Corpus->GetTokenCount() : CorpusStream->GetTokenCount();
+    }
+    void CreateNeuralNetwork();
+
+    template <typename T>
+    void Train(const std::shared_ptr<TNeuralNetwork<T>>& neuralNetwork);
+
+    template <typename T>
+    std::vector<TTrainThreadSpec<T>> CreateThreadsSpecs(
+        const std::shared_ptr<TNeuralNetwork<T>>& neuralNetwork,
+        const std::shared_ptr<TNegativeSampler>& negativeSampler,
+        const std::shared_ptr<TTrainProgress>& progress
+    ) const;
 private:
     TTrainSpec Spec;
-    std::shared_ptr<TNeuralNetwork> NeuralNetwork;
+    // Only the network matching Spec.Precision is set
+    std::shared_ptr<TNeuralNetwork<float>> FloatNeuralNetwork;
+    std::shared_ptr<TNeuralNetwork<double>> DoubleNeuralNetwork;
     std::shared_ptr<TDocumentsHolder> DocumentsHolder;
     std::shared_ptr<TVocabulary> WordsVocabulary;
-    std::shared_ptr<std::vector<double>> ExpTable;
-    std::shared_ptr<std::vector<unsigned int>> NegativeSampleTable;
+    // Set only for models created for training, one of them
+    std::shared_ptr<TCorpus> Corpus;
+    std::shared_ptr<TCorpusStream> CorpusStream;
+    std::shared_ptr<TTrainProgress> Progress;
+    // Set instead of DocumentsHolder and WordsVocabulary when model is mapped from binary file
+    std::shared_ptr<TBinaryModelReader> BinaryModel;
+    TMappedVocabulary MappedVocabulary;
+    TMappedDocuments MappedDocuments;
+    std::shared_ptr<TQuantizedLayer> WordsQuantized;
+    std::shared_ptr<TQuantizedLayer> DocsQuantized;
+    std::shared_ptr<TProductQuantizer> DocsIndex;
 
     static std::string CLASS_TAG;
 };
+
+template <>
+inline const TNeuralNetwork<float>& TDoc2Vec::GetNeuralNetwork<float>() const {
+    if (!FloatNeuralNetwork)
+        throw std::runtime_error("GetNeuralNetwork - model doesn't have float precision.");
+    return *FloatNeuralNetwork;
+}
+
+template <>
+inline const TNeuralNetwork<double>& TDoc2Vec::GetNeuralNetwork<double>() const {
+    if (!DoubleNeuralNetwork)
+        throw std::runtime_error("GetNeuralNetwork - model doesn't have double precision.");
+    return *DoubleNeuralNetwork;
+}
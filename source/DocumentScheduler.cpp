@@ -0,0 +1,36 @@
+#include "DocumentScheduler.h"
+#include "Common.h"
+
+#include <vector>
+#include <memory>
+#include <stdexcept>
+
+using namespace std;
+
+TDocumentScheduler::TDocumentScheduler(const shared_ptr<const TCorpus>& corpus, unsigned int iterationNumber)
+    : Corpus(corpus)
+    , Cursor(0)
+{
+    if (Corpus->GetSize() == 0)
+        throw runtime_error("TDocumentScheduler - corpus is empty.");
+
+    // Chunks end on document boundaries, a document longer than chunk size is a chunk by itself
+    Bounds.push_back(0);
+    uint64_t chunkTokens = 0;
+    for (unsigned int doc = 0; doc < Corpus->GetSize(); ++doc) {
+        chunkTokens += Corpus->GetDocumentLength(doc);
+        if (chunkTokens >= SCHEDULER_CHUNK_TOKEN_NUMBER) {
+            Bounds.push_back(doc + 1);
+            chunkTokens = 0;
+        }
+    }
+    if (Bounds.back() != Corpus->GetSize())
+        Bounds.push_back(Corpus->GetSize());
+    TicketNum = static_cast<uint64_t>(iterationNumber) * (Bounds.size() - 1);
+}
+
+TDocumentScheduler::TDocumentScheduler(const shared_ptr<TCorpusStream>& stream)
+    : Stream(stream)
+    , TicketNum(0)
+    , Cursor(0)
+{}
@@ -0,0 +1,52 @@
+#pragma once
+#include "Corpus.h"
+#include "CorpusStream.h"
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Hands out contiguous document chunks to train threads.
+ * In memory corpus is cut into chunks of about SCHEDULER_CHUNK_TOKEN_NUMBER tokens.
+ * All epochs are one sequence of chunks with a shared atomic cursor: a thread takes the next chunk
+ * as soon as it is done with the previous one, so threads finish at about the same time
+ * whatever the document lengths and thread count are.
+ * Streamed corpus gives chunks in order its readers fill them.
+ */
+class TDocumentScheduler {
+public:
+    TDocumentScheduler(const std::shared_ptr<const TCorpus>& corpus, unsigned int iterationNumber);
+    explicit TDocumentScheduler(const std::shared_ptr<TCorpusStream>& stream);
+
+    // Returns false when chunks of all epochs are taken
+    bool Next(TDocumentChunk& chunk) {
+        if (Stream)
+            return Stream->Next(chunk);
+        uint64_t ticket = Cursor.fetch_add(1, std::memory_order_relaxed);
+        if (ticket >= TicketNum)
+            return false;
+        size_t index = ticket % (Bounds.size() - 1);
+        chunk = Corpus->GetChunk(Bounds[index], Bounds[index + 1]);
+        return true;
+    }
+
+    // Chunk isn't used after it
+    void Release(const TDocumentChunk& chunk) {
+        if (Stream)
+            Stream->Release(chunk);
+    }
+
+    size_t GetMaxDocumentLength() const {
+        return Stream ? Stream->GetMaxDocumentLength() : Corpus->GetMaxDocumentLength();
+    }
+
+private:
+    std::shared_ptr<const TCorpus> Corpus;
+    std::shared_ptr<TCorpusStream> Stream;
+    // Chunk i is documents [Bounds[i], Bounds[i + 1])
+    std::vector<unsigned int> Bounds;
+    uint64_t TicketNum;
+    std::atomic<uint64_t> Cursor;
+};
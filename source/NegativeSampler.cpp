@@ -0,0 +1,51 @@
+#include "NegativeSampler.h"
+#include "Common.h"
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+using namespace std;
+
+TNegativeSampler::TNegativeSampler(const TVocabulary& vocabulary) {
+    if (vocabulary.GetSize() == 0)
+        throw runtime_error("TNegativeSampler - vocabulary is empty.");
+
+    Slots.resize(vocabulary.GetSize());
+    vector<double> weights(Slots.size());
+    double totalWeight = 0;
+    size_t i = 0;
+    for (auto it = vocabulary.Begin(); it != vocabulary.End(); ++it, ++i) {
+        Slots[i].Word = it->second->Index;
+        weights[i] = pow(it->second->Frequency, NEGATIVE_SAMPLE_POWER);
+        totalWeight += weights[i];
+    }
+
+    // Vose's variant: slots with weight below the mean are topped up by aliases to slots above it
+    vector<size_t> small, large;
+    for (i = 0; i < Slots.size(); ++i) {
+        weights[i] *= Slots.size() / totalWeight;
+        (weights[i] < 1 ? small : large).push_back(i);
+    }
+    while (!small.empty() && !large.empty()) {
+        size_t less = small.back(), more = large.back();
+        small.pop_back();
+        Slots[less].Threshold = static_cast<uint32_t>(weights[less] * 4294967296.0);
+        Slots[less].Alias = Slots[more].Word;
+        weights[more] -= 1 - weights[less];
+        if (weights[more] < 1) {
+            large.pop_back();
+            small.push_back(more);
+        }
+    }
+    // Leftovers have weight 1 up to rounding errors
+    for (size_t slot : small) {
+        Slots[slot].Threshold = UINT32_MAX;
+        Slots[slot].Alias = Slots[slot].Word;
+    }
+    for (size_t slot : large) {
+        Slots[slot].Threshold = UINT32_MAX;
+        Slots[slot].Alias = Slots[slot].Word;
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "Vocabulary.h"
+#include "Random.h"
+
+#include <vector>
+#include <cstdint>
+
+/*
+ * Draws words from the unigram distribution raised to NEGATIVE_SAMPLE_POWER with Walker's alias method.
+ * Table has one slot per vocabulary word: a slot keeps its word with probability Threshold / 2^32,
+ * otherwise it gives its alias. Sampling is two random numbers and one 12 byte slot read.
+ */
+class TNegativeSampler {
+public:
+    explicit TNegativeSampler(const TVocabulary& vocabulary);
+
+    unsigned int Sample(TFastRandom& random) const {
+        const TSlot& slot = Slots[random.NextIndex(static_cast<uint32_t>(Slots.size()))];
+        return random.Next() < slot.Threshold ? slot.Word : slot.Alias;
+    }
+
+    size_t Size() const {
+        return Slots.size();
+    }
+
+private:
+    struct TSlot {
+        uint32_t Threshold;
+        uint32_t Word;
+        uint32_t Alias;
+    };
+
+    std::vector<TSlot> Slots;
+};
@@ -3,6 +3,7 @@
 
 #include <fstream>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -12,15 +13,15 @@ string TLayerVector<T>::CLASS_TAG = "TLayerVector";
 template <typename T>
 void TLayerVector<T>::Save(ofstream& out) const {
     out << CLASS_TAG << endl;
-    out << Vector.size() << endl;
-    for (const auto& it : Vector)
-        out << it << SERIALIZE_DELIM;
+    out << Dim << endl;
+    for (size_t i = 0; i < Dim; ++i)
+        out << Data[i] << SERIALIZE_DELIM;
     out << endl;
     out << CLASS_TAG << endl;
 }
 
 template <typename T>
-void TLayerVector<T>::Load(ifstream& in) {
+void TLayerVector<T>::LoadValues(ifstream& in, vector<T>& values) {
     string buf;
     getline(in, buf);
     if (buf != TLayerVector::CLASS_TAG)
@@ -29,9 +30,9 @@ void TLayerVector<T>::Load(ifstream& in) {
     in >> size;
     getline(in, buf);
 
-    Vector.resize(size);
+    values.resize(size);
     for (size_t i = 0; i < size; ++i)
-        in >> Vector[i];
+        in >> values[i];
 
     getline(in, buf);
     getline(in, buf);
@@ -42,12 +43,26 @@ void TLayerVector<T>::Load(ifstream& in) {
 template <typename T>
 string TLayer<T>::CLASS_TAG = "TLayer";
 
+template <typename T>
+void TLayer<T>::Allocate(unsigned int size, unsigned int dim, const TLayerOptions& options) {
+    Rows = size;
+    Dimension = dim;
+    HugePages = options.HugePages;
+    size_t rowBytes = (dim * sizeof(T) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    RowStride = rowBytes / sizeof(T);
+
+    TMemoryDeleter deleter;
+    void* ptr = AllocateMemory(BufferSize() * sizeof(T), HugePages, deleter);
+    Weights = unique_ptr<T, TMemoryDeleter>(static_cast<T*>(ptr), deleter);
+    Mutexes.reset(options.Lockable ? new mutex[size] : nullptr);
+}
+
 template <typename T>
 void TLayer<T>::Save(std::ofstream& out) const {
     out << CLASS_TAG << endl;
-    out << weights.size() << endl;
-    for (const auto& vec : weights)
-        vec.Save(out);
+    out << Rows << endl;
+    for (size_t i = 0; i < Rows; ++i)
+        (*this)[i].Save(out);
     out << CLASS_TAG << endl;
 
 }
@@ -62,32 +77,79 @@ void TLayer<T>::Load(std::ifstream& in) {
     in >> size;
     getline(in, buf);
 
-    weights.resize(size);
-    for (size_t i = 0; i < size; ++i)
-        weights[i].Load(in);
+    vector<T> values;
+    for (size_t i = 0; i < size; ++i) {
+        TLayerVector<T>::LoadValues(in, values);
+        if (i == 0)
+            Allocate(size, values.size(), TLayerOptions());
+        else if (values.size() != Dimension)
+            throw runtime_error("TLayer::Load - vectors of different size.");
+        copy(values.begin(), values.end(), Row(i));
+        fill(Row(i) + Dimension, Row(i) + RowStride, static_cast<T>(0));
+    }
+    if (size == 0)
+        Allocate(0, 0, TLayerOptions());
 
     getline(in, buf);
     if (buf != TLayer::CLASS_TAG)
         throw runtime_error("TLayer::Load - wrong tail.");
 }
 
-string TNeuralNetwork::CLASS_TAG = "TNeuralNetwork";
+template <typename T>
+void TLayer<T>::SaveBinary(TBinaryModelWriter& writer, EBinarySection section, bool normalize) const {
+    writer.BeginSection(section, sizeof(T), Rows, Dimension, RowStride);
+    if (normalize) {
+        const TVectorKernels<T>& kernels = GetVectorKernels<T>(Dimension);
+        vector<T> normRow(RowStride, 0);
+        for (size_t i = 0; i < Rows; ++i) {
+            NormalizeVector(Row(i), normRow.data(), Dimension, kernels);
+            writer.Write(normRow.data(), RowStride * sizeof(T));
+        }
+    } else {
+        writer.Write(Weights.get(), BufferSize() * sizeof(T));
+    }
+    writer.EndSection();
+}
+
+template <typename T>
+void TLayer<T>::Map(const TBinaryModelReader& reader, EBinarySection sectionId) {
+    const auto& section = reader.GetSection(sectionId);
+    if (section.ElementSize != sizeof(T) || section.Rows * section.Stride * sizeof(T) != section.Size
+        || section.Dim > section.Stride
+    )
+        throw runtime_error("TLayer::Map - wrong layer section.");
+    Rows = section.Rows;
+    Dimension = section.Dim;
+    RowStride = section.Stride;
+    HugePages = EHugePages::None;
+
+    // Mapping is read-only, the view must not be trained
+    TMemoryDeleter deleter;
+    deleter.Owned = false;
+    Weights = unique_ptr<T, TMemoryDeleter>(const_cast<T*>(reader.GetSectionData<T>(sectionId)), deleter);
+    Mutexes.reset();
+}
+
+template <typename T>
+string TNeuralNetwork<T>::CLASS_TAG = "TNeuralNetwork";
 
-void TNeuralNetwork::Save(std::ofstream& out) const {
+template <typename T>
+void TNeuralNetwork<T>::Save(std::ofstream& out) const {
+    if (NormalizedInPlace)
+        throw runtime_error("TNeuralNetwork::Save - raw vectors are already normalized by FinishTraining.");
     out << TNeuralNetwork::CLASS_TAG << endl;
     out << MiddleDimension << SERIALIZE_DELIM << VocabularySize << SERIALIZE_DELIM << CorpusSize << endl;
 
     Syn0.Save(out);
     DSyn0.Save(out);
-    Syn0Norm.Save(out);
-    DSyn0Norm.Save(out);
     Syn1.Save(out);
     Syn1Neg.Save(out);
 
     out << TNeuralNetwork::CLASS_TAG << endl;
 }
 
-void TNeuralNetwork::Load(std::ifstream& in) {
+template <typename T>
+void TNeuralNetwork<T>::Load(std::ifstream& in, unsigned int version) {
     string buf;
     getline(in, buf);
     if (buf != TNeuralNetwork::CLASS_TAG)
@@ -97,8 +159,12 @@ void TNeuralNetwork::Load(std::ifstream& in) {
 
     Syn0.Load(in);
     DSyn0.Load(in);
-    Syn0Norm.Load(in);
-    DSyn0Norm.Load(in);
+    if (version < 2) {
+        // Normalized layers of old models are dropped, they are built from raw ones on first use
+        TLayer<T> legacyNorm;
+        legacyNorm.Load(in);
+        legacyNorm.Load(in);
+    }
     Syn1.Load(in);
     Syn1Neg.Load(in);
 
@@ -106,3 +172,43 @@ void TNeuralNetwork::Load(std::ifstream& in) {
     if (buf != TNeuralNetwork::CLASS_TAG)
         throw runtime_error("TNeuralNetwork::Load - wrong tail.");
 }
+
+template <typename T>
+void TNeuralNetwork<T>::SaveBinary(TBinaryModelWriter& writer) const {
+    // Queries need only normalized word and document vectors, so raw ones aren't written.
+    // Unless normalized layers exist already, rows are normalized one by one while written to avoid a copy of the layers.
+    const TLayer<T>& words = WordsNorm ? *WordsNorm : Syn0;
+    const TLayer<T>& docs = DocsNorm ? *DocsNorm : DSyn0;
+    words.SaveBinary(writer, EBinarySection::Syn0Norm, /*normalize*/ !WordsNorm);
+    docs.SaveBinary(writer, EBinarySection::DSyn0Norm, /*normalize*/ !DocsNorm);
+    Syn1.SaveBinary(writer, EBinarySection::Syn1);
+    Syn1Neg.SaveBinary(writer, EBinarySection::Syn1Neg);
+}
+
+template <typename T>
+void TNeuralNetwork<T>::Map(const TBinaryModelReader& reader) {
+    if (reader.HasSection(EBinarySection::Syn0))
+        Syn0.Map(reader, EBinarySection::Syn0);
+    if (reader.HasSection(EBinarySection::DSyn0))
+        DSyn0.Map(reader, EBinarySection::DSyn0);
+    if (reader.HasSection(EBinarySection::Syn0Norm)) {
+        Syn0Norm.Map(reader, EBinarySection::Syn0Norm);
+        WordsNorm = &Syn0Norm;
+    }
+    if (reader.HasSection(EBinarySection::DSyn0Norm)) {
+        DSyn0Norm.Map(reader, EBinarySection::DSyn0Norm);
+        DocsNorm = &DSyn0Norm;
+    }
+    Syn1.Map(reader, EBinarySection::Syn1);
+    Syn1Neg.Map(reader, EBinarySection::Syn1Neg);
+    MiddleDimension = Syn1.Dim();
+    VocabularySize = Syn1.Size();
+    CorpusSize = DocsNorm ? DocsNorm->Size() : DSyn0.Size();
+}
+
+template class TLayerVector<float>;
+template class TLayerVector<double>;
+template class TLayer<float>;
+template class TLayer<double>;
+template class TNeuralNetwork<float>;
+template class TNeuralNetwork<double>;
@@ -1,4 +1,9 @@
 #pragma once
+#include "Common.h"
+#include "System.h"
+#include "BinaryModel.h"
+#include "VectorKernels.h"
+
 #include <vector>
 #include <random>
 #include <stdexcept>
@@ -7,57 +12,67 @@
 #include <mutex>
 #include <fstream>
 #include <string>
+#include <memory>
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
 
 template <typename T>
 class TLayerVector {
 public:
-    TLayerVector() {}
-
-    TLayerVector(unsigned int size, T value)
-        : Vector(size, value)
-    {}
-
-    TLayerVector(const std::vector<T>& vec)
-        : Vector(vec)
+    TLayerVector()
+        : Data(nullptr)
+        , Dim(0)
+        , Mutex(nullptr)
     {}
 
-    TLayerVector(const TLayerVector& another)
-        : Vector(another.Vector)
+    TLayerVector(T* data, unsigned int dim, std::mutex* mutex)
+        : Data(data)
+        , Dim(dim)
+        , Mutex(mutex)
     {}
 
+    // Rows of layers without locks (hogwild training, query-only models) have no mutex
     void Lock() {
-        Mutex.lock();
+        if (Mutex)
+            Mutex->lock();
     }
 
     void Unlock() {
-        Mutex.unlock();
+        if (Mutex)
+            Mutex->unlock();
     }
 
     T& operator[](unsigned int i) {
-        return Vector[i];
+        return Data[i];
     }
 
     const T& operator[](unsigned int i) const {
-        return Vector[i];
+        return Data[i];
     }
 
     unsigned int Size() const {
-        return Vector.size();
+        return Dim;
     }
 
-    typename std::vector<T>::const_iterator Begin() const {
-        return Vector.cbegin();
+    T* Begin() {
+        return Data;
     }
 
-    typename std::vector<T>::const_iterator End() const {
-        return Vector.cend();
+    const T* Begin() const {
+        return Data;
+    }
+
+    const T* End() const {
+        return Data + Dim;
     }
 
     void Save(std::ofstream& out) const;
-    void Load(std::ifstream& in);
+    static void LoadValues(std::ifstream& in, std::vector<T>& values);
 private:
-    std::vector<T> Vector;
-    std::mutex Mutex;
+    T* Data;
+    unsigned int Dim;
+    std::mutex* Mutex;
     static std::string CLASS_TAG;
 };
 
@@ -81,8 +96,8 @@ private:
 template <typename T>
 class TLayerCreatorZeroPad {
 public:
-    std::vector<TLayerVector<T>> operator()(unsigned int layerSize, unsigned int dim) {
-        return std::vector<TLayerVector<T>>(layerSize, TLayerVector<T>(dim, 0));
+    void operator()(size_t, T* row, unsigned int dim) {
+        std::fill(row, row + dim, static_cast<T>(0));
     }
 };
 
@@ -94,158 +109,315 @@ public:
         , UpperBoarder(0.5)
     {}
 
-    std::vector<TLayerVector<T>> operator()(unsigned int layerSize, unsigned int dim) {
-        std::vector<TLayerVector<T>> layer;
-        std::default_random_engine generator;
+    // Every row has its own generator, so the result doesn't depend on how rows are split between threads
+    void operator()(size_t rowIndex, T* row, unsigned int dim) {
+        unsigned long long seed = (rowIndex + 1) * 0x9E3779B97F4A7C15ULL;
+        seed = (seed ^ (seed >> 31)) % std::minstd_rand0::modulus;
+        std::minstd_rand0 generator(static_cast<std::minstd_rand0::result_type>(seed));
         std::uniform_real_distribution<T> distribution(LowerBoarder, UpperBoarder);
-        for (size_t i = 0; i < layerSize; ++i) {
-            std::vector<T> tmpVector(dim);
-            for (auto& it : tmpVector)
-                it = distribution(generator);
-            layer.emplace_back(tmpVector);
-        }
-        return layer;
+        for (size_t j = 0; j < dim; ++j)
+            row[j] = distribution(generator);
     }
 private:
     T LowerBoarder, UpperBoarder;
 };
 
+struct TLayerOptions {
+    TLayerOptions()
+        : Lockable(false)
+        , HugePages(EHugePages::None)
+        , InitThreadCount(1)
+    {}
+
+    bool Lockable;
+    EHugePages HugePages;
+    // Rows are initialized by this many threads, each one fills a contiguous part of rows
+    unsigned int InitThreadCount;
+};
 
+// Weights of the whole layer live in one cache-line-aligned rows x stride buffer,
+// rows are padded to a cache line multiple. operator[] hands out lightweight row views.
 template <typename T>
 class TLayer {
 public:
-    TLayer() {}
+    TLayer()
+        : Rows(0)
+        , Dimension(0)
+        , RowStride(0)
+        , HugePages(EHugePages::None)
+    {}
 
     template <class LayerCreator = TLayerCreatorZeroPad<T>>
-    TLayer(unsigned int size, unsigned int dim, LayerCreator layerCreator = LayerCreator())
-        : weights(layerCreator(size, dim))
-    {}
+    TLayer(
+        unsigned int size,
+        unsigned int dim,
+        LayerCreator layerCreator = LayerCreator(),
+        const TLayerOptions& options = TLayerOptions()
+    ) {
+        Allocate(size, dim, options);
+        ForEachRow([this, &layerCreator](size_t i, T* row) {
+            std::fill(row + Dimension, row + RowStride, static_cast<T>(0));
+            layerCreator(i, row, Dimension);
+        }, options.InitThreadCount);
+    }
+
+    TLayer(const TLayer& another) {
+        TLayerOptions options;
+        options.Lockable = static_cast<bool>(another.Mutexes);
+        options.HugePages = another.HugePages;
+        Allocate(another.Rows, another.Dimension, options);
+        std::copy(another.Weights.get(), another.Weights.get() + BufferSize(), Weights.get());
+    }
+
+    TLayer(TLayer&& another) = default;
+
+    TLayer& operator=(const TLayer& another) {
+        if (this != &another)
+            *this = TLayer(another);
+        return *this;
+    }
+
+    TLayer& operator=(TLayer&& another) = default;
 
     unsigned int Size() const {
-        return weights.size();
+        return Rows;
+    }
+
+    unsigned int Dim() const {
+        return Dimension;
     }
 
-    TLayerVector<T>& operator[](unsigned int i) {
-        if (i >= weights.size())
+    size_t Stride() const {
+        return RowStride;
+    }
+
+    T* Row(size_t i) {
+        return Weights.get() + i * RowStride;
+    }
+
+    const T* Row(size_t i) const {
+        return Weights.get() + i * RowStride;
+    }
+
+    TLayerVector<T> operator[](unsigned int i) {
+        if (i >= Rows)
             throw std::runtime_error("Layer operator[] - out of range");
-        return weights[i];
+        return TLayerVector<T>(Row(i), Dimension, Mutexes ? &Mutexes[i] : nullptr);
     }
 
-    const TLayerVector<T>& operator[](unsigned int i) const {
-        if (i >= weights.size())
+    const TLayerVector<T> operator[](unsigned int i) const {
+        if (i >= Rows)
             throw std::runtime_error("Layer operator[] - out of range");
-        return weights[i];
+        return TLayerVector<T>(const_cast<T*>(Row(i)), Dimension, Mutexes ? &Mutexes[i] : nullptr);
+    }
+
+    bool IsMapped() const {
+        return !Weights.get_deleter().Owned;
+    }
+
+    // Calls rowFunc(rowIndex, row) for every row, rows are split into contiguous parts between threads
+    template <class RowFunc>
+    void ForEachRow(RowFunc rowFunc, unsigned int threadCount) {
+        threadCount = std::max(1u, std::min(threadCount, Rows));
+        size_t rowsInPart = Rows / threadCount + 1;
+        std::vector<std::thread> threads;
+        for (unsigned int t = 0; t < threadCount; ++t) {
+            threads.emplace_back([this, t, rowsInPart, &rowFunc]() {
+                size_t rowEnd = std::min(static_cast<size_t>(Rows), (t + 1) * rowsInPart);
+                for (size_t i = t * rowsInPart; i < rowEnd; ++i)
+                    rowFunc(i, Row(i));
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
     }
 
     void Save(std::ofstream& out) const;
     void Load(std::ifstream& in);
+    // With normalize rows are written divided by their length
+    void SaveBinary(TBinaryModelWriter& writer, EBinarySection section, bool normalize = false) const;
+    // Layer becomes a read-only view of the mapped section, reader should outlive it
+    void Map(const TBinaryModelReader& reader, EBinarySection section);
+private:
+    void Allocate(unsigned int size, unsigned int dim, const TLayerOptions& options);
+
+    size_t BufferSize() const {
+        return static_cast<size_t>(Rows) * RowStride;
+    }
+
 private:
-    std::vector<TLayerVector<T>> weights;
+    unsigned int Rows, Dimension;
+    size_t RowStride;
+    EHugePages HugePages;
+    std::unique_ptr<T, TMemoryDeleter> Weights;
+    std::unique_ptr<std::mutex[]> Mutexes;
     static std::string CLASS_TAG;
 };
 
+// vec and normVec may be the same. Zero vector has no direction and stays zero instead of becoming NaN,
+// so it is never similar to anything.
+template <typename T>
+void NormalizeVector(const T* vec, T* normVec, unsigned int dim, const TVectorKernels<T>& kernels) {
+    T len = sqrt(kernels.Dot(vec, vec, dim));
+    if (!(len > 0)) {
+        std::fill(normVec, normVec + dim, static_cast<T>(0));
+        return;
+    }
+    if (normVec != vec)
+        std::copy(vec, vec + dim, normVec);
+    kernels.Scale(1 / len, normVec, dim);
+}
+
+template <class T>
+class TLayerCreatorNormalized {
+public:
+    TLayerCreatorNormalized(const TLayer<T>& layer)
+        : Layer(layer)
+        , Kernels(GetVectorKernels<T>(layer.Dim()))
+    {}
+
+    void operator()(size_t rowIndex, T* row, unsigned int dim) {
+        NormalizeVector(Layer.Row(rowIndex), row, dim, Kernels);
+    }
+private:
+    const TLayer<T>& Layer;
+    const TVectorKernels<T>& Kernels;
+};
+
+template <typename T>
 class TNeuralNetwork {
 public:
-    TNeuralNetwork() {}
+    TNeuralNetwork()
+        : MiddleDimension(0)
+        , VocabularySize(0)
+        , CorpusSize(0)
+        , NormalizedInPlace(false)
+        , WordsNorm(nullptr)
+        , DocsNorm(nullptr)
+    {}
 
     TNeuralNetwork(
         unsigned int vocabSize
         , unsigned int corpusSize
         , unsigned int dim
+        , const TLayerOptions& options = TLayerOptions()
     )
         : MiddleDimension(dim)
         , VocabularySize(vocabSize)
         , CorpusSize(corpusSize)
-        , Syn0(VocabularySize, MiddleDimension, TLayerCreatorUniformRandom<double>())
-        , DSyn0(CorpusSize, MiddleDimension, TLayerCreatorUniformRandom<double>())
-        , Syn0Norm(VocabularySize, MiddleDimension)
-        , DSyn0Norm(CorpusSize, MiddleDimension)
-        , Syn1(VocabularySize, MiddleDimension)
-        , Syn1Neg(VocabularySize, MiddleDimension)
+        , NormalizedInPlace(false)
+        , Syn0(VocabularySize, MiddleDimension, TLayerCreatorUniformRandom<T>(), options)
+        , DSyn0(CorpusSize, MiddleDimension, TLayerCreatorUniformRandom<T>(), options)
+        , Syn1(VocabularySize, MiddleDimension, TLayerCreatorZeroPad<T>(), options)
+        , Syn1Neg(VocabularySize, MiddleDimension, TLayerCreatorZeroPad<T>(), options)
+        , WordsNorm(nullptr)
+        , DocsNorm(nullptr)
     {}
 
-    void Normalize() {
-        NormalizeLayer(Syn0, Syn0Norm);
-        NormalizeLayer(DSyn0, DSyn0Norm);
-    }
-
-    TLayerVector<double>& GetDocumentVector(unsigned int docIndex) {
+    TLayerVector<T> GetDocumentVector(unsigned int docIndex) {
         if (docIndex >= DSyn0.Size())
             throw std::runtime_error("GetDocumentVector: out of range");
         return DSyn0[docIndex];
     }
 
-    TLayerVector<double>& GetWordVector(unsigned int wordIndex) {
+    TLayerVector<T> GetWordVector(unsigned int wordIndex) {
         if (wordIndex >= Syn0.Size())
             throw std::runtime_error("GetWordVector: out of range");
         return Syn0[wordIndex];
     }
 
-    TLayerVector<double>& GetNegativeSampleVector(unsigned int index) {
+    TLayerVector<T> GetNegativeSampleVector(unsigned int index) {
         if (index >= Syn1Neg.Size())
             throw std::runtime_error("GetNegativeSampleVector: out of range");
         return Syn1Neg[index];
     }
 
-    TLayerVector<double>& GetHierarchicalSoftmaxVector(unsigned int index) {
+    TLayerVector<T> GetHierarchicalSoftmaxVector(unsigned int index) {
         if (index >= Syn1.Size())
             throw std::runtime_error("GetHierarchicalSoftmaxVector: out of range");
         return Syn1[index];
     }
 
-    TLayerVector<double>& GetDocumentNormVector(unsigned int docIndex) {
-        if (docIndex >= DSyn0Norm.Size())
+    const TLayerVector<T> GetDocumentNormVector(unsigned int docIndex) const {
+        const auto& layer = GetDocsNormLayer();
+        if (docIndex >= layer.Size())
             throw std::runtime_error("GetDocumentNormVector: out of range");
-        return DSyn0Norm[docIndex];
+        return layer[docIndex];
     }
 
-    const TLayerVector<double>& GetDocumentNormVector(unsigned int docIndex) const {
-        if (docIndex >= DSyn0Norm.Size())
-            throw std::runtime_error("GetDocumentNormVector: out of range");
-        return DSyn0Norm[docIndex];
-    }
-
-    TLayerVector<double>& GetWordNormVector(unsigned int wordIndex) {
-        if (wordIndex >= Syn0Norm.Size())
+    const TLayerVector<T> GetWordNormVector(unsigned int wordIndex) const {
+        const auto& layer = GetWordsNormLayer();
+        if (wordIndex >= layer.Size())
             throw std::runtime_error("GetWordNormVector: out of range");
-        return Syn0Norm[wordIndex];
+        return layer[wordIndex];
     }
 
-    const TLayerVector<double>& GetWordNormVector(unsigned int wordIndex) const {
-        if (wordIndex >= Syn0Norm.Size())
-            throw std::runtime_error("GetWordNormVector: out of range");
-        return Syn0Norm[wordIndex];
+    // Normalized layers are built as copies on first use and only for the layer which is asked for,
+    // raw vectors are never changed by queries
+    const TLayer<T>& GetWordsNormLayer() const {
+        return GetNormLayer(Syn0, Syn0Norm, WordsNorm);
     }
 
-    const TLayer<double>& GetWordsNormLayer() const {
-        return Syn0Norm;
+    const TLayer<T>& GetDocsNormLayer() const {
+        return GetNormLayer(DSyn0, DSyn0Norm, DocsNorm);
     }
 
-    const TLayer<double>& GetDocsNormLayer() const {
-        return DSyn0Norm;
+    // Raw word and document vectors aren't needed anymore: they are normalized in place instead of keeping
+    // normalized copies. Network can't be trained or saved as text after it.
+    void FinishTraining() {
+        std::lock_guard<std::mutex> lock(NormMutex);
+        NormalizeInPlace(Syn0, Syn0Norm, WordsNorm);
+        NormalizeInPlace(DSyn0, DSyn0Norm, DocsNorm);
+        NormalizedInPlace = true;
     }
 
+    // Normalized layers are not serialized, binary model keeps only normalized word and document layers
     void Save(std::ofstream& out) const;
-    void Load(std::ifstream& in);
+    // version is the text model format version, see TEXT_MODEL_VERSION
+    void Load(std::ifstream& in, unsigned int version = TEXT_MODEL_VERSION);
+    void SaveBinary(TBinaryModelWriter& writer) const;
+    void Map(const TBinaryModelReader& reader);
 
 private:
-    void NormalizeLayer(const TLayer<double>& layer, TLayer<double>& normLayer) {
-        assert(layer.Size() == normLayer.Size());
-        for (size_t i = 0; i < layer.Size(); ++i) {
-            double len = 0;
-            for (size_t j = 0; j < MiddleDimension; ++j)
-                len += layer[i][j] * layer[i][j];
-            len = sqrt(len);
-            for (size_t j = 0; j < MiddleDimension; ++j)
-                normLayer[i][j] = layer[i][j] / len;
+    const TLayer<T>& GetNormLayer(const TLayer<T>& layer, TLayer<T>& normLayer, const TLayer<T>*& normPtr) const {
+        std::lock_guard<std::mutex> lock(NormMutex);
+        if (normPtr)
+            return *normPtr;
+        TLayerOptions options;
+        options.InitThreadCount = std::max(1u, std::thread::hardware_concurrency());
+        normLayer = TLayer<T>(layer.Size(), layer.Dim(), TLayerCreatorNormalized<T>(layer), options);
+        normPtr = &normLayer;
+        return *normPtr;
+    }
+
+    // Normalized copy built before is moved in place of raw layer, mapped layers are left as they are.
+    // Caller holds NormMutex.
+    void NormalizeInPlace(TLayer<T>& layer, TLayer<T>& normLayer, const TLayer<T>*& normPtr) {
+        if (normPtr == &normLayer && !normLayer.IsMapped()) {
+            layer = std::move(normLayer);
+            normLayer = TLayer<T>();
+        } else if (!normPtr && !layer.IsMapped()) {
+            const TVectorKernels<T>& kernels = GetVectorKernels<T>(layer.Dim());
+            unsigned int dim = layer.Dim();
+            layer.ForEachRow([dim, &kernels](size_t, T* row) {
+                NormalizeVector(row, row, dim, kernels);
+            }, std::max(1u, std::thread::hardware_concurrency()));
+        } else {
+            return;
         }
+        normPtr = &layer;
     }
 
 private:
     unsigned int MiddleDimension, VocabularySize, CorpusSize;
-    TLayer<double> Syn0, DSyn0;
-    TLayer<double> Syn0Norm, DSyn0Norm;
-    TLayer<double> Syn1, Syn1Neg;
+    // Raw word and document layers hold normalized vectors, see FinishTraining
+    bool NormalizedInPlace;
+    TLayer<T> Syn0, DSyn0;
+    TLayer<T> Syn1, Syn1Neg;
+    mutable TLayer<T> Syn0Norm, DSyn0Norm;
+    mutable const TLayer<T>* WordsNorm;
+    mutable const TLayer<T>* DocsNorm;
+    mutable std::mutex NormMutex;
 
     static std::string CLASS_TAG;
 };
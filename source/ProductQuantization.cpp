@@ -0,0 +1,161 @@
+#include "ProductQuantization.h"
+#include "System.h"
+#include "VectorKernels.h"
+
+#include <vector>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+template <typename T>
+TProductQuantizer::TProductQuantizer(const TLayer<T>& layer, unsigned int subspaceNum, unsigned int iterationNum)
+    : Rows(layer.Size())
+    , Dimension(layer.Dim())
+    , SubspaceNum(subspaceNum)
+    , CentroidNum(0)
+    , Centroids(nullptr)
+    , Codes(nullptr)
+{
+    if (SubspaceNum == 0 || SubspaceNum > Dimension)
+        throw runtime_error("TProductQuantizer - number of subspaces should be in range [1, " + to_string(Dimension) + "].");
+    if (Rows == 0)
+        throw runtime_error("TProductQuantizer - layer is empty.");
+
+    // k-means is trained on a random sample of rows, centroids start from the first sampled rows
+    mt19937 generator(PQ_RANDOM_SEED);
+    vector<size_t> sampleIndexes(Rows);
+    iota(sampleIndexes.begin(), sampleIndexes.end(), 0);
+    shuffle(sampleIndexes.begin(), sampleIndexes.end(), generator);
+    size_t sampleNum = min(static_cast<size_t>(Rows), PQ_MAX_TRAIN_ROWS);
+    vector<float> sample(sampleNum * Dimension);
+    for (size_t i = 0; i < sampleNum; ++i) {
+        const T* row = layer.Row(sampleIndexes[i]);
+        copy(row, row + Dimension, sample.begin() + i * Dimension);
+    }
+
+    CentroidNum = min(static_cast<size_t>(PQ_CENTROID_NUMBER), sampleNum);
+    OwnedCentroids.assign(sample.begin(), sample.begin() + CentroidNum * Dimension);
+    Centroids = OwnedCentroids.data();
+
+    vector<uint8_t> assignment(sampleNum * SubspaceNum);
+    vector<double> sums(CentroidNum * Dimension);
+    vector<unsigned int> counts(CentroidNum * SubspaceNum);
+    uniform_int_distribution<size_t> sampleDistribution(0, sampleNum - 1);
+    for (unsigned int iteration = 0; iteration < iterationNum; ++iteration) {
+        ParallelFor(sampleNum, [this, &sample, &assignment](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                for (unsigned int m = 0; m < SubspaceNum; ++m)
+                    assignment[i * SubspaceNum + m] = FindNearestCentroid(&sample[i * Dimension], m);
+            }
+        });
+
+        fill(sums.begin(), sums.end(), 0);
+        fill(counts.begin(), counts.end(), 0);
+        for (size_t i = 0; i < sampleNum; ++i) {
+            for (unsigned int m = 0; m < SubspaceNum; ++m) {
+                unsigned int centroid = assignment[i * SubspaceNum + m];
+                ++counts[centroid * SubspaceNum + m];
+                for (size_t j = SubspaceBegin(m); j < SubspaceBegin(m + 1); ++j)
+                    sums[centroid * Dimension + j] += sample[i * Dimension + j];
+            }
+        }
+        for (unsigned int k = 0; k < CentroidNum; ++k) {
+            for (unsigned int m = 0; m < SubspaceNum; ++m) {
+                unsigned int count = counts[k * SubspaceNum + m];
+                // Empty cluster is moved to a random sample point
+                size_t randomRow = sampleDistribution(generator);
+                for (size_t j = SubspaceBegin(m); j < SubspaceBegin(m + 1); ++j) {
+                    OwnedCentroids[k * Dimension + j] = count > 0
+                        ? static_cast<float>(sums[k * Dimension + j] / count)
+                        : sample[randomRow * Dimension + j];
+                }
+            }
+        }
+    }
+
+    OwnedCodes.resize(static_cast<size_t>(Rows) * SubspaceNum);
+    ParallelFor(Rows, [this, &layer](size_t begin, size_t end) {
+        vector<float> vec(Dimension);
+        for (size_t i = begin; i < end; ++i) {
+            const T* row = layer.Row(i);
+            copy(row, row + Dimension, vec.begin());
+            for (unsigned int m = 0; m < SubspaceNum; ++m)
+                OwnedCodes[i * SubspaceNum + m] = FindNearestCentroid(vec.data(), m);
+        }
+    });
+    Codes = OwnedCodes.data();
+}
+
+unsigned int TProductQuantizer::FindNearestCentroid(const float* vec, unsigned int subspace) const {
+    size_t begin = SubspaceBegin(subspace), end = SubspaceBegin(subspace + 1);
+    unsigned int nearest = 0;
+    float nearestDistance = numeric_limits<float>::max();
+    for (unsigned int k = 0; k < CentroidNum; ++k) {
+        const float* centroid = Centroids + static_cast<size_t>(k) * Dimension;
+        float distance = 0;
+        for (size_t j = begin; j < end; ++j)
+            distance += (vec[j] - centroid[j]) * (vec[j] - centroid[j]);
+        if (distance < nearestDistance) {
+            nearestDistance = distance;
+            nearest = k;
+        }
+    }
+    return nearest;
+}
+
+void TProductQuantizer::Score(const float* query, vector<float>& scores) const {
+    const TVectorKernels<float>& kernels = GetVectorKernels<float>();
+    vector<float> table(static_cast<size_t>(SubspaceNum) * CentroidNum);
+    for (unsigned int m = 0; m < SubspaceNum; ++m) {
+        size_t begin = SubspaceBegin(m), length = SubspaceBegin(m + 1) - begin;
+        for (unsigned int k = 0; k < CentroidNum; ++k)
+            table[m * CentroidNum + k] = kernels.Dot(query + begin, Centroids + static_cast<size_t>(k) * Dimension + begin, length);
+    }
+
+    scores.resize(Rows);
+    ParallelFor(Rows, [this, &table, &scores](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const uint8_t* codes = Codes + i * SubspaceNum;
+            const float* subspaceTable = table.data();
+            float res = 0;
+            for (unsigned int m = 0; m < SubspaceNum; ++m, subspaceTable += CentroidNum)
+                res += subspaceTable[codes[m]];
+            scores[i] = res;
+        }
+    });
+}
+
+void TProductQuantizer::SaveBinary(TBinaryModelWriter& writer, EBinarySection centroidsSection, EBinarySection codesSection) const {
+    writer.BeginSection(centroidsSection, sizeof(float), CentroidNum, Dimension, Dimension);
+    writer.Write(Centroids, static_cast<size_t>(CentroidNum) * Dimension * sizeof(float));
+    writer.EndSection();
+    writer.BeginSection(codesSection, sizeof(uint8_t), Rows, SubspaceNum, SubspaceNum);
+    writer.Write(Codes, static_cast<size_t>(Rows) * SubspaceNum);
+    writer.EndSection();
+}
+
+void TProductQuantizer::Map(const TBinaryModelReader& reader, EBinarySection centroidsSection, EBinarySection codesSection) {
+    const auto& centroids = reader.GetSection(centroidsSection);
+    const auto& codes = reader.GetSection(codesSection);
+    if (centroids.ElementSize != sizeof(float) || centroids.Rows == 0 || centroids.Rows > PQ_CENTROID_NUMBER
+        || centroids.Size != centroids.Rows * centroids.Dim * sizeof(float)
+        || codes.ElementSize != sizeof(uint8_t) || codes.Dim == 0 || codes.Dim > centroids.Dim
+        || codes.Size != codes.Rows * codes.Dim
+    )
+        throw runtime_error("TProductQuantizer::Map - wrong index sections.");
+    Rows = codes.Rows;
+    Dimension = centroids.Dim;
+    SubspaceNum = codes.Dim;
+    CentroidNum = centroids.Rows;
+    OwnedCentroids.clear();
+    OwnedCodes.clear();
+    Centroids = reader.GetSectionData<float>(centroidsSection);
+    Codes = reader.GetSectionData<uint8_t>(codesSection);
+}
+
+template TProductQuantizer::TProductQuantizer(const TLayer<float>&, unsigned int, unsigned int);
+template TProductQuantizer::TProductQuantizer(const TLayer<double>&, unsigned int, unsigned int);
@@ -0,0 +1,58 @@
+#pragma once
+#include "Common.h"
+#include "NeuralNetwork.h"
+#include "BinaryModel.h"
+
+#include <vector>
+#include <cstdint>
+
+/*
+ * Product quantization index of a normalized layer.
+ * Dimension is split into SubspaceNum contiguous subspaces, each subspace has its own codebook of up to
+ * PQ_CENTROID_NUMBER centroids trained with k-means, so a row is stored as SubspaceNum one byte codes.
+ * Codebooks are kept as CentroidNum full-dimension rows: centroid k of subspace m is in columns of subspace m of row k.
+ */
+class TProductQuantizer {
+public:
+    TProductQuantizer()
+        : Rows(0)
+        , Dimension(0)
+        , SubspaceNum(0)
+        , CentroidNum(0)
+        , Centroids(nullptr)
+        , Codes(nullptr)
+    {}
+
+    template <typename T>
+    TProductQuantizer(const TLayer<T>& layer, unsigned int subspaceNum, unsigned int iterationNum = DEFAULT_PQ_ITERATION_NUMBER);
+
+    unsigned int Size() const {
+        return Rows;
+    }
+
+    unsigned int GetSubspaceNum() const {
+        return SubspaceNum;
+    }
+
+    // Asymmetric distance computation: query is exact, scores[i] is dot product of query and decoded row i
+    void Score(const float* query, std::vector<float>& scores) const;
+
+    void SaveBinary(TBinaryModelWriter& writer, EBinarySection centroidsSection, EBinarySection codesSection) const;
+    // Index stays in the mapped file, reader should outlive it
+    void Map(const TBinaryModelReader& reader, EBinarySection centroidsSection, EBinarySection codesSection);
+
+private:
+    size_t SubspaceBegin(unsigned int subspace) const {
+        return static_cast<size_t>(subspace) * Dimension / SubspaceNum;
+    }
+
+    // Index of the nearest centroid of subspace for vec
+    unsigned int FindNearestCentroid(const float* vec, unsigned int subspace) const;
+
+private:
+    unsigned int Rows, Dimension, SubspaceNum, CentroidNum;
+    std::vector<float> OwnedCentroids;
+    std::vector<uint8_t> OwnedCodes;
+    const float* Centroids;
+    const uint8_t* Codes;
+};
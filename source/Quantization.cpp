@@ -0,0 +1,214 @@
+#include "Quantization.h"
+#include "System.h"
+#include "VectorKernels.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+string QuantizationToString(EQuantization quantization) {
+    switch (quantization) {
+        case EQuantization::Int8:
+            return "int8";
+        case EQuantization::Fp16:
+            return "fp16";
+        default:
+            return "none";
+    }
+}
+
+bool ParseQuantization(const string& str, EQuantization& quantization) {
+    if (str == "none") {
+        quantization = EQuantization::None;
+    } else if (str == "int8") {
+        quantization = EQuantization::Int8;
+    } else if (str == "fp16") {
+        quantization = EQuantization::Fp16;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+uint16_t FloatToHalf(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint16_t sign = (bits >> 16) & 0x8000;
+    int exponent = static_cast<int>((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent >= 31) // overflow, inf and nan are not expected in normalized vectors
+        return sign | 0x7c00;
+    if (exponent <= 0) {
+        if (exponent < -10)
+            return sign;
+        // subnormal half, round to nearest
+        mantissa |= 0x800000;
+        uint32_t shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        if ((mantissa >> (shift - 1)) & 1)
+            half += 1;
+        return sign | half;
+    }
+    uint16_t half = sign | (exponent << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000) // round to nearest, carry into exponent is correct
+        half += 1;
+    return half;
+}
+
+float HalfToFloat(uint16_t value) {
+    uint32_t sign = static_cast<uint32_t>(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+    uint32_t bits;
+    if (exponent == 0) {
+        // zero or subnormal: mantissa * 2^-24
+        float res = static_cast<float>(mantissa) * 5.9604645e-8f;
+        return sign ? -res : res;
+    } else if (exponent == 31) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+    float res;
+    memcpy(&res, &bits, sizeof(res));
+    return res;
+}
+
+template <typename T>
+TQuantizedLayer::TQuantizedLayer(const TLayer<T>& layer, EQuantization quantization) {
+    if (quantization == EQuantization::None)
+        throw runtime_error("TQuantizedLayer - quantization isn't set.");
+    Allocate(layer.Size(), layer.Dim(), quantization);
+
+    ParallelFor(Rows, [this, &layer](size_t rowBegin, size_t rowEnd) {
+        for (size_t i = rowBegin; i < rowEnd; ++i) {
+            const T* row = layer.Row(i);
+            char* codes = &OwnedCodes[i * RowBytes];
+            if (Quantization == EQuantization::Int8) {
+                T maxAbs = 0;
+                for (size_t j = 0; j < Dimension; ++j)
+                    maxAbs = max(maxAbs, static_cast<T>(fabs(row[j])));
+                float scale = maxAbs > 0 ? static_cast<float>(maxAbs) / 127 : 0;
+                int8_t* rowCodes = reinterpret_cast<int8_t*>(codes);
+                for (size_t j = 0; j < Dimension; ++j)
+                    rowCodes[j] = scale > 0 ? static_cast<int8_t>(lrint(row[j] / scale)) : 0;
+                OwnedScales[i] = scale;
+            } else {
+                uint16_t* rowCodes = reinterpret_cast<uint16_t*>(codes);
+                for (size_t j = 0; j < Dimension; ++j)
+                    rowCodes[j] = FloatToHalf(static_cast<float>(row[j]));
+            }
+        }
+    });
+}
+
+void TQuantizedLayer::Allocate(unsigned int rows, unsigned int dim, EQuantization quantization) {
+    Quantization = quantization;
+    Rows = rows;
+    Dimension = dim;
+    size_t elementSize = quantization == EQuantization::Int8 ? sizeof(int8_t) : sizeof(uint16_t);
+    RowBytes = (dim * elementSize + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    OwnedCodes.assign(static_cast<size_t>(Rows) * RowBytes, 0);
+    Codes = OwnedCodes.data();
+    if (quantization == EQuantization::Int8) {
+        OwnedScales.assign(Rows, 0);
+        Scales = OwnedScales.data();
+    } else {
+        OwnedScales.clear();
+        Scales = nullptr;
+    }
+}
+
+namespace {
+    // Same as HalfToFloat for finite halves, but branch-free so that loops over rows are vectorized:
+    // exponent and mantissa are moved to float positions and exponent bias is fixed by multiplication,
+    // which also turns subnormal halves into normal floats
+    inline float DequantizeHalf(uint16_t value) {
+        uint32_t bits = static_cast<uint32_t>(value & 0x7fff) << 13;
+        float res;
+        memcpy(&res, &bits, sizeof(res));
+        res *= 5.192296858534828e+33f; // 2^(127 - 15)
+        uint32_t resBits;
+        memcpy(&resBits, &res, sizeof(resBits));
+        resBits |= static_cast<uint32_t>(value & 0x8000) << 16;
+        memcpy(&res, &resBits, sizeof(res));
+        return res;
+    }
+}
+
+void TQuantizedLayer::ScoreRows(const float* query, float* scores, size_t rowBegin, size_t rowEnd) const {
+    const TVectorKernels<float>& kernels = GetVectorKernels<float>(Dimension);
+    vector<float> block(QUANTIZED_SCORE_BLOCK_ROWS * Dimension);
+    for (size_t blockBegin = rowBegin; blockBegin < rowEnd; blockBegin += QUANTIZED_SCORE_BLOCK_ROWS) {
+        size_t blockEnd = min(rowEnd, blockBegin + QUANTIZED_SCORE_BLOCK_ROWS);
+        for (size_t i = blockBegin; i < blockEnd; ++i) {
+            float* row = &block[(i - blockBegin) * Dimension];
+            if (Quantization == EQuantization::Int8) {
+                const int8_t* codes = reinterpret_cast<const int8_t*>(Codes + i * RowBytes);
+                for (size_t j = 0; j < Dimension; ++j)
+                    row[j] = codes[j];
+            } else {
+                const uint16_t* codes = reinterpret_cast<const uint16_t*>(Codes + i * RowBytes);
+                for (size_t j = 0; j < Dimension; ++j)
+                    row[j] = DequantizeHalf(codes[j]);
+            }
+        }
+        for (size_t i = blockBegin; i < blockEnd; ++i) {
+            float res = kernels.Dot(query, &block[(i - blockBegin) * Dimension], Dimension);
+            scores[i] = Quantization == EQuantization::Int8 ? res * Scales[i] : res;
+        }
+    }
+}
+
+void TQuantizedLayer::Score(const float* query, vector<float>& scores) const {
+    scores.resize(Rows);
+    ParallelFor(Rows, [this, query, &scores](size_t rowBegin, size_t rowEnd) {
+        ScoreRows(query, scores.data(), rowBegin, rowEnd);
+    });
+}
+
+void TQuantizedLayer::SaveBinary(TBinaryModelWriter& writer, EBinarySection codesSection, EBinarySection scalesSection) const {
+    size_t elementSize = Quantization == EQuantization::Int8 ? sizeof(int8_t) : sizeof(uint16_t);
+    writer.BeginSection(codesSection, elementSize, Rows, Dimension, RowBytes / elementSize);
+    writer.Write(Codes, static_cast<size_t>(Rows) * RowBytes);
+    writer.EndSection();
+    if (Quantization == EQuantization::Int8) {
+        writer.BeginSection(scalesSection, sizeof(float), Rows);
+        writer.Write(Scales, Rows * sizeof(float));
+        writer.EndSection();
+    }
+}
+
+void TQuantizedLayer::Map(const TBinaryModelReader& reader, EBinarySection codesSection, EBinarySection scalesSection) {
+    const auto& section = reader.GetSection(codesSection);
+    if (section.ElementSize == sizeof(int8_t)) {
+        Quantization = EQuantization::Int8;
+    } else if (section.ElementSize == sizeof(uint16_t)) {
+        Quantization = EQuantization::Fp16;
+    } else {
+        throw runtime_error("TQuantizedLayer::Map - wrong quantized section.");
+    }
+    Rows = section.Rows;
+    Dimension = section.Dim;
+    RowBytes = section.Stride * section.ElementSize;
+    if (static_cast<size_t>(Rows) * RowBytes != section.Size)
+        throw runtime_error("TQuantizedLayer::Map - wrong quantized section.");
+    OwnedCodes.clear();
+    OwnedScales.clear();
+    Codes = reader.GetSectionData<char>(codesSection);
+    Scales = nullptr;
+    if (Quantization == EQuantization::Int8) {
+        if (reader.GetSectionLength<float>(scalesSection) != Rows)
+            throw runtime_error("TQuantizedLayer::Map - wrong scales section.");
+        Scales = reader.GetSectionData<float>(scalesSection);
+    }
+}
+
+template TQuantizedLayer::TQuantizedLayer(const TLayer<float>&, EQuantization);
+template TQuantizedLayer::TQuantizedLayer(const TLayer<double>&, EQuantization);
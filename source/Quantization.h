@@ -0,0 +1,60 @@
+#pragma once
+#include "Common.h"
+#include "NeuralNetwork.h"
+#include "BinaryModel.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+std::string QuantizationToString(EQuantization quantization);
+bool ParseQuantization(const std::string& str, EQuantization& quantization);
+
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t value);
+
+// Scalar quantized copy of a normalized layer: int8 codes with per-row scale or fp16 values.
+// Rows are padded to a cache line, like in TLayer.
+class TQuantizedLayer {
+public:
+    TQuantizedLayer()
+        : Quantization(EQuantization::None)
+        , Rows(0)
+        , Dimension(0)
+        , RowBytes(0)
+        , Codes(nullptr)
+        , Scales(nullptr)
+    {}
+
+    template <typename T>
+    TQuantizedLayer(const TLayer<T>& layer, EQuantization quantization);
+
+    EQuantization GetQuantization() const {
+        return Quantization;
+    }
+
+    unsigned int Size() const {
+        return Rows;
+    }
+
+    // scores[i] is approximate dot product of query and row i
+    void Score(const float* query, std::vector<float>& scores) const;
+
+    void SaveBinary(TBinaryModelWriter& writer, EBinarySection codesSection, EBinarySection scalesSection) const;
+    // Codes stay in the mapped file, reader should outlive the layer
+    void Map(const TBinaryModelReader& reader, EBinarySection codesSection, EBinarySection scalesSection);
+
+private:
+    void Allocate(unsigned int rows, unsigned int dim, EQuantization quantization);
+
+    void ScoreRows(const float* query, float* scores, size_t rowBegin, size_t rowEnd) const;
+
+private:
+    EQuantization Quantization;
+    unsigned int Rows, Dimension;
+    size_t RowBytes;
+    std::vector<char> OwnedCodes;
+    std::vector<float> OwnedScales;
+    const char* Codes;
+    const float* Scales;
+};
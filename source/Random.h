@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * PCG32 generator (O'Neill, pcg-random.org): 64 bit LCG state, 32 bit permuted output.
+ * Each train thread owns one, so unlike rand() there is no shared state and no lock.
+ */
+class TFastRandom {
+public:
+    explicit TFastRandom(uint64_t seed, uint64_t stream = 0)
+        : State(0)
+        , Increment((stream << 1) | 1)
+    {
+        Next();
+        State += seed;
+        Next();
+    }
+
+    uint32_t Next() {
+        uint64_t oldState = State;
+        State = oldState * 6364136223846793005ULL + Increment;
+        uint32_t xorShifted = static_cast<uint32_t>(((oldState >> 18) ^ oldState) >> 27);
+        uint32_t rot = static_cast<uint32_t>(oldState >> 59);
+        return (xorShifted >> rot) | (xorShifted << ((32 - rot) & 31));
+    }
+
+    // Uniform in [0, bound), bound > 0. Lemire's multiply-shift: no division except in the rare rejection path,
+    // values of the biased low part are rejected, so there is no modulo bias
+    uint32_t NextIndex(uint32_t bound) {
+        uint64_t product = static_cast<uint64_t>(Next()) * bound;
+        uint32_t low = static_cast<uint32_t>(product);
+        if (low < bound) {
+            uint32_t threshold = (0u - bound) % bound;
+            while (low < threshold) {
+                product = static_cast<uint64_t>(Next()) * bound;
+                low = static_cast<uint32_t>(product);
+            }
+        }
+        return static_cast<uint32_t>(product >> 32);
+    }
+
+    // Uniform in [0, 1) with 24 bits of precision
+    float NextFloat() {
+        return static_cast<float>(Next() >> 8) * (1.0f / 16777216.0f);
+    }
+
+private:
+    uint64_t State;
+    uint64_t Increment;
+};
@@ -0,0 +1,95 @@
+#include "Sigmoid.h"
+#include "VectorKernels.h"
+
+#include <string>
+#include <vector>
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+using namespace std;
+
+string SigmoidToString(ESigmoid sigmoid) {
+    return sigmoid == ESigmoid::Table ? "table" : "rational";
+}
+
+bool ParseSigmoid(const string& str, ESigmoid& sigmoid) {
+    if (str == "table") {
+        sigmoid = ESigmoid::Table;
+    } else if (str == "rational") {
+        sigmoid = ESigmoid::Rational;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+TSigmoid::TSigmoid(ESigmoid mode)
+    : Mode(mode)
+{
+    for (size_t i = 0; i <= SIGMOID_TABLE_SIZE; ++i) {
+        double x = (static_cast<double>(i) / SIGMOID_TABLE_SIZE * 2 - 1) * MAX_EXP;
+        Table[i] = static_cast<float>(1 / (1 + exp(-x)));
+    }
+    Table[SIGMOID_TABLE_SIZE + 1] = Table[SIGMOID_TABLE_SIZE];
+}
+
+namespace {
+    const size_t REPORT_VALUE_NUMBER = 1 << 20;
+    const unsigned int REPORT_REPEAT_NUMBER = 20;
+
+    template <typename Func>
+    double MeasureNanosecondsPerValue(Func func) {
+        using namespace chrono;
+        high_resolution_clock::time_point t1 = high_resolution_clock::now();
+        for (unsigned int i = 0; i < REPORT_REPEAT_NUMBER; ++i)
+            func();
+        duration<double> timeSpan = duration_cast<duration<double>>(high_resolution_clock::now() - t1);
+        return timeSpan.count() * 1e9 / REPORT_REPEAT_NUMBER / REPORT_VALUE_NUMBER;
+    }
+
+    double MaxAbsError(const vector<float>& xs, const vector<float>& ys, float bound) {
+        double res = 0;
+        for (size_t i = 0; i < xs.size(); ++i) {
+            if (fabs(xs[i]) < bound)
+                res = max(res, fabs(ys[i] - 1 / (1 + exp(-static_cast<double>(xs[i])))));
+        }
+        return res;
+    }
+}
+
+void PrintSigmoidReport() {
+    // Dot products of output layer are mostly inside of [-MAX_EXP, MAX_EXP], values outside it are covered too
+    vector<float> xs(REPORT_VALUE_NUMBER), ys(REPORT_VALUE_NUMBER);
+    for (size_t i = 0; i < xs.size(); ++i)
+        xs[i] = (static_cast<float>(i) / xs.size() * 2 - 1) * 2 * MAX_EXP;
+    const TVectorKernels<float>& kernels = GetVectorKernels<float>();
+
+    const string insideColumn = "error in [" + to_string(-MAX_EXP) + ", " + to_string(MAX_EXP) + "]";
+    const string allColumn = "error in [" + to_string(-2 * MAX_EXP) + ", " + to_string(2 * MAX_EXP) + "]";
+    cout << "Sigmoid of " << REPORT_VALUE_NUMBER << " floats, max abs error and time per value" << endl
+        << setw(18) << "mode" << setw(20) << insideColumn << setw(20) << allColumn << setw(12) << "ns/value" << endl;
+    auto printRow = [&](const string& mode, double time) {
+        cout << setw(18) << mode << setw(20) << MaxAbsError(xs, ys, MAX_EXP) << setw(20) << MaxAbsError(xs, ys, 2 * MAX_EXP)
+            << setw(12) << time << endl;
+    };
+
+    printRow("exact", MeasureNanosecondsPerValue([&xs, &ys]() {
+        for (size_t i = 0; i < xs.size(); ++i)
+            ys[i] = 1 / (1 + exp(-xs[i]));
+    }));
+    for (ESigmoid mode : {ESigmoid::Table, ESigmoid::Rational}) {
+        TSigmoid sigmoid(mode);
+        printRow(SigmoidToString(mode), MeasureNanosecondsPerValue([&xs, &ys, &sigmoid]() {
+            for (size_t i = 0; i < xs.size(); ++i)
+                ys[i] = sigmoid(xs[i]);
+        }));
+    }
+    // Copy is included, kernel works in place
+    printRow(SigmoidToString(ESigmoid::Rational) + " " + SimdToString(GetSelectedSimd()), MeasureNanosecondsPerValue([&xs, &ys, &kernels]() {
+        copy(xs.begin(), xs.end(), ys.begin());
+        kernels.Sigmoid(ys.data(), ys.size());
+    }));
+}
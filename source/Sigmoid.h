@@ -0,0 +1,75 @@
+#pragma once
+#include "Common.h"
+
+#include <string>
+#include <cstddef>
+
+std::string SigmoidToString(ESigmoid sigmoid);
+bool ParseSigmoid(const std::string& str, ESigmoid& sigmoid);
+
+// tanh(x) ~ x * P(x^2) / Q(x^2) on [-SIGMOID_RATIONAL_CLAMP, SIGMOID_RATIONAL_CLAMP], tanh is +-1 in float beyond it.
+// Coefficients of the [13/6] minimax approximation used by Eigen for float tanh, error is about 1e-7.
+const float SIGMOID_RATIONAL_CLAMP = 7.90531110763549805f;
+const float SIGMOID_RATIONAL_P[] = {
+    4.89352455891786e-03f, 6.37261928875436e-04f, 1.48572235717979e-05f, 5.12229709037114e-08f,
+    -8.60467152213735e-11f, 2.00018790482477e-13f, -2.76076847742355e-16f
+};
+const float SIGMOID_RATIONAL_Q[] = {
+    4.89352518554385e-03f, 2.26843463243900e-03f, 1.18534705686654e-04f, 1.19825839466702e-06f
+};
+
+// Branch-free logistic function: 1 / (1 + exp(-x)) = 0.5 + 0.5 * tanh(x / 2).
+// Vector kernels evaluate the same formula on SIMD lanes, see Sigmoid in VectorKernelsImpl.h.
+template <typename T>
+inline T RationalSigmoid(T x) {
+    T t = x * T(0.5);
+    t = t < -SIGMOID_RATIONAL_CLAMP ? -SIGMOID_RATIONAL_CLAMP : (t > SIGMOID_RATIONAL_CLAMP ? SIGMOID_RATIONAL_CLAMP : t);
+    T t2 = t * t;
+    T p = SIGMOID_RATIONAL_P[6];
+    for (int i = 5; i >= 0; --i)
+        p = p * t2 + SIGMOID_RATIONAL_P[i];
+    T q = SIGMOID_RATIONAL_Q[3];
+    for (int i = 2; i >= 0; --i)
+        q = q * t2 + SIGMOID_RATIONAL_Q[i];
+    return T(0.5) + T(0.5) * t * p / q;
+}
+
+/*
+ * Logistic function of output layer dot products.
+ * Table mode interpolates linearly between SIGMOID_TABLE_SIZE + 1 float values over [-MAX_EXP, MAX_EXP]
+ * and is saturated to 0 and 1 outside of it, like word2vec table. Rational mode is RationalSigmoid.
+ */
+class TSigmoid {
+public:
+    explicit TSigmoid(ESigmoid mode = DEFAULT_SIGMOID);
+
+    ESigmoid GetMode() const {
+        return Mode;
+    }
+
+    template <typename T>
+    T operator()(T x) const {
+        return Mode == ESigmoid::Table ? Interpolate(x) : RationalSigmoid(x);
+    }
+
+    // NaN gives 1, as a diverged dot product did with the old exp table
+    template <typename T>
+    T Interpolate(T x) const {
+        if (x <= -MAX_EXP)
+            return 0;
+        if (!(x < MAX_EXP))
+            return 1;
+        T position = (x + MAX_EXP) * (T(SIGMOID_TABLE_SIZE) / (2 * MAX_EXP));
+        size_t index = static_cast<size_t>(position);
+        T fraction = position - index;
+        return Table[index] + fraction * (Table[index + 1] - Table[index]);
+    }
+
+private:
+    ESigmoid Mode;
+    // One more value than intervals, and a copy of the last one for x rounded up to the right end
+    float Table[SIGMOID_TABLE_SIZE + 2];
+};
+
+// Measures error against exact logistic function and time per value of every mode, scalar and with vector kernels
+void PrintSigmoidReport();
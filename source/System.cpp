@@ -0,0 +1,180 @@
+#include "System.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <cstdlib>
+#include <atomic>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+using namespace std;
+
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+string HugePagesToString(EHugePages hugePages) {
+    switch (hugePages) {
+        case EHugePages::Transparent:
+            return "thp";
+        case EHugePages::Explicit:
+            return "explicit";
+        default:
+            return "none";
+    }
+}
+
+bool ParseHugePages(const string& str, EHugePages& hugePages) {
+    if (str == "none") {
+        hugePages = EHugePages::None;
+    } else if (str == "thp") {
+        hugePages = EHugePages::Transparent;
+    } else if (str == "explicit") {
+        hugePages = EHugePages::Explicit;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void TMemoryDeleter::operator()(void* ptr) const {
+    if (!ptr || !Owned)
+        return;
+    if (Mapped) {
+        munmap(ptr, Bytes);
+    } else {
+        free(ptr);
+    }
+}
+
+void* AllocateMemory(size_t bytes, EHugePages hugePages, TMemoryDeleter& deleter) {
+    deleter = TMemoryDeleter();
+    if (bytes == 0)
+        return nullptr;
+
+    if (hugePages == EHugePages::None) {
+        void* ptr = nullptr;
+        if (posix_memalign(&ptr, CACHE_LINE_SIZE, bytes) != 0)
+            throw runtime_error("AllocateMemory - cannot allocate memory.");
+        return ptr;
+    }
+
+    size_t mappedBytes = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    void* ptr = MAP_FAILED;
+    if (hugePages == EHugePages::Explicit) {
+        ptr = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        static bool warned = false;
+        if (ptr == MAP_FAILED && !warned) {
+            cerr << "Cannot allocate explicit huge pages, falling back to transparent huge pages." << endl;
+            warned = true;
+        }
+    }
+    if (ptr == MAP_FAILED) {
+        ptr = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+            throw runtime_error("AllocateMemory - cannot map memory.");
+        madvise(ptr, mappedBytes, MADV_HUGEPAGE);
+    }
+    deleter.Bytes = mappedBytes;
+    deleter.Mapped = true;
+    return ptr;
+}
+
+TMappedFile::TMappedFile(const string& filename)
+    : Data(nullptr)
+    , Size(0)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw runtime_error("Cannot open file <" + filename + ">.");
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw runtime_error("TMappedFile - cannot read size of <" + filename + ">.");
+    }
+    Size = st.st_size;
+    if (Size == 0) {
+        close(fd);
+        return;
+    }
+    void* ptr = mmap(nullptr, Size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED)
+        throw runtime_error("TMappedFile - cannot map file <" + filename + ">.");
+    // Every thread reads its own part of file from begin to end
+    madvise(ptr, Size, MADV_SEQUENTIAL);
+    Data = static_cast<const char*>(ptr);
+}
+
+TMappedFile::~TMappedFile() {
+    if (Data)
+        munmap(const_cast<char*>(Data), Size);
+}
+
+bool PinCurrentThread(unsigned int threadIndex) {
+    unsigned int cpuCount = thread::hardware_concurrency();
+    if (cpuCount == 0)
+        return false;
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(threadIndex % cpuCount, &cpuSet);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet) == 0;
+}
+
+#ifdef COUNT_ALLOCATIONS
+
+static thread_local bool CountAllocations = false;
+static atomic<unsigned long long> CountedAllocations(0);
+
+void* operator new(size_t size) {
+    if (CountAllocations)
+        CountedAllocations.fetch_add(1, memory_order_relaxed);
+    void* ptr = malloc(size > 0 ? size : 1);
+    if (!ptr)
+        throw bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+bool IsAllocationCountingEnabled() {
+    return true;
+}
+
+unsigned long long GetCountedAllocations() {
+    return CountedAllocations.load();
+}
+
+TAllocationCountingGuard::TAllocationCountingGuard() {
+    CountAllocations = true;
+}
+
+TAllocationCountingGuard::~TAllocationCountingGuard() {
+    CountAllocations = false;
+}
+
+#else
+
+bool IsAllocationCountingEnabled() {
+    return false;
+}
+
+unsigned long long GetCountedAllocations() {
+    return 0;
+}
+
+TAllocationCountingGuard::TAllocationCountingGuard() {}
+
+TAllocationCountingGuard::~TAllocationCountingGuard() {}
+
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+#include "Common.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cstddef>
+
+std::string HugePagesToString(EHugePages hugePages);
+bool ParseHugePages(const std::string& str, EHugePages& hugePages);
+
+// Knows how the memory it frees was obtained: posix_memalign, mmap or borrowed from a mapped model file
+struct TMemoryDeleter {
+    TMemoryDeleter()
+        : Bytes(0)
+        , Mapped(false)
+        , Owned(true)
+    {}
+
+    void operator()(void* ptr) const;
+
+    size_t Bytes;
+    bool Mapped;
+    bool Owned;
+};
+
+// Memory is not touched here, pages are allocated when they are written first
+void* AllocateMemory(size_t bytes, EHugePages hugePages, TMemoryDeleter& deleter);
+
+bool PinCurrentThread(unsigned int threadIndex);
+
+// Whole file mapped read-only, pages are read by threads which touch them
+class TMappedFile {
+public:
+    explicit TMappedFile(const std::string& filename);
+    ~TMappedFile();
+
+    TMappedFile(const TMappedFile&) = delete;
+    TMappedFile& operator=(const TMappedFile&) = delete;
+
+    // nullptr for empty file
+    const char* GetData() const {
+        return Data;
+    }
+
+    size_t GetSize() const {
+        return Size;
+    }
+
+private:
+    const char* Data;
+    size_t Size;
+};
+
+// Allocation counting works in benchmark build only ('make bench', COUNT_ALLOCATIONS defined),
+// global operator new counts calls made by threads inside TAllocationCountingGuard
+bool IsAllocationCountingEnabled();
+unsigned long long GetCountedAllocations();
+
+class TAllocationCountingGuard {
+public:
+    TAllocationCountingGuard();
+    ~TAllocationCountingGuard();
+
+    TAllocationCountingGuard(const TAllocationCountingGuard&) = delete;
+    TAllocationCountingGuard& operator=(const TAllocationCountingGuard&) = delete;
+};
+
+// Splits [0, count) into contiguous parts, one per hardware thread, func(begin, end) is called for each part
+template <typename Func>
+void ParallelFor(size_t count, Func func) {
+    size_t threadCount = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), count));
+    size_t partSize = count / threadCount + 1;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; ++t) {
+        size_t begin = std::min(count, t * partSize);
+        size_t end = std::min(count, (t + 1) * partSize);
+        threads.emplace_back([&func, begin, end]() {
+            func(begin, end);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+}
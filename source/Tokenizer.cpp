@@ -0,0 +1,11 @@
+#include "Tokenizer.h"
+
+TCharacterTable::TCharacterTable() {
+    for (int c = 0; c < 256; ++c) {
+        bool isLetter = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        IsWord[c] = isLetter || (c >= '0' && c <= '9') || c == '_';
+        Lower[c] = static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+    }
+}
+
+const TCharacterTable CHARACTER_TABLE;
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// Byte classes of the tokenizer, filled once in Tokenizer.cpp
+struct TCharacterTable {
+    TCharacterTable();
+
+    // Bytes matched by \w in "C" locale: ASCII letters, digits and underscore.
+    // Bytes of UTF-8 multibyte characters aren't word characters, they split words like with std::regex.
+    bool IsWord[256];
+    // ASCII upper case letters are mapped to lower case, like tolower in "C" locale, other bytes are kept
+    char Lower[256];
+};
+
+extern const TCharacterTable CHARACTER_TABLE;
+
+inline bool IsWordCharacter(char c) {
+    return CHARACTER_TABLE.IsWord[static_cast<uint8_t>(c)];
+}
+
+inline char ToLowerCharacter(char c) {
+    return CHARACTER_TABLE.Lower[static_cast<uint8_t>(c)];
+}
+
+// Calls func(wordBegin, wordEnd) for every maximal run of word characters of [begin, end), same tokens as \w+ regex.
+// Words are views into the text, nothing is copied.
+template <typename Func>
+void ForEachWord(const char* begin, const char* end, Func func) {
+    const char* it = begin;
+    while (true) {
+        while (it != end && !IsWordCharacter(*it))
+            ++it;
+        if (it == end)
+            return;
+        const char* wordBegin = it;
+        while (it != end && IsWordCharacter(*it))
+            ++it;
+        func(wordBegin, static_cast<const char*>(it));
+    }
+}
+
+// Writes lower case word to reused buffer, same as NormalizeWord without a new string
+inline void AssignNormalizedWord(const char* begin, const char* end, std::string& word) {
+    word.resize(end - begin);
+    for (size_t i = 0; begin != end; ++begin, ++i)
+        word[i] = ToLowerCharacter(*begin);
+}
@@ -0,0 +1,75 @@
+#include "TrainProgress.h"
+
+#include <new>
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+
+TTrainProgress::TTrainProgress(const shared_ptr<TAlpha>& alpha, unsigned int threadCount, unsigned long long totalTrainWords)
+    : Alpha(alpha)
+    , ThreadCount(threadCount)
+    , TotalTrainWords(totalTrainWords)
+    , StopRequested(false)
+{
+    static_assert(sizeof(TCounter) == CACHE_LINE_SIZE, "Counter should fill a cache line");
+    Counters = static_cast<TCounter*>(AllocateMemory(ThreadCount * sizeof(TCounter), EHugePages::None, CountersDeleter));
+    for (unsigned int i = 0; i < ThreadCount; ++i)
+        new (Counters + i) TCounter();
+    for (unsigned int i = 0; i < ThreadCount; ++i)
+        Counters[i].Words.store(0, memory_order_relaxed);
+}
+
+TTrainProgress::~TTrainProgress() {
+    if (Reporter.joinable())
+        Stop();
+    CountersDeleter(Counters);
+}
+
+void TTrainProgress::Start() {
+    StartTime = chrono::high_resolution_clock::now();
+    Reporter = thread(&TTrainProgress::Run, this);
+}
+
+void TTrainProgress::Stop() {
+    {
+        lock_guard<mutex> lock(Mutex);
+        StopRequested = true;
+    }
+    Stopped.notify_one();
+    Reporter.join();
+    Report(true);
+}
+
+unsigned long long TTrainProgress::GetWordCount() const {
+    unsigned long long res = 0;
+    for (unsigned int i = 0; i < ThreadCount; ++i)
+        res += Counters[i].Words.load(memory_order_relaxed);
+    return res;
+}
+
+void TTrainProgress::Report(bool print) {
+    using namespace chrono;
+    unsigned long long wordCount = GetWordCount();
+    double progress = TotalTrainWords > 0 ? static_cast<double>(wordCount) / TotalTrainWords : 1;
+    Alpha->Update(progress);
+    if (!print)
+        return;
+    duration<double> timeSpan = duration_cast<duration<double>>(high_resolution_clock::now() - StartTime);
+    double wordsBySec = static_cast<double>(wordCount) / timeSpan.count() / 1000;
+    cout << "\r" << "Alpha: " << Alpha->Get() << " Progress: " << progress * 100
+        << "% Words/Sec: " << wordsBySec << "k" << flush;
+}
+
+void TTrainProgress::Run() {
+    using namespace chrono;
+    high_resolution_clock::time_point lastPrint = high_resolution_clock::now();
+    unique_lock<mutex> lock(Mutex);
+    while (!Stopped.wait_for(lock, milliseconds(PROGRESS_UPDATE_INTERVAL_MS), [this]() { return StopRequested; })) {
+        high_resolution_clock::time_point now = high_resolution_clock::now();
+        bool print = now - lastPrint >= milliseconds(PROGRESS_PRINT_INTERVAL_MS);
+        if (print)
+            lastPrint = now;
+        Report(print);
+    }
+}
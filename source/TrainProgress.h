@@ -0,0 +1,86 @@
+#pragma once
+#include "Common.h"
+#include "System.h"
+
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+// Learning rate shared by train threads: they only read it, TTrainProgress publishes new values
+class TAlpha {
+public:
+    TAlpha(double init)
+        : InitialValue(init)
+        , CurrentValue(init)
+    {}
+
+    double Get() const {
+        return CurrentValue.load(std::memory_order_relaxed);
+    }
+
+    // Linear decay by fraction of trained words, down to ALPHA_MAX_REDUCE_COEFFICENT of initial value
+    void Update(double progress) {
+        double updatedAlpha = InitialValue * (1 - progress);
+        if (updatedAlpha < InitialValue * ALPHA_MAX_REDUCE_COEFFICENT)
+            updatedAlpha = InitialValue * ALPHA_MAX_REDUCE_COEFFICENT;
+        CurrentValue.store(updatedAlpha, std::memory_order_relaxed);
+    }
+
+private:
+    const double InitialValue;
+    std::atomic<double> CurrentValue;
+};
+
+/*
+ * Counts words trained by every thread and drives learning rate from a background reporter thread.
+ * Each train thread writes only its own cache line counter, the reporter sums them every
+ * PROGRESS_UPDATE_INTERVAL_MS, publishes alpha and prints progress, so there are no shared writes,
+ * locks, clocks or terminal output in training loops.
+ */
+class TTrainProgress {
+public:
+    TTrainProgress(const std::shared_ptr<TAlpha>& alpha, unsigned int threadCount, unsigned long long totalTrainWords);
+    ~TTrainProgress();
+
+    TTrainProgress(const TTrainProgress&) = delete;
+    TTrainProgress& operator=(const TTrainProgress&) = delete;
+
+    // Called by train thread threadIndex only
+    void Add(unsigned int threadIndex, unsigned long long wordCount) {
+        std::atomic<unsigned long long>& words = Counters[threadIndex].Words;
+        words.store(words.load(std::memory_order_relaxed) + wordCount, std::memory_order_relaxed);
+    }
+
+    void Start();
+    // Stops reporter and prints the final progress line, alpha is updated with the final count
+    void Stop();
+
+    // Sum of words added by all threads
+    unsigned long long GetWordCount() const;
+
+private:
+    struct TCounter {
+        std::atomic<unsigned long long> Words;
+        char Padding[CACHE_LINE_SIZE - sizeof(std::atomic<unsigned long long>)];
+    };
+
+    void Report(bool print);
+    void Run();
+
+private:
+    std::shared_ptr<TAlpha> Alpha;
+    unsigned int ThreadCount;
+    unsigned long long TotalTrainWords;
+    TMemoryDeleter CountersDeleter;
+    // One cache line per train thread
+    TCounter* Counters;
+    std::chrono::high_resolution_clock::time_point StartTime;
+    std::thread Reporter;
+    std::mutex Mutex;
+    std::condition_variable Stopped;
+    bool StopRequested;
+};
@@ -8,103 +8,165 @@
 
 using namespace std;
 
-TDocumentTrainContext TTrainThread::BuildDocument(const TDocument& doc) {
-    TDocumentTrainContext Context;
-    Context.DocumentVector = &Spec.NeuralNetwork->GetDocumentVector(doc.GetIndex());
-    for (const auto& wordStr : doc.GetWords()) {
-        shared_ptr<TWord> word;
-        if (!Spec.WordsVocabulary->GetWord(wordStr, word))
-            continue;
-        WordCount += 1;
-        Context.SentenceNosample.push_back(word->Index);
-        if (!DownSample(word->Frequency)) {
-            Context.Sentence.push_back(word->Index);
+template <typename T>
+void TTrainThread<T>::operator()() {
+    if (Spec.PinThreads && !PinCurrentThread(Spec.ThreadIndex))
+        std::cerr << "Cannot pin train thread " << Spec.ThreadIndex << "." << std::endl;
+    // Scratch is sized here and not in constructor: copies of the thread object don't keep reserved capacity
+    ReserveScratch();
+    TAllocationCountingGuard allocationCounting;
+    bool negativeSampling = Spec.NegativeSampleNum > 0;
+    if (Spec.BatchNegatives) {
+        // Validated by TDoc2Vec::Train
+        assert(!Spec.CBOW && !Spec.HierarchicalSoftmax && negativeSampling);
+        Train<false, false, true, true>();
+    } else if (Spec.CBOW) {
+        if (Spec.HierarchicalSoftmax) {
+            negativeSampling ? Train<true, true, true>() : Train<true, true, false>();
+        } else {
+            negativeSampling ? Train<true, false, true>() : Train<true, false, false>();
+        }
+    } else {
+        if (Spec.HierarchicalSoftmax) {
+            negativeSampling ? Train<false, true, true>() : Train<false, true, false>();
+        } else {
+            negativeSampling ? Train<false, false, true>() : Train<false, false, false>();
         }
     }
+}
+
+template <typename T>
+template <bool CBOW, bool HierarchicalSoftmax, bool NegativeSampling, bool BatchNegatives>
+void TTrainThread<T>::Train() {
+    TDocumentChunk chunk;
+    while (Spec.Scheduler->Next(chunk)) {
+        for (unsigned int i = 0; i < chunk.DocumentNum; ++i) {
+            BuildDocument(chunk, i, DocContext);
+            if (!DocContext.Valid)
+                continue;
+            TrainDocument<CBOW, HierarchicalSoftmax, NegativeSampling, BatchNegatives>(DocContext);
+            // Own cache line of the thread, reporter reads it
+            Spec.Progress->Add(Spec.ThreadIndex, DocContext.SentenceNosampleLength);
+        }
+        Spec.Scheduler->Release(chunk);
+    }
+}
+
+template <typename T>
+void TTrainThread<T>::ReserveScratch() {
+    DocContext.Sentence.reserve(Spec.Scheduler->GetMaxDocumentLength());
+    Context.reserve(2 * Spec.WindowSize);
+    Neu1.assign(Spec.DimensionSize, 0);
+    Neu1E.assign(Spec.DimensionSize, 0);
+    if (Spec.BatchNegatives) {
+        size_t inputNum = 2 * Spec.WindowSize + 1, outputNum = Spec.NegativeSampleNum + 1;
+        BatchTargets.reserve(outputNum);
+        BatchInputs.reserve(inputNum * Spec.DimensionSize);
+        BatchOutputs.reserve(outputNum * Spec.DimensionSize);
+        BatchInputErrors.reserve(inputNum * Spec.DimensionSize);
+        BatchOutputErrors.reserve(outputNum * Spec.DimensionSize);
+        BatchGradients.reserve(inputNum * outputNum);
+    }
+}
+
+template <typename T>
+void TTrainThread<T>::BuildDocument(const TDocumentChunk& chunk, unsigned int chunkDocIndex, TDocumentTrainContext<T>& Context) {
+    Context.Sentence.clear();
+    Context.DocumentVector = Spec.NeuralNetwork->GetDocumentVector(chunk.FirstDocument + chunkDocIndex);
+    Context.SentenceNosample = chunk.Tokens + chunk.Offsets[chunkDocIndex];
+    Context.SentenceNosampleLength = chunk.Offsets[chunkDocIndex + 1] - chunk.Offsets[chunkDocIndex];
+    const uint32_t* keepThresholds = Spec.WordsVocabulary->GetKeepThresholds().data();
+    for (size_t i = 0; i < Context.SentenceNosampleLength; ++i) {
+        uint32_t word = Context.SentenceNosample[i];
+        if (Random.Next() <= keepThresholds[word])
+            Context.Sentence.push_back(word);
+    }
     Context.Valid = true;
-    return Context;
 }
 
-void TTrainThread::TrainDocument(const TDocumentTrainContext& docContext) {
+template <typename T>
+template <bool CBOW, bool HierarchicalSoftmax, bool NegativeSampling, bool BatchNegatives>
+void TTrainThread<T>::TrainDocument(const TDocumentTrainContext<T>& docContext) {
     size_t sentenceSize = docContext.Sentence.size();
     int sentenceSizeInt = static_cast<int>(sentenceSize);
     int windowSize = static_cast<int>(Spec.WindowSize);
     for (size_t sentencePosition = 0; sentencePosition < sentenceSize; ++sentencePosition) {
-        std::vector<unsigned int> context;
-        int b = rand() % Spec.WindowSize;
+        Context.clear();
+        int b = static_cast<int>(Random.NextIndex(Spec.WindowSize));
         int sentencePositionInt = static_cast<int>(sentencePosition);
         size_t contextStart = static_cast<size_t>(std::max(0, sentencePositionInt - windowSize + b));
         size_t contextEnd = static_cast<size_t>(std::min(sentenceSizeInt, sentencePositionInt + windowSize - b + 1));
         for (size_t i = contextStart; i < contextEnd; ++i) {
             if (i != sentencePosition)
-                context.push_back(docContext.Sentence[i]);
+                Context.push_back(docContext.Sentence[i]);
         }
 
-        if (Spec.CBOW) {
-            TrainSampleCBOW(docContext.Sentence[sentencePosition], context, *docContext.DocumentVector);
+        if (BatchNegatives) {
+            TrainWindowBatched(docContext.Sentence[sentencePosition], Context, docContext.DocumentVector);
+        } else if (CBOW) {
+            TrainSampleCBOW<HierarchicalSoftmax, NegativeSampling>(docContext.Sentence[sentencePosition], Context, docContext.DocumentVector);
         } else {
-            TrainSampleSG(context);
+            TrainSampleSG<HierarchicalSoftmax, NegativeSampling>(Context);
         }
     }
 
-    if (!Spec.CBOW) {
-        for (const auto& lastWord : docContext.SentenceNosample) {
-            TrainPairSG(lastWord, *docContext.DocumentVector);
+    // Document vector is an input of every batched window already
+    if (!CBOW && !BatchNegatives) {
+        for (size_t i = 0; i < docContext.SentenceNosampleLength; ++i) {
+            TrainPairSG<HierarchicalSoftmax, NegativeSampling>(docContext.SentenceNosample[i], docContext.DocumentVector);
         }
     }
 }
 
-void TTrainThread::TrainSampleSG(const std::vector<unsigned int>& context) {
+template <typename T>
+template <bool HierarchicalSoftmax, bool NegativeSampling>
+void TTrainThread<T>::TrainSampleSG(const std::vector<unsigned int>& context) {
     for (const auto& lastWord : context) {
-        auto& vector = Spec.NeuralNetwork->GetWordVector(lastWord);
-        TrainPairSG(lastWord, vector);
+        auto vector = Spec.NeuralNetwork->GetWordVector(lastWord);
+        TrainPairSG<HierarchicalSoftmax, NegativeSampling>(lastWord, vector);
     }
 }
 
-void TTrainThread::TrainPairSG(unsigned int centralWord, TLayerVector<double>& context) {
-    TSimpleLockGuard<TLayerVector<double>> lgContext(context);
-
-    vector<double> Neu1E(Spec.DimensionSize, 0);
-    if (Spec.HierarchicalSoftmax) {
-        shared_ptr<TWord> word;
-        if (!Spec.WordsVocabulary->GetWord(centralWord, word))
-            throw runtime_error("TrainPairSG: HierarchicalSoftmax can't find word");
-        for (size_t d = 0; d < word->Code.size(); ++d) {
-            double f = 0;
-            size_t wordIndex = word->Point[d];
-
-            TLayerVector<double>& wordVector = Spec.NeuralNetwork->GetHierarchicalSoftmaxVector(wordIndex);
-            TSimpleLockGuard<TLayerVector<double>> lgWord(wordVector);
+template <typename T>
+template <bool HierarchicalSoftmax, bool NegativeSampling>
+void TTrainThread<T>::TrainPairSG(unsigned int centralWord, TLayerVector<T> context) {
+    TSimpleLockGuard<TLayerVector<T>> lgContext(context);
+
+    fill(Neu1E.begin(), Neu1E.end(), 0);
+    if (HierarchicalSoftmax) {
+        const THuffmanTable& huffmanTable = Spec.WordsVocabulary->GetHuffmanTable();
+        assert(centralWord < huffmanTable.Size());
+        const uint8_t* codes = huffmanTable.GetCodes(centralWord);
+        const uint32_t* points = huffmanTable.GetPoints(centralWord);
+        unsigned int codeLength = huffmanTable.GetCodeLength(centralWord);
+        for (size_t d = 0; d < codeLength; ++d) {
+            T f = 0;
+            size_t wordIndex = points[d];
+
+            TLayerVector<T> wordVector = Spec.NeuralNetwork->GetHierarchicalSoftmaxVector(wordIndex);
+            TSimpleLockGuard<TLayerVector<T>> lgWord(wordVector);
 
             // hidden -> output
-            assert(context.Size() == wordVector.Size());
-            for (size_t i = 0; i < context.Size(); ++i)
-                f += context[i] * wordVector[i];
+            f = Kernels.Dot(context.Begin(), wordVector.Begin(), Spec.DimensionSize);
 
             if (std::isnan(f) || f <= -MAX_EXP || f >= MAX_EXP) {
                 continue;
             } else {
-                f = GetExpTableCell(f);
+                f = Sigmoid(f);
             }
 
             // gradient
-            double g = (1.0 - static_cast<double>(word->Code[d]) - f) * Spec.Alpha->Get();
+            T g = (1 - static_cast<T>(codes[d]) - f) * Spec.Alpha->Get();
 
-            // output -> hidden
-            assert(Neu1E.size() == wordVector.Size());
-            for (size_t i = 0; i < Neu1E.size(); ++i)
-                Neu1E[i] += g * wordVector[i];
-
-            // learn weights
-            for (size_t i = 0; i < context.Size(); ++i)
-                wordVector[i] += g * context[i];
+            // output -> hidden, learn weights
+            Kernels.AxpyPair(g, context.Begin(), wordVector.Begin(), Neu1E.data(), Spec.DimensionSize);
         }
     }
 
-    if (Spec.NegativeSampleNum > 0) {
+    if (NegativeSampling) {
         for (size_t d = 0; d <= Spec.NegativeSampleNum; ++d) {
             unsigned int target;
-            double label;
+            T label;
             if (d == 0) {
                 target = centralWord;
                 label = 1;
@@ -115,110 +177,83 @@ void TTrainThread::TrainPairSG(unsigned int centralWord, TLayerVector<double>& c
                 label = 0;
             }
 
-            double f = 0, g = 0;
-            TLayerVector<double>& negativeSampleVector = Spec.NeuralNetwork->GetNegativeSampleVector(target);
-            TSimpleLockGuard<TLayerVector<double>> lgNeg(negativeSampleVector);;
+            T f = 0, g = 0;
+            TLayerVector<T> negativeSampleVector = Spec.NeuralNetwork->GetNegativeSampleVector(target);
+            TSimpleLockGuard<TLayerVector<T>> lgNeg(negativeSampleVector);
 
-            assert(negativeSampleVector.Size() == context.Size());
-            assert(negativeSampleVector.Size() == Spec.DimensionSize);
-            for (size_t i = 0; i < negativeSampleVector.Size(); ++i)
-                f += context[i] * negativeSampleVector[i];
+            f = Kernels.Dot(context.Begin(), negativeSampleVector.Begin(), Spec.DimensionSize);
 
-            if (f > MAX_EXP) {
-                g = (label - 1) * Spec.Alpha->Get();
-            } else if (f < -MAX_EXP) {
-                g = label * Spec.Alpha->Get();
-            } else {
-                g = (label - GetExpTableCell(f)) * Spec.Alpha->Get();
-            }
+            g = (label - Sigmoid(f)) * Spec.Alpha->Get();
 
-            assert(Neu1E.size() == negativeSampleVector.Size());
-            assert(Neu1E.size() == Spec.DimensionSize);
-            for (size_t i = 0; i < Neu1E.size(); ++i)
-                Neu1E[i] += g * negativeSampleVector[i];
-
-            for (size_t i = 0; i < context.Size(); ++i)
-                negativeSampleVector[i] += g * context[i];
+            Kernels.AxpyPair(g, context.Begin(), negativeSampleVector.Begin(), Neu1E.data(), Spec.DimensionSize);
         }
     }
 
     // input -> hidden
-    assert(Neu1E.size() == context.Size());
-    for (size_t i = 0; i < Neu1E.size(); ++i)
-        context[i] += Neu1E[i];
+    Kernels.Axpy(1, Neu1E.data(), context.Begin(), Spec.DimensionSize);
 }
 
-void TTrainThread::TrainSampleCBOW(
+template <typename T>
+template <bool HierarchicalSoftmax, bool NegativeSampling>
+void TTrainThread<T>::TrainSampleCBOW(
     unsigned int centralWord,
     const vector<unsigned int>& context,
-    TLayerVector<double>& docVector
+    TLayerVector<T> docVector
 ) {
-    TSimpleLockGuard<TLayerVector<double>> lgDoc(docVector);
+    TSimpleLockGuard<TLayerVector<T>> lgDoc(docVector);
 
-    vector<double> Neu1(Spec.DimensionSize, 0);
-    vector<double> Neu1E(Spec.DimensionSize, 0);
+    fill(Neu1.begin(), Neu1.end(), 0);
+    fill(Neu1E.begin(), Neu1E.end(), 0);
     unsigned int cw = 0;
 
     // in -> Hidden
     for (const auto& contextIndex : context) {
-        auto& wordVector = Spec.NeuralNetwork->GetWordVector(contextIndex);
-        TSimpleLockGuard<TLayerVector<double>> lgWord(wordVector);
+        auto wordVector = Spec.NeuralNetwork->GetWordVector(contextIndex);
+        TSimpleLockGuard<TLayerVector<T>> lgWord(wordVector);
 
-        assert(wordVector.Size() == Neu1.size());
-        for (size_t i = 0; i < Neu1.size(); ++i)
-            Neu1[i] += wordVector[i];
+        Kernels.Axpy(1, wordVector.Begin(), Neu1.data(), Spec.DimensionSize);
         cw += 1;
     }
 
-    assert(docVector.Size() == Neu1.size());
-    for (size_t i = 0; i < Neu1.size(); ++i)
-        Neu1[i] += docVector[i];
-
+    Kernels.Axpy(1, docVector.Begin(), Neu1.data(), Spec.DimensionSize);
     cw += 1;
-    for (size_t i = 0; i < Neu1.size(); ++i)
-        Neu1[i] /= cw;
+    Kernels.Scale(static_cast<T>(1) / cw, Neu1.data(), Spec.DimensionSize);
 
 
-    if (Spec.HierarchicalSoftmax) {
-        shared_ptr<TWord> word;
-        if (!Spec.WordsVocabulary->GetWord(centralWord, word))
-            throw runtime_error("TrainSampleCBOW: HierarchicalSoftmax can't find word");
-        for (size_t d = 0; d < word->Code.size(); ++d) {
-            double f = 0;
-            size_t wordIndex = word->Point[d];
+    if (HierarchicalSoftmax) {
+        const THuffmanTable& huffmanTable = Spec.WordsVocabulary->GetHuffmanTable();
+        assert(centralWord < huffmanTable.Size());
+        const uint8_t* codes = huffmanTable.GetCodes(centralWord);
+        const uint32_t* points = huffmanTable.GetPoints(centralWord);
+        unsigned int codeLength = huffmanTable.GetCodeLength(centralWord);
+        for (size_t d = 0; d < codeLength; ++d) {
+            T f = 0;
+            size_t wordIndex = points[d];
 
-            TLayerVector<double>& wordVector = Spec.NeuralNetwork->GetHierarchicalSoftmaxVector(wordIndex);
-            TSimpleLockGuard<TLayerVector<double>> lgWord(wordVector);
+            TLayerVector<T> wordVector = Spec.NeuralNetwork->GetHierarchicalSoftmaxVector(wordIndex);
+            TSimpleLockGuard<TLayerVector<T>> lgWord(wordVector);
 
             // hidden -> output
-            assert(Neu1.size() == wordVector.Size());
-            for (size_t i = 0; i < Neu1.size(); ++i)
-                f += Neu1[i] * wordVector[i];
+            f = Kernels.Dot(Neu1.data(), wordVector.Begin(), Spec.DimensionSize);
 
             if (std::isnan(f) || f <= -MAX_EXP || f >= MAX_EXP) {
                 continue;
             } else {
-                f = GetExpTableCell(f);
+                f = Sigmoid(f);
             }
 
             // gradient
-            double g = (1.0 - static_cast<double>(word->Code[d]) - f) * Spec.Alpha->Get();
+            T g = (1 - static_cast<T>(codes[d]) - f) * Spec.Alpha->Get();
 
-            // output -> hidden
-            assert(Neu1E.size() == wordVector.Size());
-            for (size_t i = 0; i < Neu1E.size(); ++i)
-                Neu1E[i] += g * wordVector[i];
-
-            // learn weights
-            for (size_t i = 0; i < Neu1E.size(); ++i)
-                wordVector[i] += g * Neu1[i];
+            // output -> hidden, learn weights
+            Kernels.AxpyPair(g, Neu1.data(), wordVector.Begin(), Neu1E.data(), Spec.DimensionSize);
         }
     }
 
-    if (Spec.NegativeSampleNum > 0) {
+    if (NegativeSampling) {
         for (size_t d = 0; d <= Spec.NegativeSampleNum; ++d) {
             unsigned int target;
-            double label;
+            T label;
             if (d == 0) {
                 target = centralWord;
                 label = 1;
@@ -229,44 +264,98 @@ void TTrainThread::TrainSampleCBOW(
                 label = 0;
             }
 
-            double f = 0, g = 0;
-            TLayerVector<double>& negativeSampleVector = Spec.NeuralNetwork->GetNegativeSampleVector(target);
-            TSimpleLockGuard<TLayerVector<double>> lgNeg(negativeSampleVector);
-
-            assert(negativeSampleVector.Size() == Neu1.size());
-            assert(Neu1.size() == Spec.DimensionSize);
-            for (size_t i = 0; i < negativeSampleVector.Size(); ++i)
-                f += Neu1[i] * negativeSampleVector[i];
+            T f = 0, g = 0;
+            TLayerVector<T> negativeSampleVector = Spec.NeuralNetwork->GetNegativeSampleVector(target);
+            TSimpleLockGuard<TLayerVector<T>> lgNeg(negativeSampleVector);
 
-            if (std::isnan(f) || f > MAX_EXP) {
-                g = (label - 1) * Spec.Alpha->Get();
-            } else if (f < -MAX_EXP) {
-                g = label * Spec.Alpha->Get();
-            } else {
-                g = (label - GetExpTableCell(f)) * Spec.Alpha->Get();
-            }
+            f = Kernels.Dot(Neu1.data(), negativeSampleVector.Begin(), Spec.DimensionSize);
 
-            assert(Neu1E.size() == negativeSampleVector.Size());
-            assert(Neu1E.size() == Spec.DimensionSize);
-            for (size_t i = 0; i < Neu1E.size(); ++i)
-                Neu1E[i] += g * negativeSampleVector[i];
+            g = (label - Sigmoid(f)) * Spec.Alpha->Get();
 
-            for (size_t i = 0; i < Neu1.size(); ++i)
-                negativeSampleVector[i] += g * Neu1[i];
+            Kernels.AxpyPair(g, Neu1.data(), negativeSampleVector.Begin(), Neu1E.data(), Spec.DimensionSize);
         }
     }
 
     // hidden -> in
     for (const auto& lastWord : context) {
-        TLayerVector<double>& wordVector = Spec.NeuralNetwork->GetWordVector(lastWord);
-        TSimpleLockGuard<TLayerVector<double>> lgWord(wordVector);
+        TLayerVector<T> wordVector = Spec.NeuralNetwork->GetWordVector(lastWord);
+        TSimpleLockGuard<TLayerVector<T>> lgWord(wordVector);
 
-        assert(wordVector.Size() == Neu1E.size());
-        for (size_t i = 0; i < Neu1E.size(); ++i)
-            wordVector[i] += Neu1E[i];
+        Kernels.Axpy(1, Neu1E.data(), wordVector.Begin(), Spec.DimensionSize);
     }
 
-    assert(docVector.Size() == Neu1E.size());
-    for (size_t i = 0; i < Neu1E.size(); ++i)
-        docVector[i] += Neu1E[i];
+    Kernels.Axpy(1, Neu1E.data(), docVector.Begin(), Spec.DimensionSize);
 }
+
+template <typename T>
+void TTrainThread<T>::TrainWindowBatched(
+    unsigned int centralWord,
+    const vector<unsigned int>& context,
+    TLayerVector<T> docVector
+) {
+    const size_t dim = Spec.DimensionSize;
+    const size_t inputNum = context.size() + 1;
+
+    // Output 0 is the central word, the others are negatives shared by all inputs
+    BatchTargets.clear();
+    BatchTargets.push_back(centralWord);
+    for (size_t d = 0; d < Spec.NegativeSampleNum; ++d) {
+        unsigned int target = ChooseNegativeSample();
+        if (target != centralWord)
+            BatchTargets.push_back(target);
+    }
+    const size_t outputNum = BatchTargets.size();
+
+    BatchInputs.resize(inputNum * dim);
+    BatchOutputs.resize(outputNum * dim);
+    BatchGradients.resize(inputNum * outputNum);
+    BatchInputErrors.assign(inputNum * dim, 0);
+    BatchOutputErrors.assign(outputNum * dim, 0);
+
+    // gather
+    for (size_t m = 0; m < inputNum; ++m) {
+        TLayerVector<T> input = m < context.size() ? Spec.NeuralNetwork->GetWordVector(context[m]) : docVector;
+        TSimpleLockGuard<TLayerVector<T>> lgInput(input);
+        copy(input.Begin(), input.Begin() + dim, BatchInputs.begin() + m * dim);
+    }
+    for (size_t n = 0; n < outputNum; ++n) {
+        TLayerVector<T> output = Spec.NeuralNetwork->GetNegativeSampleVector(BatchTargets[n]);
+        TSimpleLockGuard<TLayerVector<T>> lgOutput(output);
+        copy(output.Begin(), output.Begin() + dim, BatchOutputs.begin() + n * dim);
+    }
+
+    // gradients = (labels - sigmoid(inputs * outputs^T)) * alpha, sigmoid runs over the whole matrix at once
+    Kernels.DotMatrix(BatchInputs.data(), inputNum, BatchOutputs.data(), outputNum, BatchGradients.data(), dim);
+    if (Sigmoid.GetMode() == ESigmoid::Rational) {
+        Kernels.Sigmoid(BatchGradients.data(), BatchGradients.size());
+    } else {
+        for (auto& f : BatchGradients)
+            f = Sigmoid.Interpolate(f);
+    }
+    T alpha = Spec.Alpha->Get();
+    for (size_t m = 0; m < inputNum; ++m) {
+        for (size_t n = 0; n < outputNum; ++n) {
+            T label = n == 0 ? 1 : 0;
+            BatchGradients[m * outputNum + n] = (label - BatchGradients[m * outputNum + n]) * alpha;
+        }
+    }
+
+    // input errors = gradients * outputs, output errors = gradients^T * inputs
+    Kernels.AxpyMatrix(BatchGradients.data(), outputNum, 1, BatchOutputs.data(), outputNum, BatchInputErrors.data(), inputNum, dim);
+    Kernels.AxpyMatrix(BatchGradients.data(), 1, outputNum, BatchInputs.data(), inputNum, BatchOutputErrors.data(), outputNum, dim);
+
+    // scatter
+    for (size_t m = 0; m < inputNum; ++m) {
+        TLayerVector<T> input = m < context.size() ? Spec.NeuralNetwork->GetWordVector(context[m]) : docVector;
+        TSimpleLockGuard<TLayerVector<T>> lgInput(input);
+        Kernels.Axpy(1, &BatchInputErrors[m * dim], input.Begin(), dim);
+    }
+    for (size_t n = 0; n < outputNum; ++n) {
+        TLayerVector<T> output = Spec.NeuralNetwork->GetNegativeSampleVector(BatchTargets[n]);
+        TSimpleLockGuard<TLayerVector<T>> lgOutput(output);
+        Kernels.Axpy(1, &BatchOutputErrors[n * dim], output.Begin(), dim);
+    }
+}
+
+template class TTrainThread<float>;
+template class TTrainThread<double>;
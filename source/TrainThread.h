@@ -3,82 +3,88 @@
 #include "Vocabulary.h"
 #include "Common.h"
 #include "Doc2Vec.h"
+#include "System.h"
+#include "VectorKernels.h"
+#include "Random.h"
+#include "Sigmoid.h"
 
 #include <memory>
 #include <vector>
 #include <cmath>
 #include <cassert>
-#include <cstdlib>
 #include <chrono>
+#include <iostream>
+#include <algorithm>
 
 
+template <typename T>
 struct TDocumentTrainContext {
     TDocumentTrainContext()
-        : Valid(false)
+        : SentenceNosample(nullptr)
+        , SentenceNosampleLength(0)
+        , Valid(false)
     {}
 
-    TLayerVector<double>* DocumentVector;
-    unsigned int SentenceLength;
-    unsigned int SentenceNosampleLength;
-    std::vector<unsigned int> SentenceNosample;
+    TLayerVector<T> DocumentVector;
+    // All words of document, they are in the corpus buffer
+    const uint32_t* SentenceNosample;
+    size_t SentenceNosampleLength;
+    // Words left after subsampling
     std::vector<unsigned int> Sentence;
     bool Valid;
 };
 
+template <typename T>
 class TTrainThread {
 public:
-    TTrainThread(const TTrainThreadSpec& spec)
+    TTrainThread(const TTrainThreadSpec<T>& spec)
         : Spec(spec)
-        , Distribution(0.0, 1.0)
-        , WordCount(0)
+        , Kernels(GetVectorKernels<T>(spec.DimensionSize))
+        , Random(TRAIN_RANDOM_SEED, spec.ThreadIndex)
+        , Sigmoid(spec.Sigmoid)
     {}
 
-    void operator()() {
-        for (unsigned int iter = 0; iter < Spec.IterationNumber; ++iter) {
-            for (const auto& doc : Spec.DocumentsHolder.GetDocuments()) {
-                if (WordCount > UPDATE_WORD_NUMBER) {
-                    Spec.Alpha->Update(WordCount); // Update learning rate
-                    WordCount = 0;
-                }
-                TDocumentTrainContext docContext = BuildDocument(*doc);
-                if (!docContext.Valid)
-                    continue;
-                TrainDocument(docContext);
-            }
-            Spec.Alpha->Update(WordCount);
-            WordCount = 0;
-        }
-    }
+    // Loss and architecture are dispatched here once, training loops are compiled for every combination
+    void operator()();
 private:
-    TDocumentTrainContext BuildDocument(const TDocument& doc);
-    void TrainDocument(const TDocumentTrainContext& docContext);
-    void TrainSampleCBOW(unsigned int, const std::vector<unsigned int>&, TLayerVector<double>&);
+    template <bool CBOW, bool HierarchicalSoftmax, bool NegativeSampling, bool BatchNegatives = false>
+    void Train();
+    // Scratch is sized for the longest document and the widest window once, training doesn't allocate after it
+    void ReserveScratch();
+    void BuildDocument(const TDocumentChunk& chunk, unsigned int chunkDocIndex, TDocumentTrainContext<T>& context);
+    template <bool CBOW, bool HierarchicalSoftmax, bool NegativeSampling, bool BatchNegatives>
+    void TrainDocument(const TDocumentTrainContext<T>& docContext);
+    // Context words and document vector of a window are trained together against the central word
+    // and one set of shared negative samples, as small matrix products over gathered rows
+    void TrainWindowBatched(unsigned int centralWord, const std::vector<unsigned int>& context, TLayerVector<T> docVector);
+    template <bool HierarchicalSoftmax, bool NegativeSampling>
+    void TrainSampleCBOW(unsigned int, const std::vector<unsigned int>&, TLayerVector<T>);
+    template <bool HierarchicalSoftmax, bool NegativeSampling>
     void TrainSampleSG(const std::vector<unsigned int>&);
-    void TrainPairSG(unsigned int lastWord, TLayerVector<double>& DocumentVector);
+    template <bool HierarchicalSoftmax, bool NegativeSampling>
+    void TrainPairSG(unsigned int lastWord, TLayerVector<T> DocumentVector);
 
 private:
-    bool DownSample(unsigned int wordFrequency) {
-        if (Spec.Sample > 0) {
-            auto tmp = Spec.Sample * Spec.WordsVocabulary->GetTrainWordsCount();
-            double ran = (std::sqrt(wordFrequency / tmp) + 1) * tmp / wordFrequency;
-            return ran < Distribution(RandGenerator);
-        }
-        return false;
-    }
-
-    unsigned int ChooseNegativeSample() const {
-        size_t randIndex = rand() % Spec.NegativeSampleTable->size();
-        return (*Spec.NegativeSampleTable)[randIndex];
+    unsigned int ChooseNegativeSample() {
+        return Spec.NegativeSampler->Sample(Random);
     }
 
-    double GetExpTableCell(double f) const {
-        size_t index = static_cast<size_t>((f + MAX_EXP) * (EXP_TABLE_SIZE / MAX_EXP / 2));
-        assert(index < Spec.ExpTable->size());
-        return (*Spec.ExpTable)[index];
-    }
 private:
-    TTrainThreadSpec Spec;
-    std::default_random_engine RandGenerator;
-    std::uniform_real_distribution<double> Distribution;
-    unsigned long long WordCount;
+    TTrainThreadSpec<T> Spec;
+    const TVectorKernels<T>& Kernels;
+    // Every thread has its own stream of one seed, runs with the same thread number are reproducible
+    TFastRandom Random;
+    TSigmoid Sigmoid;
+    // Scratch reused for the life of the thread
+    TDocumentTrainContext<T> DocContext;
+    std::vector<unsigned int> Context;
+    std::vector<T> Neu1;
+    std::vector<T> Neu1E;
+    // Scratch of TrainWindowBatched, row-major matrices with DimensionSize columns
+    std::vector<unsigned int> BatchTargets;
+    std::vector<T> BatchInputs;
+    std::vector<T> BatchOutputs;
+    std::vector<T> BatchInputErrors;
+    std::vector<T> BatchOutputErrors;
+    std::vector<T> BatchGradients;
 };
@@ -0,0 +1,312 @@
+#include "VectorKernels.h"
+#include "Sigmoid.h"
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+#include <cassert>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DOC2VEC_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace NScalarKernels {
+    template <typename T>
+    struct TScalarOps {
+        typedef T TScalar;
+        typedef T TReg;
+        static const size_t Width = 1;
+
+        static TReg Zero() { return 0; }
+        static TReg Set1(T value) { return value; }
+        static TReg Load(const T* ptr) { return *ptr; }
+        static void Store(T* ptr, TReg value) { *ptr = value; }
+        static TReg Add(TReg a, TReg b) { return a + b; }
+        static TReg Mul(TReg a, TReg b) { return a * b; }
+        static TReg MulAdd(TReg a, TReg b, TReg c) { return a * b + c; }
+        static TReg Div(TReg a, TReg b) { return a / b; }
+        static TReg Min(TReg a, TReg b) { return std::min(a, b); }
+        static TReg Max(TReg a, TReg b) { return std::max(a, b); }
+        static T Sum(TReg value) { return value; }
+    };
+
+    typedef TScalarOps<float> TFloatOps;
+    typedef TScalarOps<double> TDoubleOps;
+
+#include "VectorKernelsImpl.h"
+}
+
+#ifdef DOC2VEC_X86_KERNELS
+
+#pragma GCC push_options
+#pragma GCC target("sse2")
+namespace NSse2Kernels {
+    struct TFloatOps {
+        typedef float TScalar;
+        typedef __m128 TReg;
+        static const size_t Width = 4;
+
+        static TReg Zero() { return _mm_setzero_ps(); }
+        static TReg Set1(float value) { return _mm_set1_ps(value); }
+        static TReg Load(const float* ptr) { return _mm_loadu_ps(ptr); }
+        static void Store(float* ptr, TReg value) { _mm_storeu_ps(ptr, value); }
+        static TReg Add(TReg a, TReg b) { return _mm_add_ps(a, b); }
+        static TReg Mul(TReg a, TReg b) { return _mm_mul_ps(a, b); }
+        static TReg MulAdd(TReg a, TReg b, TReg c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+        static TReg Div(TReg a, TReg b) { return _mm_div_ps(a, b); }
+        static TReg Min(TReg a, TReg b) { return _mm_min_ps(a, b); }
+        static TReg Max(TReg a, TReg b) { return _mm_max_ps(a, b); }
+        static float Sum(TReg value) {
+            TReg shuffled = _mm_shuffle_ps(value, value, _MM_SHUFFLE(2, 3, 0, 1));
+            TReg sums = _mm_add_ps(value, shuffled);
+            shuffled = _mm_movehl_ps(shuffled, sums);
+            return _mm_cvtss_f32(_mm_add_ss(sums, shuffled));
+        }
+    };
+
+    struct TDoubleOps {
+        typedef double TScalar;
+        typedef __m128d TReg;
+        static const size_t Width = 2;
+
+        static TReg Zero() { return _mm_setzero_pd(); }
+        static TReg Set1(double value) { return _mm_set1_pd(value); }
+        static TReg Load(const double* ptr) { return _mm_loadu_pd(ptr); }
+        static void Store(double* ptr, TReg value) { _mm_storeu_pd(ptr, value); }
+        static TReg Add(TReg a, TReg b) { return _mm_add_pd(a, b); }
+        static TReg Mul(TReg a, TReg b) { return _mm_mul_pd(a, b); }
+        static TReg MulAdd(TReg a, TReg b, TReg c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+        static TReg Div(TReg a, TReg b) { return _mm_div_pd(a, b); }
+        static TReg Min(TReg a, TReg b) { return _mm_min_pd(a, b); }
+        static TReg Max(TReg a, TReg b) { return _mm_max_pd(a, b); }
+        static double Sum(TReg value) {
+            return _mm_cvtsd_f64(_mm_add_sd(value, _mm_unpackhi_pd(value, value)));
+        }
+    };
+
+#include "VectorKernelsImpl.h"
+}
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+namespace NAvx2Kernels {
+    struct TFloatOps {
+        typedef float TScalar;
+        typedef __m256 TReg;
+        static const size_t Width = 8;
+
+        static TReg Zero() { return _mm256_setzero_ps(); }
+        static TReg Set1(float value) { return _mm256_set1_ps(value); }
+        static TReg Load(const float* ptr) { return _mm256_loadu_ps(ptr); }
+        static void Store(float* ptr, TReg value) { _mm256_storeu_ps(ptr, value); }
+        static TReg Add(TReg a, TReg b) { return _mm256_add_ps(a, b); }
+        static TReg Mul(TReg a, TReg b) { return _mm256_mul_ps(a, b); }
+        static TReg MulAdd(TReg a, TReg b, TReg c) { return _mm256_fmadd_ps(a, b, c); }
+        static TReg Div(TReg a, TReg b) { return _mm256_div_ps(a, b); }
+        static TReg Min(TReg a, TReg b) { return _mm256_min_ps(a, b); }
+        static TReg Max(TReg a, TReg b) { return _mm256_max_ps(a, b); }
+        static float Sum(TReg value) {
+            __m128 half = _mm_add_ps(_mm256_castps256_ps128(value), _mm256_extractf128_ps(value, 1));
+            half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+            return _mm_cvtss_f32(_mm_add_ss(half, _mm_shuffle_ps(half, half, 1)));
+        }
+    };
+
+    struct TDoubleOps {
+        typedef double TScalar;
+        typedef __m256d TReg;
+        static const size_t Width = 4;
+
+        static TReg Zero() { return _mm256_setzero_pd(); }
+        static TReg Set1(double value) { return _mm256_set1_pd(value); }
+        static TReg Load(const double* ptr) { return _mm256_loadu_pd(ptr); }
+        static void Store(double* ptr, TReg value) { _mm256_storeu_pd(ptr, value); }
+        static TReg Add(TReg a, TReg b) { return _mm256_add_pd(a, b); }
+        static TReg Mul(TReg a, TReg b) { return _mm256_mul_pd(a, b); }
+        static TReg MulAdd(TReg a, TReg b, TReg c) { return _mm256_fmadd_pd(a, b, c); }
+        static TReg Div(TReg a, TReg b) { return _mm256_div_pd(a, b); }
+        static TReg Min(TReg a, TReg b) { return _mm256_min_pd(a, b); }
+        static TReg Max(TReg a, TReg b) { return _mm256_max_pd(a, b); }
+        static double Sum(TReg value) {
+            __m128d half = _mm_add_pd(_mm256_castpd256_pd128(value), _mm256_extractf128_pd(value, 1));
+            return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+        }
+    };
+
+#include "VectorKernelsImpl.h"
+}
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+namespace NAvx512Kernels {
+    struct TFloatOps {
+        typedef float TScalar;
+        typedef __m512 TReg;
+        static const size_t Width = 16;
+
+        static TReg Zero() { return _mm512_setzero_ps(); }
+        static TReg Set1(float value) { return _mm512_set1_ps(value); }
+        static TReg Load(const float* ptr) { return _mm512_loadu_ps(ptr); }
+        static void Store(float* ptr, TReg value) { _mm512_storeu_ps(ptr, value); }
+        static TReg Add(TReg a, TReg b) { return _mm512_add_ps(a, b); }
+        static TReg Mul(TReg a, TReg b) { return _mm512_mul_ps(a, b); }
+        static TReg MulAdd(TReg a, TReg b, TReg c) { return _mm512_fmadd_ps(a, b, c); }
+        static TReg Div(TReg a, TReg b) { return _mm512_div_ps(a, b); }
+        // Unmasked min and max trip -Wmaybe-uninitialized in GCC 12 headers too, full mask versions are the same instructions
+        static TReg Min(TReg a, TReg b) { return _mm512_mask_min_ps(a, 0xFFFF, a, b); }
+        static TReg Max(TReg a, TReg b) { return _mm512_mask_max_ps(a, 0xFFFF, a, b); }
+        // _mm512_reduce_add_ps trips -Wuninitialized in GCC 12 headers, lanes are summed through memory instead
+        static float Sum(TReg value) {
+            alignas(64) float lanes[Width];
+            _mm512_store_ps(lanes, value);
+            float res = 0;
+            for (size_t i = 0; i < Width; ++i)
+                res += lanes[i];
+            return res;
+        }
+    };
+
+    struct TDoubleOps {
+        typedef double TScalar;
+        typedef __m512d TReg;
+        static const size_t Width = 8;
+
+        static TReg Zero() { return _mm512_setzero_pd(); }
+        static TReg Set1(double value) { return _mm512_set1_pd(value); }
+        static TReg Load(const double* ptr) { return _mm512_loadu_pd(ptr); }
+        static void Store(double* ptr, TReg value) { _mm512_storeu_pd(ptr, value); }
+        static TReg Add(TReg a, TReg b) { return _mm512_add_pd(a, b); }
+        static TReg Mul(TReg a, TReg b) { return _mm512_mul_pd(a, b); }
+        static TReg MulAdd(TReg a, TReg b, TReg c) { return _mm512_fmadd_pd(a, b, c); }
+        static TReg Div(TReg a, TReg b) { return _mm512_div_pd(a, b); }
+        static TReg Min(TReg a, TReg b) { return _mm512_mask_min_pd(a, 0xFF, a, b); }
+        static TReg Max(TReg a, TReg b) { return _mm512_mask_max_pd(a, 0xFF, a, b); }
+        static double Sum(TReg value) {
+            alignas(64) double lanes[Width];
+            _mm512_store_pd(lanes, value);
+            double res = 0;
+            for (size_t i = 0; i < Width; ++i)
+                res += lanes[i];
+            return res;
+        }
+    };
+
+#include "VectorKernelsImpl.h"
+}
+#pragma GCC pop_options
+
+#endif // DOC2VEC_X86_KERNELS
+
+string SimdToString(ESimd simd) {
+    switch (simd) {
+        case ESimd::Scalar:
+            return "scalar";
+        case ESimd::Sse2:
+            return "sse2";
+        case ESimd::Avx2:
+            return "avx2";
+        case ESimd::Avx512:
+            return "avx512";
+        default:
+            return "auto";
+    }
+}
+
+bool ParseSimd(const string& str, ESimd& simd) {
+    if (str == "auto") {
+        simd = ESimd::Auto;
+    } else if (str == "scalar") {
+        simd = ESimd::Scalar;
+    } else if (str == "sse2") {
+        simd = ESimd::Sse2;
+    } else if (str == "avx2") {
+        simd = ESimd::Avx2;
+    } else if (str == "avx512") {
+        simd = ESimd::Avx512;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+ESimd DetectSimd() {
+#ifdef DOC2VEC_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return ESimd::Avx512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return ESimd::Avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return ESimd::Sse2;
+#endif
+    return ESimd::Scalar;
+}
+
+static ESimd& SelectedSimd() {
+    static ESimd simd = DetectSimd();
+    return simd;
+}
+
+void SelectSimd(ESimd simd) {
+    ESimd detected = DetectSimd();
+    SelectedSimd() = (simd == ESimd::Auto || simd > detected) ? detected : simd;
+}
+
+ESimd GetSelectedSimd() {
+    return SelectedSimd();
+}
+
+// Kernels sets are indexed by ESimd, Auto is never selected
+template <typename T>
+struct TKernelsTables;
+
+template <>
+struct TKernelsTables<float> {
+    static const vector<TVectorKernels<float>>& Get(ESimd simd) {
+        static const vector<TVectorKernels<float>> sets[] = {
+            NScalarKernels::CreateKernelsSet<NScalarKernels::TFloatOps>(),
+            NScalarKernels::CreateKernelsSet<NScalarKernels::TFloatOps>(),
+#ifdef DOC2VEC_X86_KERNELS
+            NSse2Kernels::CreateKernelsSet<NSse2Kernels::TFloatOps>(),
+            NAvx2Kernels::CreateKernelsSet<NAvx2Kernels::TFloatOps>(),
+            NAvx512Kernels::CreateKernelsSet<NAvx512Kernels::TFloatOps>()
+#endif
+        };
+        return sets[static_cast<size_t>(simd)];
+    }
+};
+
+template <>
+struct TKernelsTables<double> {
+    static const vector<TVectorKernels<double>>& Get(ESimd simd) {
+        static const vector<TVectorKernels<double>> sets[] = {
+            NScalarKernels::CreateKernelsSet<NScalarKernels::TDoubleOps>(),
+            NScalarKernels::CreateKernelsSet<NScalarKernels::TDoubleOps>(),
+#ifdef DOC2VEC_X86_KERNELS
+            NSse2Kernels::CreateKernelsSet<NSse2Kernels::TDoubleOps>(),
+            NAvx2Kernels::CreateKernelsSet<NAvx2Kernels::TDoubleOps>(),
+            NAvx512Kernels::CreateKernelsSet<NAvx512Kernels::TDoubleOps>()
+#endif
+        };
+        return sets[static_cast<size_t>(simd)];
+    }
+};
+
+template <typename T>
+const TVectorKernels<T>& GetVectorKernels(size_t dim) {
+    const auto& kernelsSet = TKernelsTables<T>::Get(GetSelectedSimd());
+    for (const auto& kernels : kernelsSet) {
+        if (kernels.FixedSize == dim && dim > 0)
+            return kernels;
+    }
+    return kernelsSet.front();
+}
+
+template const TVectorKernels<float>& GetVectorKernels<float>(size_t);
+template const TVectorKernels<double>& GetVectorKernels<double>(size_t);
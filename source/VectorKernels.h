@@ -0,0 +1,42 @@
+#pragma once
+#include "Common.h"
+
+#include <string>
+#include <cstddef>
+
+std::string SimdToString(ESimd simd);
+bool ParseSimd(const std::string& str, ESimd& simd);
+
+// The best instruction set supported by the running CPU
+ESimd DetectSimd();
+// Kernels of this instruction set are returned by GetVectorKernels from now on, Auto means DetectSimd.
+// Instruction set which isn't supported by the running CPU is downgraded to the detected one.
+void SelectSimd(ESimd simd);
+ESimd GetSelectedSimd();
+
+// Vector primitives of training and similarity loops, vectors don't have to be aligned
+template <typename T>
+struct TVectorKernels {
+    // 0 for generic kernels, otherwise kernels are compiled for this length only and n must be equal to it
+    size_t FixedSize;
+    // sum of x[i] * y[i]
+    T (*Dot)(const T* x, const T* y, size_t n);
+    // y += alpha * x
+    void (*Axpy)(T alpha, const T* x, T* y, size_t n);
+    // x *= alpha
+    void (*Scale)(T alpha, T* x, size_t n);
+    // Gradient step of an output vector in one pass over it: error += g * out, then out += g * hidden
+    void (*AxpyPair)(T g, const T* hidden, T* out, T* error, size_t n);
+    // Matrices are row-major with n columns.
+    // c[i * bRows + j] = sum of a[i * n + k] * b[j * n + k]: dot products of every row of a with every row of b
+    void (*DotMatrix)(const T* a, size_t aRows, const T* b, size_t bRows, T* c, size_t n);
+    // Row i of y += sum of g[i * gRowStride + j * gColStride] * row j of x: y += G * x, or G^T * x with swapped strides
+    void (*AxpyMatrix)(const T* g, size_t gRowStride, size_t gColStride, const T* x, size_t xRows, T* y, size_t yRows, size_t n);
+    // x = RationalSigmoid(x) in place, n is never fixed: it is a number of dot products and not a dimension
+    void (*Sigmoid)(T* x, size_t n);
+};
+
+// Kernels table is chosen once, callers keep the reference instead of dispatching on every call.
+// For dim from SPECIALIZED_DIMENSIONS kernels fully unrolled for it are returned, they should be called with n == dim only.
+template <typename T>
+const TVectorKernels<T>& GetVectorKernels(size_t dim = 0);
@@ -0,0 +1,259 @@
+// No include guard: this file is included once per instruction set by VectorKernels.cpp,
+// inside a namespace which defines TFloatOps and TDoubleOps register wrappers and under the matching target pragma.
+// With FixedSize > 0 kernels are called with n == FixedSize only, constant trip counts let the compiler unroll the loops fully.
+
+template <size_t FixedSize>
+size_t FixedLength(size_t n) {
+    assert(FixedSize == 0 || n == FixedSize);
+    return FixedSize > 0 ? FixedSize : n;
+}
+
+template <typename TOps, size_t FixedSize>
+typename TOps::TScalar Dot(const typename TOps::TScalar* x, const typename TOps::TScalar* y, size_t n) {
+    const size_t width = TOps::Width;
+    n = FixedLength<FixedSize>(n);
+    typename TOps::TReg acc0 = TOps::Zero(), acc1 = TOps::Zero();
+    const size_t pairEnd = n - n % (2 * width), vectorEnd = n - n % width;
+    size_t i = 0;
+    for (; i < pairEnd; i += 2 * width) {
+        acc0 = TOps::MulAdd(TOps::Load(x + i), TOps::Load(y + i), acc0);
+        acc1 = TOps::MulAdd(TOps::Load(x + i + width), TOps::Load(y + i + width), acc1);
+    }
+    for (; i < vectorEnd; i += width)
+        acc0 = TOps::MulAdd(TOps::Load(x + i), TOps::Load(y + i), acc0);
+    typename TOps::TScalar res = TOps::Sum(TOps::Add(acc0, acc1));
+    for (; i < n; ++i)
+        res += x[i] * y[i];
+    return res;
+}
+
+template <typename TOps, size_t FixedSize>
+void Axpy(typename TOps::TScalar alpha, const typename TOps::TScalar* x, typename TOps::TScalar* y, size_t n) {
+    const size_t width = TOps::Width;
+    n = FixedLength<FixedSize>(n);
+    typename TOps::TReg alphaReg = TOps::Set1(alpha);
+    const size_t vectorEnd = n - n % width;
+    size_t i = 0;
+    for (; i < vectorEnd; i += width)
+        TOps::Store(y + i, TOps::MulAdd(alphaReg, TOps::Load(x + i), TOps::Load(y + i)));
+    for (; i < n; ++i)
+        y[i] += alpha * x[i];
+}
+
+template <typename TOps, size_t FixedSize>
+void Scale(typename TOps::TScalar alpha, typename TOps::TScalar* x, size_t n) {
+    const size_t width = TOps::Width;
+    n = FixedLength<FixedSize>(n);
+    typename TOps::TReg alphaReg = TOps::Set1(alpha);
+    const size_t vectorEnd = n - n % width;
+    size_t i = 0;
+    for (; i < vectorEnd; i += width)
+        TOps::Store(x + i, TOps::Mul(alphaReg, TOps::Load(x + i)));
+    for (; i < n; ++i)
+        x[i] *= alpha;
+}
+
+template <typename TOps, size_t FixedSize>
+void AxpyPair(
+    typename TOps::TScalar g,
+    const typename TOps::TScalar* hidden,
+    typename TOps::TScalar* out,
+    typename TOps::TScalar* error,
+    size_t n
+) {
+    const size_t width = TOps::Width;
+    n = FixedLength<FixedSize>(n);
+    typename TOps::TReg gReg = TOps::Set1(g);
+    const size_t vectorEnd = n - n % width;
+    size_t i = 0;
+    for (; i < vectorEnd; i += width) {
+        typename TOps::TReg outReg = TOps::Load(out + i);
+        TOps::Store(error + i, TOps::MulAdd(gReg, outReg, TOps::Load(error + i)));
+        TOps::Store(out + i, TOps::MulAdd(gReg, TOps::Load(hidden + i), outReg));
+    }
+    for (; i < n; ++i) {
+        error[i] += g * out[i];
+        out[i] += g * hidden[i];
+    }
+}
+
+// Rows x Cols dot products of rows of a and b, accumulators stay in registers over the whole length:
+// every vector loaded from a row of a is used Cols times, every vector of a row of b Rows times
+template <typename TOps, size_t FixedSize, size_t Rows, size_t Cols>
+void DotTile(
+    const typename TOps::TScalar* a,
+    const typename TOps::TScalar* b,
+    typename TOps::TScalar* c,
+    size_t cStride,
+    size_t n
+) {
+    typedef typename TOps::TReg TReg;
+    const size_t width = TOps::Width;
+    n = FixedLength<FixedSize>(n);
+    TReg acc[Rows][Cols];
+    for (size_t i = 0; i < Rows; ++i) {
+        for (size_t j = 0; j < Cols; ++j)
+            acc[i][j] = TOps::Zero();
+    }
+    const size_t vectorEnd = n - n % width;
+    size_t k = 0;
+    for (; k < vectorEnd; k += width) {
+        TReg bRegs[Cols];
+        for (size_t j = 0; j < Cols; ++j)
+            bRegs[j] = TOps::Load(b + j * n + k);
+        for (size_t i = 0; i < Rows; ++i) {
+            TReg aReg = TOps::Load(a + i * n + k);
+            for (size_t j = 0; j < Cols; ++j)
+                acc[i][j] = TOps::MulAdd(aReg, bRegs[j], acc[i][j]);
+        }
+    }
+    for (size_t i = 0; i < Rows; ++i) {
+        for (size_t j = 0; j < Cols; ++j) {
+            typename TOps::TScalar res = TOps::Sum(acc[i][j]);
+            for (size_t t = k; t < n; ++t)
+                res += a[i * n + t] * b[j * n + t];
+            c[i * cStride + j] = res;
+        }
+    }
+}
+
+template <typename TOps, size_t FixedSize, size_t Rows>
+void DotRows(
+    const typename TOps::TScalar* a,
+    const typename TOps::TScalar* b,
+    size_t bRows,
+    typename TOps::TScalar* c,
+    size_t n
+) {
+    size_t j = 0;
+    for (; j + DOT_TILE_COLS <= bRows; j += DOT_TILE_COLS)
+        DotTile<TOps, FixedSize, Rows, DOT_TILE_COLS>(a, b + j * n, c + j, bRows, n);
+    for (; j < bRows; ++j)
+        DotTile<TOps, FixedSize, Rows, 1>(a, b + j * n, c + j, bRows, n);
+}
+
+template <typename TOps, size_t FixedSize>
+void DotMatrix(
+    const typename TOps::TScalar* a,
+    size_t aRows,
+    const typename TOps::TScalar* b,
+    size_t bRows,
+    typename TOps::TScalar* c,
+    size_t n
+) {
+    n = FixedLength<FixedSize>(n);
+    size_t i = 0;
+    for (; i + DOT_TILE_ROWS <= aRows; i += DOT_TILE_ROWS)
+        DotRows<TOps, FixedSize, DOT_TILE_ROWS>(a + i * n, b, bRows, c + i * bRows, n);
+    for (; i < aRows; ++i)
+        DotRows<TOps, FixedSize, 1>(a + i * n, b, bRows, c + i * bRows, n);
+}
+
+// Rows rows of y are updated together one vector at a time: the vector of every row of x is loaded once
+// for all of them, and y is loaded and stored once instead of once per row of x
+template <typename TOps, size_t FixedSize, size_t Rows>
+void AxpyTile(
+    const typename TOps::TScalar* g,
+    size_t gRowStride,
+    size_t gColStride,
+    const typename TOps::TScalar* x,
+    size_t xRows,
+    typename TOps::TScalar* y,
+    size_t n
+) {
+    typedef typename TOps::TReg TReg;
+    const size_t width = TOps::Width;
+    n = FixedLength<FixedSize>(n);
+    const size_t vectorEnd = n - n % width;
+    size_t k = 0;
+    for (; k < vectorEnd; k += width) {
+        TReg acc[Rows];
+        for (size_t i = 0; i < Rows; ++i)
+            acc[i] = TOps::Load(y + i * n + k);
+        for (size_t j = 0; j < xRows; ++j) {
+            TReg xReg = TOps::Load(x + j * n + k);
+            for (size_t i = 0; i < Rows; ++i)
+                acc[i] = TOps::MulAdd(TOps::Set1(g[i * gRowStride + j * gColStride]), xReg, acc[i]);
+        }
+        for (size_t i = 0; i < Rows; ++i)
+            TOps::Store(y + i * n + k, acc[i]);
+    }
+    for (; k < n; ++k) {
+        for (size_t i = 0; i < Rows; ++i) {
+            typename TOps::TScalar res = y[i * n + k];
+            for (size_t j = 0; j < xRows; ++j)
+                res += g[i * gRowStride + j * gColStride] * x[j * n + k];
+            y[i * n + k] = res;
+        }
+    }
+}
+
+template <typename TOps, size_t FixedSize>
+void AxpyMatrix(
+    const typename TOps::TScalar* g,
+    size_t gRowStride,
+    size_t gColStride,
+    const typename TOps::TScalar* x,
+    size_t xRows,
+    typename TOps::TScalar* y,
+    size_t yRows,
+    size_t n
+) {
+    n = FixedLength<FixedSize>(n);
+    size_t i = 0;
+    for (; i + AXPY_TILE_ROWS <= yRows; i += AXPY_TILE_ROWS)
+        AxpyTile<TOps, FixedSize, AXPY_TILE_ROWS>(g + i * gRowStride, gRowStride, gColStride, x, xRows, y + i * n, n);
+    for (; i < yRows; ++i)
+        AxpyTile<TOps, FixedSize, 1>(g + i * gRowStride, gRowStride, gColStride, x, xRows, y + i * n, n);
+}
+
+template <typename TOps>
+void Sigmoid(typename TOps::TScalar* x, size_t n) {
+    typedef typename TOps::TReg TReg;
+    const size_t width = TOps::Width;
+    const TReg half = TOps::Set1(0.5f);
+    const TReg low = TOps::Set1(-SIGMOID_RATIONAL_CLAMP), high = TOps::Set1(SIGMOID_RATIONAL_CLAMP);
+    const size_t vectorEnd = n - n % width;
+    size_t i = 0;
+    for (; i < vectorEnd; i += width) {
+        TReg t = TOps::Min(TOps::Max(TOps::Mul(TOps::Load(x + i), half), low), high);
+        TReg t2 = TOps::Mul(t, t);
+        TReg p = TOps::Set1(SIGMOID_RATIONAL_P[6]);
+        for (int j = 5; j >= 0; --j)
+            p = TOps::MulAdd(p, t2, TOps::Set1(SIGMOID_RATIONAL_P[j]));
+        TReg q = TOps::Set1(SIGMOID_RATIONAL_Q[3]);
+        for (int j = 2; j >= 0; --j)
+            q = TOps::MulAdd(q, t2, TOps::Set1(SIGMOID_RATIONAL_Q[j]));
+        TOps::Store(x + i, TOps::MulAdd(half, TOps::Div(TOps::Mul(t, p), q), half));
+    }
+    for (; i < n; ++i)
+        x[i] = RationalSigmoid(x[i]);
+}
+
+template <typename TOps, size_t FixedSize = 0>
+TVectorKernels<typename TOps::TScalar> CreateKernels() {
+    TVectorKernels<typename TOps::TScalar> kernels;
+    kernels.FixedSize = FixedSize;
+    kernels.Dot = &Dot<TOps, FixedSize>;
+    kernels.Axpy = &Axpy<TOps, FixedSize>;
+    kernels.Scale = &Scale<TOps, FixedSize>;
+    kernels.AxpyPair = &AxpyPair<TOps, FixedSize>;
+    // Tiles already keep their loops busy, fully unrolled ones only grow the code and run slower
+    kernels.DotMatrix = &DotMatrix<TOps, 0>;
+    kernels.AxpyMatrix = &AxpyMatrix<TOps, 0>;
+    kernels.Sigmoid = &Sigmoid<TOps>;
+    return kernels;
+}
+
+// Generic kernels first, then kernels for every specialized dimension
+template <typename TOps>
+std::vector<TVectorKernels<typename TOps::TScalar>> CreateKernelsSet() {
+    static_assert(sizeof(SPECIALIZED_DIMENSIONS) / sizeof(SPECIALIZED_DIMENSIONS[0]) == 4, "Update CreateKernelsSet.");
+    return {
+        CreateKernels<TOps>(),
+        CreateKernels<TOps, SPECIALIZED_DIMENSIONS[0]>(),
+        CreateKernels<TOps, SPECIALIZED_DIMENSIONS[1]>(),
+        CreateKernels<TOps, SPECIALIZED_DIMENSIONS[2]>(),
+        CreateKernels<TOps, SPECIALIZED_DIMENSIONS[3]>()
+    };
+}
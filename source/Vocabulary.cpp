@@ -1,17 +1,23 @@
 #include "Vocabulary.h"
+#include "BinaryModel.h"
+#include "System.h"
+#include "Tokenizer.h"
 
 #include <string>
 #include <vector>
 #include <algorithm>
 #include <limits>
 #include <memory>
+#include <cstdint>
+#include <cmath>
+#include <iterator>
+#include <functional>
 
 using namespace std;
 
 string NormalizeWord(const string& word) {
     string buf;
-    buf.resize(word.size());
-    transform(word.begin(), word.end(), buf.begin(), ::tolower);
+    AssignNormalizedWord(word.data(), word.data() + word.size(), buf);
     return buf;
 }
 
@@ -86,6 +92,37 @@ void TVocabulary::BuildHuffmanTree() {
             vocabulary[i]->Point[k - b] = point[b] - vocabulary.size();
         }
     }
+
+    // Last point of a word is the word itself and isn't an inner node, it isn't packed
+    HuffmanTable.Offsets.resize(IndexCounter + 1);
+    HuffmanTable.Lengths.assign(IndexCounter, 0);
+    for (const auto& word : vocabulary)
+        HuffmanTable.Lengths[word->Index] = word->Code.size();
+    HuffmanTable.Offsets[0] = 0;
+    for (size_t i = 0; i < IndexCounter; ++i)
+        HuffmanTable.Offsets[i + 1] = HuffmanTable.Offsets[i] + HuffmanTable.Lengths[i];
+    HuffmanTable.Codes.resize(HuffmanTable.Offsets.back());
+    HuffmanTable.Points.resize(HuffmanTable.Offsets.back());
+    for (const auto& word : vocabulary) {
+        size_t offset = HuffmanTable.Offsets[word->Index];
+        for (size_t d = 0; d < word->Code.size(); ++d) {
+            HuffmanTable.Codes[offset + d] = word->Code[d];
+            HuffmanTable.Points[offset + d] = word->Point[d];
+        }
+    }
+}
+
+void TVocabulary::BuildKeepThresholds(double sample) {
+    KeepThresholds.assign(IndexCounter, UINT32_MAX);
+    if (sample <= 0)
+        return;
+    double threshold = sample * TrainWordsCount;
+    for (const auto& it : HashMapIdToWord) {
+        double frequency = it.second->Frequency;
+        double keepProbability = (sqrt(frequency / threshold) + 1) * threshold / frequency;
+        if (keepProbability < 1)
+            KeepThresholds[it.first] = static_cast<uint32_t>(keepProbability * 4294967296.0);
+    }
 }
 
 string TWord::CLASS_TAG = "TWord";
@@ -162,6 +199,51 @@ void TVocabulary::Load(ifstream& in) {
         throw runtime_error("TVocabulary::Load - wrong tail.");
 }
 
+void TVocabulary::SaveBinary(TBinaryModelWriter& writer) const {
+    vector<TBinaryWordRecord> records(HashMapIdToWord.size());
+    vector<uint32_t> lookup(records.size());
+    uint64_t offset = 0;
+    for (size_t i = 0; i < records.size(); ++i) {
+        const auto& word = HashMapIdToWord.at(i);
+        records[i].Offset = offset;
+        records[i].Length = word->Word.size();
+        records[i].Frequency = word->Frequency;
+        offset += word->Word.size();
+        lookup[i] = i;
+    }
+    sort(lookup.begin(), lookup.end(), [this](uint32_t a, uint32_t b) {
+        return HashMapIdToWord.at(a)->Word < HashMapIdToWord.at(b)->Word;
+    });
+
+    writer.BeginSection(EBinarySection::Words, sizeof(TBinaryWordRecord), records.size());
+    writer.Write(records.data(), records.size() * sizeof(TBinaryWordRecord));
+    writer.EndSection();
+    writer.BeginSection(EBinarySection::WordsPool);
+    for (size_t i = 0; i < records.size(); ++i) {
+        const auto& word = HashMapIdToWord.at(i)->Word;
+        writer.Write(word.data(), word.size());
+    }
+    writer.EndSection();
+    writer.BeginSection(EBinarySection::WordsLookup, sizeof(uint32_t), lookup.size());
+    writer.Write(lookup.data(), lookup.size() * sizeof(uint32_t));
+    writer.EndSection();
+}
+
+void TVocabulary::LoadBinary(const TBinaryModelReader& reader) {
+    TMappedVocabulary mapped(reader);
+    HashMap.clear();
+    HashMapIdToWord.clear();
+    TrainWordsCount = 0;
+    for (size_t i = 0; i < mapped.GetSize(); ++i) {
+        auto ptr = make_shared<TWord>();
+        mapped.GetWord(i, *ptr);
+        HashMap[ptr->Word] = ptr;
+        HashMapIdToWord[ptr->Index] = ptr;
+        TrainWordsCount += ptr->Frequency;
+    }
+    IndexCounter = mapped.GetSize();
+}
+
 string TDocument::CLASS_TAG = "TDocument";
 
 void TDocument::Save(std::ofstream& out) const {
@@ -180,7 +262,7 @@ void TDocument::Load(std::ifstream& in) {
     in >> Index;
     getline(in, buf);
     getline(in, RawDocument);
-    BuildFromRawDocument(RawDocument);
+    Tag = RawDocument.substr(0, RawDocument.find(' '));
 
     getline(in, buf);
     if (buf != TDocument::CLASS_TAG)
@@ -189,11 +271,69 @@ void TDocument::Load(std::ifstream& in) {
 
 string TDocumentsHolder::CLASS_TAG = "TDocumentsHolder";
 
+void TDocumentsHolder::AddDocuments(vector<shared_ptr<TDocument>>&& docs) {
+    vector<uint32_t> shards(docs.size());
+    ParallelFor(docs.size(), [this, &docs, &shards](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i)
+            shards[i] = GetTagShard(docs[i]->GetTag());
+    });
+    // Every thread fills its own tag shards in document order
+    vector<uint8_t> inserted(docs.size(), 0);
+    vector<size_t> duplicates(DocTagToIndex.size(), docs.size());
+    ParallelFor(DocTagToIndex.size(), [this, &docs, &shards, &inserted, &duplicates](size_t shardBegin, size_t shardEnd) {
+        for (size_t i = 0; i < docs.size(); ++i) {
+            if (shards[i] < shardBegin || shards[i] >= shardEnd)
+                continue;
+            if (DocTagToIndex[shards[i]].emplace(docs[i]->GetTag(), docs[i]->GetIndex()).second)
+                inserted[i] = 1;
+            else if (duplicates[shards[i]] == docs.size())
+                duplicates[shards[i]] = i;
+        }
+    });
+    size_t duplicate = *min_element(duplicates.begin(), duplicates.end());
+    if (duplicate != docs.size()) {
+        // Tags added by this call are removed, so the holder is unchanged as after a failed AddDocument
+        ParallelFor(DocTagToIndex.size(), [this, &docs, &shards, &inserted](size_t shardBegin, size_t shardEnd) {
+            for (size_t i = 0; i < docs.size(); ++i) {
+                if (inserted[i] && shards[i] >= shardBegin && shards[i] < shardEnd)
+                    DocTagToIndex[shards[i]].erase(docs[i]->GetTag());
+            }
+        });
+        throw runtime_error("There are several documents with same tag <" + docs[duplicate]->GetTag() + ">");
+    }
+    Documents.insert(Documents.end(), make_move_iterator(docs.begin()), make_move_iterator(docs.end()));
+}
+
+uint64_t TDocumentsHolder::GetRawDocumentLength(unsigned int docIndex) const {
+    return SourceFilename.empty() ? Documents[docIndex]->GetRawDocument().size() : Sources[docIndex].Length;
+}
+
+template <typename Func>
+void TDocumentsHolder::ForEachRawDocument(Func func) const {
+    if (SourceFilename.empty()) {
+        for (const auto& doc : Documents)
+            func(*doc);
+        return;
+    }
+    ifstream in(SourceFilename, ios::binary);
+    if (!in.is_open())
+        throw runtime_error("Cannot open file <" + SourceFilename + ">.");
+    string raw;
+    for (size_t i = 0; i < Documents.size(); ++i) {
+        raw.resize(Sources[i].Length);
+        in.seekg(Sources[i].Offset);
+        if (!in.read(&raw[0], raw.size()) || raw.substr(0, raw.find(' ')) != Documents[i]->GetTag())
+            throw runtime_error("TDocumentsHolder - dataset file <" + SourceFilename + "> was changed.");
+        func(TDocument(raw, i));
+    }
+}
+
 void TDocumentsHolder::Save(std::ofstream& out) const {
     out << TDocumentsHolder::CLASS_TAG << endl;
     out << Documents.size() << endl;
-    for (const auto& doc : Documents)
-        doc->Save(out);
+    ForEachRawDocument([&out](const TDocument& doc) {
+        doc.Save(out);
+    });
     out << TDocumentsHolder::CLASS_TAG << endl;
 }
 
@@ -209,9 +349,48 @@ void TDocumentsHolder::Load(std::ifstream& in) {
         TDocument doc;
         doc.Load(in);
         Documents.emplace_back(make_shared<TDocument>(doc));
-        DocTagToIndex[doc.GetTag()] = doc.GetIndex();
+        DocTagToIndex[GetTagShard(doc.GetTag())][doc.GetTag()] = doc.GetIndex();
     }
     getline(in, buf);
     if (buf != TDocumentsHolder::CLASS_TAG)
         throw runtime_error("TDocumentsHolder::Load - wrong tail.");
 }
+
+void TDocumentsHolder::SaveBinary(TBinaryModelWriter& writer) const {
+    vector<TBinaryDocRecord> records(Documents.size());
+    vector<uint32_t> lookup(records.size());
+    uint64_t offset = 0;
+    for (size_t i = 0; i < records.size(); ++i) {
+        records[i].Offset = offset;
+        records[i].Length = GetRawDocumentLength(i);
+        records[i].TagLength = Documents[i]->GetTag().size();
+        offset += records[i].Length;
+        lookup[i] = i;
+    }
+    sort(lookup.begin(), lookup.end(), [this](uint32_t a, uint32_t b) {
+        return Documents[a]->GetTag() < Documents[b]->GetTag();
+    });
+
+    writer.BeginSection(EBinarySection::Docs, sizeof(TBinaryDocRecord), records.size());
+    writer.Write(records.data(), records.size() * sizeof(TBinaryDocRecord));
+    writer.EndSection();
+    writer.BeginSection(EBinarySection::DocsPool);
+    ForEachRawDocument([&writer](const TDocument& doc) {
+        writer.Write(doc.GetRawDocument().data(), doc.GetRawDocument().size());
+    });
+    writer.EndSection();
+    writer.BeginSection(EBinarySection::DocsLookup, sizeof(uint32_t), lookup.size());
+    writer.Write(lookup.data(), lookup.size() * sizeof(uint32_t));
+    writer.EndSection();
+}
+
+void TDocumentsHolder::LoadBinary(const TBinaryModelReader& reader) {
+    TMappedDocuments mapped(reader);
+    Documents.clear();
+    for (auto& tags : DocTagToIndex)
+        tags.clear();
+    vector<shared_ptr<TDocument>> docs(mapped.GetSize());
+    for (size_t i = 0; i < docs.size(); ++i)
+        docs[i] = make_shared<TDocument>(mapped.GetRawDocument(i), i);
+    AddDocuments(move(docs));
+}
@@ -8,8 +8,12 @@
 #include <fstream>
 #include <sstream>
 #include <iterator>
-#include <regex>
-#include <iostream>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+class TBinaryModelWriter;
+class TBinaryModelReader;
 
 std::string NormalizeWord(const std::string& word);
 
@@ -53,6 +57,38 @@ private:
     static std::string CLASS_TAG;
 };
 
+/*
+ * Huffman codes and inner node points of all words packed into flat arrays addressed by word index,
+ * so hierarchical softmax reads them without hashing and refcounting. Word i has GetCodeLength(i) codes and
+ * as many points, starting at Offsets[i]: points are inner nodes from the root, codes are branches taken from them.
+ */
+class THuffmanTable {
+public:
+    size_t Size() const {
+        return Lengths.size();
+    }
+
+    unsigned int GetCodeLength(unsigned int wordIndex) const {
+        return Lengths[wordIndex];
+    }
+
+    const uint8_t* GetCodes(unsigned int wordIndex) const {
+        return Codes.data() + Offsets[wordIndex];
+    }
+
+    const uint32_t* GetPoints(unsigned int wordIndex) const {
+        return Points.data() + Offsets[wordIndex];
+    }
+
+private:
+    friend class TVocabulary;
+
+    std::vector<size_t> Offsets;
+    std::vector<uint8_t> Lengths;
+    std::vector<uint8_t> Codes;
+    std::vector<uint32_t> Points;
+};
+
 class TVocabulary {
 public:
     TVocabulary()
@@ -62,18 +98,37 @@ public:
 
     ~TVocabulary() {};
 
-    void AddWord(const std::string& word) {
-        auto normWord = NormalizeWord(word);
+    // Returns index of the word
+    unsigned int AddWord(const std::string& word) {
+        return AddNormalizedWord(NormalizeWord(word), 1);
+    }
+
+    // Word counted frequency times, new words get the next index
+    unsigned int AddNormalizedWord(const std::string& normWord, unsigned int frequency) {
         auto wordIt = HashMap.find(normWord);
+        TrainWordsCount += frequency;
         if (wordIt != HashMap.end()) {
-            wordIt->second->Frequency += 1;
-        } else {
-            std::shared_ptr<TWord> ptr = std::make_shared<TWord>(normWord, IndexCounter);
-            HashMap[normWord] = ptr;
-            HashMapIdToWord[IndexCounter] = ptr;
-            IndexCounter += 1;
+            wordIt->second->Frequency += frequency;
+            return wordIt->second->Index;
         }
-        TrainWordsCount += 1; // TODO: maybe wrong here
+        std::shared_ptr<TWord> ptr = std::make_shared<TWord>(normWord, IndexCounter);
+        ptr->Frequency = frequency;
+        HashMap[normWord] = ptr;
+        HashMapIdToWord[IndexCounter] = ptr;
+        return IndexCounter++;
+    }
+
+    // Word is normalized like in AddWord
+    bool GetWordIndex(const std::string& word, unsigned int& index) const {
+        return GetNormalizedWordIndex(NormalizeWord(word), index);
+    }
+
+    bool GetNormalizedWordIndex(const std::string& normWord, unsigned int& index) const {
+        auto wordIt = HashMap.find(normWord);
+        if (wordIt == HashMap.end())
+            return false;
+        index = wordIt->second->Index;
+        return true;
     }
 
     bool GetWord(const std::string& word, std::shared_ptr<TWord>& res) const {
@@ -112,7 +167,20 @@ public:
         return false;
     }
 
-    unsigned int GetTrainWordsCount() const {
+    // Filled by BuildHuffmanTree, empty for loaded vocabularies
+    const THuffmanTable& GetHuffmanTable() const {
+        return HuffmanTable;
+    }
+
+    // Word2vec subsampling as fixed point thresholds indexed by word index:
+    // a token is kept when a uniform 32 bit random number is not greater than the threshold of its word
+    void BuildKeepThresholds(double sample);
+    // Empty until BuildKeepThresholds
+    const std::vector<uint32_t>& GetKeepThresholds() const {
+        return KeepThresholds;
+    }
+
+    unsigned long long GetTrainWordsCount() const {
         return TrainWordsCount;
     }
 
@@ -140,11 +208,16 @@ public:
     void BuildHuffmanTree();
     void Save(std::ofstream& out) const;
     void Load(std::ifstream& in);
+    void SaveBinary(TBinaryModelWriter& writer) const;
+    // Words and frequencies only, Huffman tree should be built again
+    void LoadBinary(const TBinaryModelReader& reader);
 private:
     std::unordered_map<std::string, std::shared_ptr<TWord>> HashMap;
     std::unordered_map<unsigned int, std::shared_ptr<TWord>> HashMapIdToWord;
     unsigned int IndexCounter;
-    unsigned int TrainWordsCount;
+    unsigned long long TrainWordsCount;
+    THuffmanTable HuffmanTable;
+    std::vector<uint32_t> KeepThresholds;
 private:
     static std::string CLASS_TAG;
 };
@@ -153,16 +226,12 @@ class TDocument {
 public:
     TDocument() {}
 
+    // Tag is the first space separated field, words of document are tokenized into TCorpus
     TDocument(const std::string input, unsigned int index)
-        : RawDocument(input)
+        : Tag(input.substr(0, input.find(' ')))
+        , RawDocument(input)
         , Index(index)
-    {
-        BuildFromRawDocument(input);
-    }
-
-    const std::vector<std::string>& GetWords() const {
-        return Words;
-    }
+    {}
 
     const std::string& GetTag() const {
         return Tag;
@@ -179,15 +248,6 @@ public:
     void Save(std::ofstream& out) const;
     void Load(std::ifstream& in);
 private:
-    void BuildFromRawDocument(const std::string& input) {
-        std::regex reg("\\w+");
-        size_t firstSpace = input.find(" ");
-		Tag = std::string(input.begin(), input.begin() + firstSpace);
-        for(std::sregex_iterator it(input.begin() + firstSpace + 1, input.end(), reg), it_end; it != it_end; ++it)
-            Words.push_back((*it)[0]);
-    }
-
-    std::vector<std::string> Words;
     std::string Tag;
     std::string RawDocument;
     unsigned int Index;
@@ -195,58 +255,46 @@ private:
     static std::string CLASS_TAG;
 };
 
+// Place of a raw document in dataset file: a line without its line break
+struct TDocumentSource {
+    uint64_t Offset;
+    uint64_t Length;
+};
+
 class TDocumentsHolder {
 public:
-    TDocumentsHolder() {}
-
-    TDocumentsHolder(const std::string filename) {
-        std::ifstream file(filename);
-        std::string line;
-        while(std::getline(file, line)) {
-            unsigned int docIndex = Documents.size();
-            Documents.emplace_back(std::make_shared<TDocument>(line, docIndex));
-
-            const auto& docTag = Documents.back()->GetTag();
-            if (DocTagToIndex.count(docTag))
-                throw std::runtime_error("There are several documents with same tag");
-
-            DocTagToIndex[docTag] = docIndex;
-        }
+    TDocumentsHolder()
+        : DocTagToIndex(DOCUMENT_TAG_SHARD_NUMBER)
+    {}
 
-        if (Documents.empty())
-            throw std::runtime_error("No documents in dataset file");
+    // Raw documents are left in dataset file, they are read from it again when holder is saved.
+    // Documents added this way keep their tag only.
+    void SetSourceFilename(const std::string& filename) {
+        SourceFilename = filename;
     }
 
-    TDocumentsHolder(const std::vector<std::shared_ptr<TDocument>>& docVector)
-        : Documents(docVector)
-    {}
+    // Documents with tags only, sources are in the same order
+    void AddSourceDocuments(std::vector<std::shared_ptr<TDocument>>&& docs, const std::vector<TDocumentSource>& sources) {
+        AddDocuments(std::move(docs));
+        Sources.insert(Sources.end(), sources.begin(), sources.end());
+    }
 
-    std::vector<TDocumentsHolder> SplitDocuments(unsigned int parts) const {
-        std::vector<TDocumentsHolder> docsHolders;
-        unsigned int numDocsInPart = Documents.size() / parts + 1;
-        auto it = Documents.begin();
-        for (int i = 0, iMax = static_cast<int>(Documents.size()) - numDocsInPart;
-                i < iMax;
-                i += numDocsInPart, it += numDocsInPart
-        ) {
-            std::vector<std::shared_ptr<TDocument>> tmpVector(it, it + numDocsInPart);
-            docsHolders.emplace_back(tmpVector);
-        }
-        std::vector<std::shared_ptr<TDocument>> tmpVector(it, Documents.end());
-        docsHolders.emplace_back(tmpVector);
-        return docsHolders;
+    const TDocumentSource& GetSource(unsigned int docIndex) const {
+        return Sources[docIndex];
     }
 
-    TVocabulary CreateWordsVocabulary() const {
-        TVocabulary vocabulary;
-        for (const auto& doc : Documents) {
-            for (const auto& word : doc->GetWords())
-                vocabulary.AddWord(word);
-        }
-        vocabulary.BuildHuffmanTree();
-        return vocabulary;
+    void AddDocument(const std::shared_ptr<TDocument>& doc) {
+        auto& tags = DocTagToIndex[GetTagShard(doc->GetTag())];
+        if (tags.count(doc->GetTag()))
+            throw std::runtime_error("There are several documents with same tag <" + doc->GetTag() + ">");
+        tags[doc->GetTag()] = doc->GetIndex();
+        Documents.push_back(doc);
     }
 
+    // Same as AddDocument for every document in order, tag shards are filled in parallel.
+    // The first document in order which repeats a tag is reported, and then no document is added.
+    void AddDocuments(std::vector<std::shared_ptr<TDocument>>&& docs);
+
     unsigned int GetSize() const {
         return Documents.size();
     }
@@ -262,10 +310,12 @@ public:
     }
 
     bool GetDocument(const std::string& docTag, TDocument& docRes) const {
-        if (!DocTagToIndex.count(docTag))
+        const auto& tags = DocTagToIndex[GetTagShard(docTag)];
+        auto tagIt = tags.find(docTag);
+        if (tagIt == tags.end())
             return false;
 
-        const auto& docPtr = GetDocument(DocTagToIndex.at(docTag));
+        const auto& docPtr = GetDocument(tagIt->second);
         docRes = *docPtr;
         return true;
     }
@@ -277,9 +327,22 @@ public:
 
     void Save(std::ofstream& out) const;
     void Load(std::ifstream& in);
+    void SaveBinary(TBinaryModelWriter& writer) const;
+    void LoadBinary(const TBinaryModelReader& reader);
+private:
+    size_t GetTagShard(const std::string& tag) const {
+        return std::hash<std::string>()(tag) % DocTagToIndex.size();
+    }
+    uint64_t GetRawDocumentLength(unsigned int docIndex) const;
+    // Calls func(doc) in index order with raw documents, they are read from source file when it is set
+    template <typename Func>
+    void ForEachRawDocument(Func func) const;
 private:
 	std::vector<std::shared_ptr<TDocument>> Documents;
-    std::unordered_map<std::string, unsigned int> DocTagToIndex;
+    // Sharded by tag hash
+    std::vector<std::unordered_map<std::string, unsigned int>> DocTagToIndex;
+    std::string SourceFilename;
+    std::vector<TDocumentSource> Sources;
 
     static std::string CLASS_TAG;
 };
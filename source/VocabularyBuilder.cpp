@@ -0,0 +1,96 @@
+#include "VocabularyBuilder.h"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+void TVocabularyBuilder::TShard::ParseLine(const char* begin, const char* end, bool keepTokens) {
+    uint64_t tokenCount = LineEnds.empty() ? 0 : LineEnds.back();
+    ForEachDocumentWord(begin, end, [this, keepTokens, &tokenCount](const char* wordBegin, const char* wordEnd) {
+        // Same normalization as NormalizeWord without a new string per token
+        AssignNormalizedWord(wordBegin, wordEnd, Normalized);
+        auto it = Ids.find(Normalized);
+        if (it == Ids.end()) {
+            it = Ids.emplace(Normalized, static_cast<uint32_t>(Words.size())).first;
+            Words.push_back(&it->first);
+            Counts.push_back(0);
+        }
+        ++Counts[it->second];
+        ++tokenCount;
+        if (keepTokens)
+            Tokens.push_back(it->second);
+    });
+    LineEnds.push_back(tokenCount);
+}
+
+void TVocabularyBuilder::Parse(const char* text, size_t size, size_t partNum) {
+    size_t shardNum = partNum > 0 ? partNum
+        : max<size_t>(1, min<size_t>(thread::hardware_concurrency(), size / DATASET_MIN_PART_SIZE));
+    Shards.assign(shardNum, TShard());
+    // Part boundaries are moved to the next line start, so a part may be empty
+    for (size_t s = 0; s < shardNum; ++s) {
+        size_t end = size * (s + 1) / shardNum;
+        if (s + 1 < shardNum) {
+            const char* lineBreak = static_cast<const char*>(memchr(text + end, '\n', size - end));
+            end = lineBreak ? lineBreak - text + 1 : size;
+        }
+        Shards[s].Begin = s == 0 ? 0 : Shards[s - 1].End;
+        Shards[s].End = max(end, Shards[s].Begin);
+    }
+
+    ParallelFor(shardNum, [this, text](size_t shardBegin, size_t shardEnd) {
+        for (size_t s = shardBegin; s < shardEnd; ++s) {
+            TShard& shard = Shards[s];
+            const char* position = text + shard.Begin;
+            const char* end = text + shard.End;
+            while (position < end) {
+                const char* lineBreak = static_cast<const char*>(memchr(position, '\n', end - position));
+                const char* lineEnd = lineBreak ? lineBreak : end;
+                TDocumentSource source;
+                source.Offset = position - text;
+                source.Length = lineEnd - position;
+                shard.Lines.push_back(source);
+                shard.ParseLine(position, lineEnd, KeepTokens);
+                position = lineEnd + 1;
+            }
+        }
+    });
+
+    LineNum = 0;
+    for (auto& shard : Shards) {
+        shard.FirstLine = LineNum;
+        LineNum += shard.Lines.size();
+    }
+}
+
+void TVocabularyBuilder::Merge(TVocabulary& vocabulary) {
+    // Words new to vocabulary come in order of first occurrence inside of a shard, shards are in text order
+    for (auto& shard : Shards) {
+        shard.Indexes.resize(shard.Words.size());
+        for (size_t i = 0; i < shard.Words.size(); ++i)
+            shard.Indexes[i] = vocabulary.AddNormalizedWord(*shard.Words[i], shard.Counts[i]);
+    }
+}
+
+void TVocabularyBuilder::AppendTokens(vector<uint32_t>& tokens, vector<uint64_t>& offsets) const {
+    vector<size_t> shardBegins(Shards.size() + 1, tokens.size());
+    for (size_t s = 0; s < Shards.size(); ++s)
+        shardBegins[s + 1] = shardBegins[s] + Shards[s].Tokens.size();
+    tokens.resize(shardBegins.back());
+    for (size_t s = 0; s < Shards.size(); ++s) {
+        for (uint64_t end : Shards[s].LineEnds)
+            offsets.push_back(shardBegins[s] + end);
+    }
+    ParallelFor(Shards.size(), [this, &tokens, &shardBegins](size_t shardBegin, size_t shardEnd) {
+        for (size_t s = shardBegin; s < shardEnd; ++s) {
+            const TShard& shard = Shards[s];
+            uint32_t* out = tokens.data() + shardBegins[s];
+            for (size_t i = 0; i < shard.Tokens.size(); ++i)
+                out[i] = shard.Indexes[shard.Tokens[i]];
+        }
+    });
+}
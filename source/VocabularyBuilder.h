@@ -0,0 +1,81 @@
+#pragma once
+#include "Corpus.h"
+#include "Vocabulary.h"
+#include "System.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+/*
+ * Parses dataset text on all hardware threads: text is split into parts at line breaks, every thread
+ * finds lines of its part and tokenizes them into its own shard table with local word ids.
+ * Merge adds shard words to vocabulary shard by shard in order of their first occurrence, so vocabulary
+ * gets the same indexes, frequencies and Huffman tree as AddWord called for every token of the text in order.
+ * Lines are numbered in text order, every '\n' ends a line and the last line may have no line break.
+ */
+class TVocabularyBuilder {
+public:
+    // Tokens are needed to build corpus, counts and lines are enough for vocabulary
+    explicit TVocabularyBuilder(bool keepTokens)
+        : KeepTokens(keepTokens)
+        , LineNum(0)
+    {}
+
+    // Text should live until the builder is used. Text is split into partNum parts,
+    // 0 means one part per hardware thread but parts of at least DATASET_MIN_PART_SIZE bytes.
+    void Parse(const char* text, size_t size, size_t partNum = 0);
+    // Adds words of parsed text to vocabulary
+    void Merge(TVocabulary& vocabulary);
+
+    size_t GetLineCount() const {
+        return LineNum;
+    }
+
+    // Calls func(lineIndex, source, tokenCount) for every parsed line, lines of a part are given in order
+    // by one of several threads. Source is the place of line in text.
+    template <typename Func>
+    void ParallelForEachLine(Func func) const {
+        ParallelFor(Shards.size(), [this, &func](size_t shardBegin, size_t shardEnd) {
+            for (size_t s = shardBegin; s < shardEnd; ++s) {
+                const TShard& shard = Shards[s];
+                for (size_t i = 0; i < shard.Lines.size(); ++i) {
+                    uint64_t tokenBegin = i == 0 ? 0 : shard.LineEnds[i - 1];
+                    func(shard.FirstLine + i, shard.Lines[i], shard.LineEnds[i] - tokenBegin);
+                }
+            }
+        });
+    }
+
+    // After Merge: vocabulary indexes of all tokens are appended to tokens
+    // and ends of lines in tokens are appended to offsets
+    void AppendTokens(std::vector<uint32_t>& tokens, std::vector<uint64_t>& offsets) const;
+
+private:
+    struct TShard {
+        // Text part [Begin, End)
+        size_t Begin;
+        size_t End;
+        size_t FirstLine;
+        std::unordered_map<std::string, uint32_t> Ids;
+        std::vector<const std::string*> Words;
+        std::vector<unsigned int> Counts;
+        std::vector<TDocumentSource> Lines;
+        // Token count of lines up to and including every line
+        std::vector<uint64_t> LineEnds;
+        // Local word ids of all tokens, empty when tokens aren't kept
+        std::vector<uint32_t> Tokens;
+        // Vocabulary index of every local id, filled by Merge
+        std::vector<uint32_t> Indexes;
+        // Lowercase copy of the current word, reused for every token
+        std::string Normalized;
+
+        void ParseLine(const char* begin, const char* end, bool keepTokens);
+    };
+
+private:
+    bool KeepTokens;
+    std::vector<TShard> Shards;
+    size_t LineNum;
+};
@@ -1,10 +1,19 @@
 #include "Doc2Vec.h"
 #include "Algorithm.h"
+#include "VectorKernels.h"
+#include "Sigmoid.h"
+
+#include <cstring>
 
 using namespace std;
 
 TDoc2Vec LoadModel(const string& filename) {
     TDoc2Vec model;
+    if (IsBinaryModel(filename)) {
+        model.LoadBinary(filename);
+        return model;
+    }
+
     ifstream ifs(filename);
 
     if (ifs.is_open()) {
@@ -27,6 +36,16 @@ void SaveModel(const TDoc2Vec& model, const string& filename) {
     }
 }
 
+void SaveBinaryModel(const TDoc2Vec& model, const string& filename) {
+    ofstream ofs(filename, ios::binary);
+    if (ofs.is_open()) {
+        model.SaveBinary(ofs);
+        ofs.close();
+    } else {
+        throw runtime_error("Cannot open file <" + filename + ">.");
+    }
+}
+
 char* GetCmdOption(char** begin, char** end, const string& option) {
     char** itr = find(begin, end, option);
     if (itr != end && ++itr != end)
@@ -81,6 +100,21 @@ bool GetAndSaveOption<double>(char** begin, char** end, const string& option, do
     return true;
 }
 
+bool GetQuantizationOption(char** begin, char** end, EQuantization& quantization) {
+    char* quantizationStr = GetCmdOption(begin, end, QUANTIZE_OPTION);
+    if (quantizationStr && !ParseQuantization(quantizationStr, quantization)) {
+        cerr << "Option " << QUANTIZE_OPTION << " should be one of 'none', 'int8', 'fp16'." << endl;
+        return false;
+    }
+    return true;
+}
+
+void BuildDocsIndex(TDoc2Vec& model, unsigned int subspaceNum) {
+    model.BuildDocsIndex(subspaceNum);
+    if (model.GetDocsIndex())
+        PrintDocsIndexRecall(model);
+}
+
 int Train(int argc, char* argv[]) {
     char** begin = argv + 2;
     char** end = argv + argc;
@@ -92,6 +126,16 @@ int Train(int argc, char* argv[]) {
         return FAIL_RETURN;
     }
     Spec.TrainFilename = datasetFile;
+    char* corpusCacheFile = GetCmdOption(begin, end, CORPUS_CACHE_OPTION);
+    if (corpusCacheFile)
+        Spec.CorpusCacheFilename = corpusCacheFile;
+    if (CmdOptionExists(begin, end, STREAM_OPTION)) {
+        if (corpusCacheFile) {
+            cerr << "Option " << STREAM_OPTION << " doesn't work with " << CORPUS_CACHE_OPTION << "." << endl;
+            return FAIL_RETURN;
+        }
+        Spec.Stream = true;
+    }
 
     if (!(GetAndSaveOption(begin, end, DIMENSION_OPTION, Spec.DimensionSize)
         && GetAndSaveOption(begin, end, ITER_OPTION, Spec.IterationNumber)
@@ -102,10 +146,39 @@ int Train(int argc, char* argv[]) {
     ))
         return FAIL_RETURN;
 
+    char* precisionStr = GetCmdOption(begin, end, PRECISION_OPTION);
+    if (precisionStr && !ParsePrecision(precisionStr, Spec.Precision)) {
+        cerr << "Option " << PRECISION_OPTION << " should be either 'float' or 'double'." << endl;
+        return FAIL_RETURN;
+    }
+
     if (CmdOptionExists(begin, end, HS_OPTION))
         Spec.HierarchicalSoftmax = true;
     if (CmdOptionExists(begin, end, NO_CBOW_OPTION))
         Spec.CBOW = false;
+    if (CmdOptionExists(begin, end, HOGWILD_OPTION))
+        Spec.Hogwild = true;
+    if (CmdOptionExists(begin, end, PIN_THREADS_OPTION))
+        Spec.PinThreads = true;
+    if (CmdOptionExists(begin, end, BATCH_NEGATIVES_OPTION)) {
+        if (Spec.CBOW || Spec.HierarchicalSoftmax || Spec.NegativeSampleNum <= 0) {
+            cerr << "Option " << BATCH_NEGATIVES_OPTION << " works only with " << NO_CBOW_OPTION << " and negative sampling without " << HS_OPTION << "." << endl;
+            return FAIL_RETURN;
+        }
+        Spec.BatchNegatives = true;
+    }
+
+    char* hugePagesStr = GetCmdOption(begin, end, HUGE_PAGES_OPTION);
+    if (hugePagesStr && !ParseHugePages(hugePagesStr, Spec.HugePages)) {
+        cerr << "Option " << HUGE_PAGES_OPTION << " should be one of 'none', 'thp', 'explicit'." << endl;
+        return FAIL_RETURN;
+    }
+
+    char* sigmoidStr = GetCmdOption(begin, end, SIGMOID_OPTION);
+    if (sigmoidStr && !ParseSigmoid(sigmoidStr, Spec.Sigmoid)) {
+        cerr << "Option " << SIGMOID_OPTION << " should be either 'table' or 'rational'." << endl;
+        return FAIL_RETURN;
+    }
 
     char* resStr = GetCmdOption(begin, end, ALPHA_OPTION);
     if (resStr) {
@@ -118,6 +191,13 @@ int Train(int argc, char* argv[]) {
             Spec.Alpha = make_shared<TAlpha>(resNum);
     }
 
+    EQuantization quantization = EQuantization::None;
+    unsigned int pqSubspaceNum = 0;
+    if (!GetQuantizationOption(begin, end, quantization)
+        || !GetAndSaveOption(begin, end, PQ_OPTION, pqSubspaceNum))
+        return FAIL_RETURN;
+
+    cout << "Vector kernels: " << SimdToString(GetSelectedSimd()) << endl;
     TDoc2Vec model(Spec);
     model.Train();
 
@@ -125,6 +205,45 @@ int Train(int argc, char* argv[]) {
     if (filenameSave)
         SaveModel(model, filenameSave);
 
+    char* filenameSaveBinary = GetCmdOption(begin, end, SAVE_BINARY_OPTION);
+    if (filenameSaveBinary) {
+        // Binary model keeps only normalized word and document vectors, text one is already saved
+        model.FinishTraining();
+        model.Quantize(quantization);
+        BuildDocsIndex(model, pqSubspaceNum);
+        SaveBinaryModel(model, filenameSaveBinary);
+    }
+
+    return SUCCESS_RETURN;
+}
+
+int Convert(int argc, char* argv[]) {
+    char** begin = argv + 2;
+    char** end = argv + argc;
+
+    char* filename = GetCmdOption(begin, end, LOAD_OPTION);
+    if (!filename) {
+        cerr << "Need to specify saved model filename with option " << LOAD_OPTION << "." << endl;
+        return FAIL_RETURN;
+    }
+
+    char* filenameSaveBinary = GetCmdOption(begin, end, SAVE_BINARY_OPTION);
+    if (!filenameSaveBinary) {
+        cerr << "Need to specify binary model filename with option " << SAVE_BINARY_OPTION << "." << endl;
+        return FAIL_RETURN;
+    }
+
+    EQuantization quantization = EQuantization::None;
+    unsigned int pqSubspaceNum = 0;
+    if (!GetQuantizationOption(begin, end, quantization)
+        || !GetAndSaveOption(begin, end, PQ_OPTION, pqSubspaceNum))
+        return FAIL_RETURN;
+
+    TDoc2Vec model = LoadModel(filename);
+    model.FinishTraining();
+    model.Quantize(quantization);
+    BuildDocsIndex(model, pqSubspaceNum);
+    SaveBinaryModel(model, filenameSaveBinary);
     return SUCCESS_RETURN;
 }
 
@@ -158,12 +277,29 @@ int Similar(int argc, char* argv[]) {
         return FAIL_RETURN;
     }
 
+    unsigned int rerankNum = DEFAULT_RERANK_NUMBER;
+    if (!GetAndSaveOption(begin, end, RERANK_OPTION, rerankNum, /*enableZero*/ true))
+        return FAIL_RETURN;
+
     TDoc2Vec model = LoadModel(filename);
+    if (CmdOptionExists(begin, end, QUANTIZE_OPTION)) {
+        EQuantization quantization = EQuantization::None;
+        if (!GetQuantizationOption(begin, end, quantization))
+            return FAIL_RETURN;
+        model.Quantize(quantization);
+    }
+    if (CmdOptionExists(begin, end, PQ_OPTION)) {
+        unsigned int pqSubspaceNum = 0;
+        if (!GetAndSaveOption(begin, end, PQ_OPTION, pqSubspaceNum, /*enableZero*/ true))
+            return FAIL_RETURN;
+        model.BuildDocsIndex(pqSubspaceNum);
+    }
+
     for (const auto& word : words)
-        FindAndPrintSimilarWords(model, word, num);
+        FindAndPrintSimilarWords(model, word, num, rerankNum);
 
     for (const auto& doc : docs)
-        FindAndPrintSimilarDocs(model, doc, num);
+        FindAndPrintSimilarDocs(model, doc, num, rerankNum);
 
     return SUCCESS_RETURN;
 }
@@ -196,23 +332,40 @@ int Vector(int argc, char* argv[]) {
     return SUCCESS_RETURN;
 }
 
+int Bench() {
+    cout << "Vector kernels: " << SimdToString(GetSelectedSimd()) << endl;
+    PrintSigmoidReport();
+    return SUCCESS_RETURN;
+}
+
 void PrintHelp() {
     cout << "Doc2Vec tool" << endl
-        << "There are 3 modes - 'train', 'similar', 'vector'." << endl << endl
+        << "There are 5 modes - 'train', 'similar', 'vector', 'convert', 'bench'." << endl << endl
         << "'train' mode" << endl
         << "This mode is for train doc2vec model from dataset." << endl
         << "Posible options:" << endl
         << '\t' << DATA_OPTION << " <filename> -- filename of dataset. Required option." << endl
-        << '\t' << ALPHA_OPTION << " <num> -- initial learning rate. Default value: " << DEFAULT_ALPHA << '.' << endl
+        << '\t' << CORPUS_CACHE_OPTION << " <filename> -- tokenized dataset with its vocabulary, it is read instead of dataset while dataset size and modification time don't change, otherwise it is written." << endl
+        << '\t' << STREAM_OPTION << " -- don't keep dataset in memory: documents are read and tokenized again on every iteration by background threads, memory is bounded by model and a few chunks of " << STREAM_CHUNK_TOKEN_NUMBER << " tokens per thread." << endl
+        << '\t' << ALPHA_OPTION << " <num> -- initial learning rate, it decays linearly with the number of trained words. Default value: " << DEFAULT_ALPHA << '.' << endl
         << '\t' << DIMENSION_OPTION << " <num> -- dimension of word/document vectors. Default value: " << DEFAULT_DIMENSION_SIZE  << '.' << endl
         << '\t' << ITER_OPTION << " <num> -- number of iterations. Default value: " << DEFAULT_ITERATION_NUMBER << '.' << endl
         << '\t' << WINDOW_OPTION  << " <num> -- maximum skip length between words. Default value: " << DEFAULT_WINDOW_SIZE << '.' << endl
         << '\t' << THREAD_OPTION << " <num> -- number of threads. Default value: " << DEFAULT_THREAD_COUNT << '.' << endl
         << '\t' << NS_NUM_OPTION << " <num> -- number negative examples. Default value: " << DEFAULT_NEGATIVE_SAMPLE_NUMBER << '.' << endl
         << '\t' << SAMPLE_OPTION << " <num> -- threshold for occurrence of words. Popular words will be downsampled. Default value: " << DEFAULT_SAMPLE << '.' << endl
+        << '\t' << PRECISION_OPTION << " <float|double> -- precision of network weights. Default value: " << PrecisionToString(DEFAULT_PRECISION) << '.' << endl
         << '\t' << HS_OPTION << " -- use Hierarchical Softmax." << endl
         << '\t' << NO_CBOW_OPTION << " -- use skip-gram model instead CBOW model." << endl
+        << '\t' << HOGWILD_OPTION << " -- update weights without locks (lock-free Hogwild training)." << endl
+        << '\t' << HUGE_PAGES_OPTION << " <none|thp|explicit> -- back network weights with transparent or explicit huge pages. Default value: " << HugePagesToString(DEFAULT_HUGE_PAGES) << '.' << endl
+        << '\t' << BATCH_NEGATIVES_OPTION << " -- skip-gram only, changes the objective: context words and document vector of every window are trained against its central word with negative samples shared by the window." << endl
+        << '\t' << SIGMOID_OPTION << " <table|rational> -- sigmoid of output layer: interpolated table saturated outside [" << -MAX_EXP << ", " << MAX_EXP << "] or branch-free rational approximation evaluated on SIMD lanes in batched mode. Default value: " << SigmoidToString(DEFAULT_SIGMOID) << '.' << endl
+        << '\t' << PIN_THREADS_OPTION << " -- pin training thread i to core i modulo the number of cores." << endl
         << '\t' << SAVE_OPTION << " <filename> -- save model to file." << endl
+        << '\t' << SAVE_BINARY_OPTION << " <filename> -- save model to file in binary format, it is mapped by 'similar' and 'vector' modes without parsing." << endl
+        << '\t' << QUANTIZE_OPTION << " <none|int8|fp16> -- also store quantized normalized vectors in binary model. Default value: none." << endl
+        << '\t' << PQ_OPTION << " <num> -- also store product quantization index of documents with this number of one byte subspace codes in binary model." << endl
         << endl
         << "'similar' mode" << endl
         << "This mode is for find the most similar words/docs in vocabulary/trained documents." << endl
@@ -221,6 +374,9 @@ void PrintHelp() {
         << '\t' << NUM_OPTION << " <num> -- number of similar words/docs to print." << endl
         << '\t' << WORD_OPTION << " <word> -- find similar words to this word." << endl
         << '\t' << DOC_OPTION << " <doc tag> -- find similar documents to document with this tag." << endl
+        << '\t' << QUANTIZE_OPTION << " <none|int8|fp16> -- scan quantized normalized vectors, quantized vectors stored in binary model are used by default, 'none' forces exact search." << endl
+        << '\t' << PQ_OPTION << " <num> -- search documents with product quantization index of this number of subspaces, index stored in binary model is used by default, 0 forces search without it." << endl
+        << '\t' << RERANK_OPTION << " <num> -- rescore this number of best quantized candidates with exact vectors, 0 disables rerank. Default value: " << DEFAULT_RERANK_NUMBER << '.' << endl
         << endl
         << "'vector' mode" << endl
         << "This mode is for print vectors of words/docs for futher usage."
@@ -229,6 +385,20 @@ void PrintHelp() {
         << '\t' << WORD_OPTION << " <word> -- word to print vector." << endl
         << '\t' << DOC_OPTION << " <doc tag> -- document to print vector." << endl
         << endl
+        << "'convert' mode" << endl
+        << "This mode is for convert saved model to binary format." << endl
+        << "Posible options:" << endl
+        << '\t' << LOAD_OPTION << " <filename> -- filename of saved model. Required option." << endl
+        << '\t' << SAVE_BINARY_OPTION << " <filename> -- filename of binary model. Required option." << endl
+        << '\t' << QUANTIZE_OPTION << " <none|int8|fp16> -- also store quantized normalized vectors. Default value: none." << endl
+        << '\t' << PQ_OPTION << " <num> -- also store product quantization index of documents with this number of subspaces, its recall is printed." << endl
+        << endl
+        << "'bench' mode" << endl
+        << "This mode is for measure accuracy and speed of training primitives on the running CPU, it has no options." << endl
+        << endl
+        << "Common options:" << endl
+        << '\t' << SIMD_OPTION << " <auto|scalar|sse2|avx2|avx512> -- instruction set of vector kernels, unsupported one is downgraded to the best available. Default value: " << SimdToString(DEFAULT_SIMD) << '.' << endl
+        << endl
         << "EXAMPLES:" << endl
         << "Print 5 similar words from model 'model.txt' to each word." << endl
         << '\t' << "./doc2vec similar --load model.txt --num 5  --word think --word film --word queen --word strong" << endl
@@ -249,12 +419,28 @@ int main(int argc, char* argv[]) {
         if (strcmp(argv[1], HELP_OPTION.c_str()) == 0) {
             PrintHelp();
             return SUCCESS_RETURN;
-        } else if (strcmp(argv[1], "train") == 0) {
+        }
+
+        char* simdStr = GetCmdOption(argv + 2, argv + argc, SIMD_OPTION);
+        if (simdStr) {
+            ESimd simd;
+            if (!ParseSimd(simdStr, simd)) {
+                cerr << "Option " << SIMD_OPTION << " should be one of 'auto', 'scalar', 'sse2', 'avx2', 'avx512'." << endl;
+                return FAIL_RETURN;
+            }
+            SelectSimd(simd);
+        }
+
+        if (strcmp(argv[1], "train") == 0) {
             return Train(argc, argv);
         } else if (strcmp(argv[1], "similar") == 0) {
             return Similar(argc, argv);
         } else if (strcmp(argv[1], "vector") == 0) {
             return Vector(argc, argv);
+        } else if (strcmp(argv[1], "convert") == 0) {
+            return Convert(argc, argv);
+        } else if (strcmp(argv[1], "bench") == 0) {
+            return Bench();
         } else {
             cerr << "Unknown mode: " << argv[1] << endl;
             PrintHelp();
@@ -0,0 +1,274 @@
+#include "Test.h"
+#include "Corpus.h"
+#include "CorpusStream.h"
+#include "DocumentScheduler.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <regex>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <iterator>
+#include <cstddef>
+
+using namespace std;
+
+namespace {
+    // Documents of different lengths with mixed case and punctuation, tag-only lines included,
+    // and one document longer than chunks of scheduler and stream
+    string CreateDataset(const string& name) {
+        string filename = GetTempPath(name);
+        ofstream out(filename);
+        for (unsigned int doc = 0; doc < 3000; ++doc) {
+            out << "_*" << doc;
+            unsigned int length = doc == 1500 ? STREAM_CHUNK_TOKEN_NUMBER + 10 : (doc * 7) % 41;
+            for (unsigned int i = 0; i < length; ++i)
+                out << (i % 9 == 0 ? " Word" : " w") << (doc * 13 + i * 5) % 500 << (i % 7 == 3 ? "," : "");
+            out << "\n";
+        }
+        return filename;
+    }
+
+    struct TCorpusFixture {
+        explicit TCorpusFixture(const string& filename)
+            : Corpus(make_shared<TCorpus>())
+        {
+            Corpus->Read(filename, Documents, Vocabulary);
+        }
+
+        shared_ptr<TCorpus> Corpus;
+        TDocumentsHolder Documents;
+        TVocabulary Vocabulary;
+    };
+
+    void AssertSameVocabulary(const TVocabulary& a, const TVocabulary& b) {
+        ASSERT_EQUAL(a.GetSize(), b.GetSize());
+        ASSERT_EQUAL(a.GetTrainWordsCount(), b.GetTrainWordsCount());
+        for (auto it = a.Begin(); it != a.End(); ++it) {
+            TWord word;
+            ASSERT(b.GetWord(it->first, word));
+            ASSERT_EQUAL(word.Index, it->second->Index);
+            ASSERT_EQUAL(word.Frequency, it->second->Frequency);
+        }
+    }
+
+    void AssertSameDocuments(const TCorpus& corpus, const TCorpus& expected) {
+        ASSERT_EQUAL(corpus.GetSize(), expected.GetSize());
+        for (unsigned int doc = 0; doc < expected.GetSize(); ++doc) {
+            ASSERT_EQUAL(corpus.GetDocumentLength(doc), expected.GetDocumentLength(doc));
+            for (size_t i = 0; i < expected.GetDocumentLength(doc); ++i)
+                ASSERT_EQUAL(corpus.GetDocument(doc)[i], expected.GetDocument(doc)[i]);
+        }
+    }
+
+    string ReadFile(const string& filename) {
+        ifstream in(filename, ios::binary);
+        return string(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+
+    void WriteFile(const string& filename, const string& data) {
+        ofstream out(filename, ios::binary | ios::trunc);
+        out.write(data.data(), data.size());
+    }
+
+    void AssertChunkTokens(const TDocumentChunk& chunk, const TCorpus& corpus) {
+        for (unsigned int i = 0; i < chunk.DocumentNum; ++i) {
+            unsigned int doc = chunk.FirstDocument + i;
+            ASSERT_EQUAL(chunk.Offsets[i + 1] - chunk.Offsets[i], corpus.GetDocumentLength(doc));
+            for (size_t j = 0; j < corpus.GetDocumentLength(doc); ++j)
+                ASSERT_EQUAL(chunk.Tokens[chunk.Offsets[i] + j], corpus.GetDocument(doc)[j]);
+        }
+    }
+}
+
+// Corpus holds vocabulary indexes of \w+ matches of every raw document, words with uppercase letters included
+TEST(CorpusMatchesRegexTokenization) {
+    string filename = CreateDataset("corpus.txt");
+    TCorpusFixture fixture(filename);
+    ifstream in(filename);
+    string line;
+    const regex wordRegex("\\w+");
+    unsigned int doc = 0;
+    while (getline(in, line)) {
+        size_t firstSpace = line.find(' ');
+        ASSERT_EQUAL(fixture.Documents.GetDocument(doc)->GetTag(), line.substr(0, firstSpace));
+        string words = firstSpace == string::npos ? "" : line.substr(firstSpace + 1);
+        vector<uint32_t> expected;
+        for (sregex_iterator it(words.begin(), words.end(), wordRegex), end; it != end; ++it) {
+            TWord word;
+            ASSERT(fixture.Vocabulary.GetWord(NormalizeWord(it->str()), word));
+            expected.push_back(word.Index);
+        }
+        ASSERT_EQUAL(fixture.Corpus->GetDocumentLength(doc), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i)
+            ASSERT_EQUAL(fixture.Corpus->GetDocument(doc)[i], expected[i]);
+        ++doc;
+    }
+    ASSERT_EQUAL(fixture.Corpus->GetSize(), doc);
+}
+
+TEST(CorpusCacheRoundTrip) {
+    string filename = CreateDataset("cached.txt");
+    string cacheFilename = GetTempPath("cached.cache");
+    TCorpusFixture fixture(filename);
+    fixture.Corpus->SaveCache(cacheFilename, filename, fixture.Documents, fixture.Vocabulary);
+
+    TCorpus cached;
+    TDocumentsHolder documents;
+    TVocabulary vocabulary;
+    ASSERT(cached.LoadCache(cacheFilename, filename, documents, vocabulary));
+    ASSERT(cached.IsLoadedFromCache());
+    AssertSameVocabulary(fixture.Vocabulary, vocabulary);
+    AssertSameDocuments(cached, *fixture.Corpus);
+    ASSERT_EQUAL(cached.GetTokenCount(), fixture.Corpus->GetTokenCount());
+    ASSERT_EQUAL(cached.GetMaxDocumentLength(), fixture.Corpus->GetMaxDocumentLength());
+    ASSERT_EQUAL(documents.GetSize(), fixture.Documents.GetSize());
+    for (unsigned int doc = 0; doc < documents.GetSize(); ++doc) {
+        ASSERT_EQUAL(documents.GetDocument(doc)->GetTag(), fixture.Documents.GetDocument(doc)->GetTag());
+        TDocument found;
+        ASSERT(documents.GetDocument(documents.GetDocument(doc)->GetTag(), found));
+        ASSERT_EQUAL(found.GetIndex(), doc);
+    }
+
+    // Cache of a changed dataset isn't used
+    {
+        ofstream out(filename, ios::app);
+        out << "_*new words\n";
+    }
+    TCorpus stale;
+    TDocumentsHolder staleDocuments;
+    TVocabulary staleVocabulary;
+    ASSERT(!stale.LoadCache(cacheFilename, filename, staleDocuments, staleVocabulary));
+}
+
+// Cache which can't be used, whatever the reason, is rebuilt: LoadCache returns false and changes nothing
+TEST(BrokenCorpusCacheIsNotUsed) {
+    string filename = CreateDataset("broken.txt");
+    string cacheFilename = GetTempPath("broken.cache");
+    TCorpusFixture fixture(filename);
+    fixture.Corpus->SaveCache(cacheFilename, filename, fixture.Documents, fixture.Vocabulary);
+    const string valid = ReadFile(cacheFilename);
+    size_t sourceOffset, tokensOffset;
+    {
+        TBinaryModelReader reader(cacheFilename);
+        sourceOffset = reader.GetSection(EBinarySection::CorpusSource).Offset;
+        tokensOffset = reader.GetSection(EBinarySection::CorpusTokens).Offset;
+    }
+    auto assertNotLoaded = [&]() {
+        TCorpus corpus;
+        TDocumentsHolder documents;
+        TVocabulary vocabulary;
+        ASSERT(!corpus.LoadCache(cacheFilename, filename, documents, vocabulary));
+        ASSERT_EQUAL(documents.GetSize(), 0u);
+        ASSERT_EQUAL(vocabulary.GetSize(), 0u);
+        ASSERT_EQUAL(corpus.GetSize(), 0u);
+    };
+    auto patch = [&](size_t offset, uint32_t value) {
+        string data = valid;
+        data.replace(offset, sizeof(value), reinterpret_cast<const char*>(&value), sizeof(value));
+        WriteFile(cacheFilename, data);
+    };
+
+    // Another binary model version
+    patch(offsetof(TBinaryHeader, Version), BINARY_MODEL_VERSION + 1);
+    assertNotLoaded();
+    // Another tokenizer or corpus version
+    patch(sourceOffset + offsetof(TBinaryCorpusSource, Version), CORPUS_CACHE_VERSION + 1);
+    assertNotLoaded();
+    // Token out of vocabulary
+    patch(tokensOffset, static_cast<uint32_t>(fixture.Vocabulary.GetSize()));
+    assertNotLoaded();
+    // Truncated file
+    WriteFile(cacheFilename, valid.substr(0, valid.size() / 2));
+    assertNotLoaded();
+    // Binary model without corpus sections
+    {
+        ofstream out(cacheFilename, ios::binary | ios::trunc);
+        TBinaryModelWriter writer(out);
+        fixture.Vocabulary.SaveBinary(writer);
+        fixture.Documents.SaveBinary(writer);
+        writer.Finish();
+    }
+    assertNotLoaded();
+
+    WriteFile(cacheFilename, valid);
+    TCorpus cached;
+    TDocumentsHolder documents;
+    TVocabulary vocabulary;
+    ASSERT(cached.LoadCache(cacheFilename, filename, documents, vocabulary));
+    ASSERT_EQUAL(cached.GetTokenCount(), fixture.Corpus->GetTokenCount());
+}
+
+// Threads taking chunks together get every document once per epoch, as the old per-thread document ranges did
+TEST(SchedulerCoversEveryDocument) {
+    TCorpusFixture fixture(CreateDataset("scheduled.txt"));
+    const unsigned int iterationNumber = 3, threadNum = 4;
+    TDocumentScheduler scheduler(fixture.Corpus, iterationNumber);
+    vector<atomic<unsigned int>> counts(fixture.Corpus->GetSize());
+    for (auto& count : counts)
+        count = 0;
+    atomic<bool> wrongChunk(false);
+    vector<thread> threads;
+    for (unsigned int t = 0; t < threadNum; ++t) {
+        threads.emplace_back([&]() {
+            TDocumentChunk chunk;
+            while (scheduler.Next(chunk)) {
+                uint64_t tokens = chunk.Offsets[chunk.DocumentNum] - chunk.Offsets[0];
+                bool isLast = chunk.FirstDocument + chunk.DocumentNum == counts.size();
+                // Chunk ends at the first document which reaches chunk size
+                uint64_t withoutLast = chunk.Offsets[chunk.DocumentNum - 1] - chunk.Offsets[0];
+                if (chunk.DocumentNum == 0 || (!isLast && tokens < SCHEDULER_CHUNK_TOKEN_NUMBER)
+                    || withoutLast >= SCHEDULER_CHUNK_TOKEN_NUMBER)
+                {
+                    wrongChunk = true;
+                }
+                for (unsigned int i = 0; i < chunk.DocumentNum; ++i)
+                    ++counts[chunk.FirstDocument + i];
+                scheduler.Release(chunk);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    ASSERT(!wrongChunk);
+    for (const auto& count : counts)
+        ASSERT_EQUAL(count.load(), iterationNumber);
+    TDocumentChunk chunk;
+    ASSERT(!scheduler.Next(chunk));
+}
+
+// Streamed epochs give the vocabulary, documents and tokens of the in-memory corpus
+TEST(StreamMatchesCorpus) {
+    string filename = CreateDataset("streamed.txt");
+    TCorpusFixture fixture(filename);
+
+    auto stream = make_shared<TCorpusStream>(filename);
+    TDocumentsHolder documents;
+    TVocabulary vocabulary;
+    stream->ReadVocabulary(documents, vocabulary);
+    AssertSameVocabulary(fixture.Vocabulary, vocabulary);
+    ASSERT_EQUAL(documents.GetSize(), fixture.Documents.GetSize());
+    ASSERT_EQUAL(stream->GetTokenCount(), fixture.Corpus->GetTokenCount());
+    ASSERT_EQUAL(stream->GetMaxDocumentLength(), fixture.Corpus->GetMaxDocumentLength());
+
+    const unsigned int iterationNumber = 2;
+    vector<unsigned int> counts(fixture.Corpus->GetSize(), 0);
+    stream->Start(vocabulary, documents, iterationNumber, 2);
+    TDocumentScheduler scheduler(stream);
+    TDocumentChunk chunk;
+    size_t chunkNum = 0;
+    while (scheduler.Next(chunk)) {
+        AssertChunkTokens(chunk, *fixture.Corpus);
+        for (unsigned int i = 0; i < chunk.DocumentNum; ++i)
+            ++counts[chunk.FirstDocument + i];
+        scheduler.Release(chunk);
+        ++chunkNum;
+    }
+    stream->Stop();
+    // The long document ends the first chunk of every epoch, the rest is the second one
+    ASSERT_EQUAL(chunkNum, 2 * iterationNumber);
+    for (unsigned int count : counts)
+        ASSERT_EQUAL(count, iterationNumber);
+}
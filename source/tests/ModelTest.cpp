@@ -0,0 +1,283 @@
+#include "Test.h"
+#include "Doc2Vec.h"
+#include "Algorithm.h"
+#include "BinaryModel.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+namespace {
+    TDoc2Vec LoadTextModel(const string& filename) {
+        ifstream in(filename);
+        ASSERT(in.is_open());
+        TDoc2Vec model;
+        model.Load(in);
+        return model;
+    }
+
+    void SaveTextModel(const TDoc2Vec& model, const string& filename) {
+        ofstream out(filename);
+        ASSERT(out.is_open());
+        model.Save(out);
+    }
+
+    void SaveBinaryModel(const TDoc2Vec& model, const string& filename) {
+        ofstream out(filename, ios::binary);
+        ASSERT(out.is_open());
+        model.SaveBinary(out);
+    }
+
+    // Overwrites bytes of a saved file at offset
+    void PatchFile(const string& filename, uint64_t offset, const void* data, size_t size) {
+        fstream file(filename, ios::in | ios::out | ios::binary);
+        ASSERT(file.is_open());
+        file.seekp(offset);
+        file.write(static_cast<const char*>(data), size);
+    }
+
+    TTrainSpec GetSmallSpec(EPrecision precision) {
+        TTrainSpec spec;
+        spec.DimensionSize = 8;
+        spec.IterationNumber = 2;
+        spec.ThreadCount = 1;
+        spec.Precision = precision;
+        spec.TrainFilename = GetTestDataPath("dataset.txt");
+        return spec;
+    }
+
+    template <size_t N>
+    vector<double> Normalized(const double (&values)[N]) {
+        double len = 0;
+        for (double value : values)
+            len += value * value;
+        len = sqrt(len);
+        vector<double> res;
+        for (double value : values)
+            res.push_back(value / len);
+        return res;
+    }
+
+    // Text model keeps 6 significant digits
+    template <typename T>
+    void AssertLayersNear(const TLayer<T>& a, const TLayer<T>& b) {
+        ASSERT_EQUAL(a.Size(), b.Size());
+        ASSERT_EQUAL(a.Dim(), b.Dim());
+        for (size_t i = 0; i < a.Size(); ++i) {
+            for (size_t j = 0; j < a.Dim(); ++j)
+                ASSERT_NEAR(a.Row(i)[j], b.Row(i)[j], 1e-5);
+        }
+    }
+
+    template <typename T>
+    void AssertLayersEqual(const TLayer<T>& a, const TLayer<T>& b) {
+        ASSERT_EQUAL(a.Size(), b.Size());
+        ASSERT_EQUAL(a.Dim(), b.Dim());
+        for (size_t i = 0; i < a.Size(); ++i) {
+            for (size_t j = 0; j < a.Dim(); ++j)
+                ASSERT_EQUAL(a.Row(i)[j], b.Row(i)[j]);
+        }
+    }
+
+    void AssertSameSimilar(const TDoc2Vec& a, const TDoc2Vec& b) {
+        for (unsigned int doc = 0; doc < 48; doc += 5) {
+            auto docsA = FindSimilarDocs(a, doc, 5), docsB = FindSimilarDocs(b, doc, 5);
+            ASSERT_EQUAL(docsA.size(), docsB.size());
+            for (size_t i = 0; i < docsA.size(); ++i) {
+                ASSERT_EQUAL(docsA[i].Index, docsB[i].Index);
+                ASSERT_NEAR(docsA[i].Similarity, docsB[i].Similarity, 1e-6);
+            }
+        }
+        for (const char* word : {"w0", "w3", "t2_5"}) {
+            auto wordsA = FindSimilarWords(a, word, 5), wordsB = FindSimilarWords(b, word, 5);
+            ASSERT_EQUAL(wordsA.size(), wordsB.size());
+            for (size_t i = 0; i < wordsA.size(); ++i) {
+                ASSERT_EQUAL(wordsA[i].Index, wordsB[i].Index);
+                ASSERT_NEAR(wordsA[i].Similarity, wordsB[i].Similarity, 1e-6);
+            }
+        }
+    }
+
+    template <typename T>
+    void AssertTextRoundTrip(EPrecision precision) {
+        TDoc2Vec model(GetSmallSpec(precision));
+        model.Train();
+        string filename = GetTempPath("round_trip.txt");
+        SaveTextModel(model, filename);
+
+        ifstream in(filename);
+        string header, version;
+        getline(in, header);
+        getline(in, version);
+        ASSERT_EQUAL(version, to_string(TEXT_MODEL_VERSION));
+
+        TDoc2Vec loaded = LoadTextModel(filename);
+        ASSERT(loaded.GetPrecision() == precision);
+        for (const char* word : {"w0", "w3", "t2_5"}) {
+            unsigned int index, loadedIndex;
+            ASSERT(model.GetWordIndex(word, index));
+            ASSERT(loaded.GetWordIndex(word, loadedIndex));
+            ASSERT_EQUAL(index, loadedIndex);
+            TWord wordStruct, loadedWord;
+            ASSERT(model.GetWord(index, wordStruct) && loaded.GetWord(index, loadedWord));
+            ASSERT_EQUAL(wordStruct.Frequency, loadedWord.Frequency);
+        }
+        for (unsigned int doc = 0; doc < 48; ++doc)
+            ASSERT_EQUAL(model.GetDocument(doc)->GetRawDocument(), loaded.GetDocument(doc)->GetRawDocument());
+        AssertLayersNear(model.GetNeuralNetwork<T>().GetWordsNormLayer(), loaded.GetNeuralNetwork<T>().GetWordsNormLayer());
+        AssertLayersNear(model.GetNeuralNetwork<T>().GetDocsNormLayer(), loaded.GetNeuralNetwork<T>().GetDocsNormLayer());
+    }
+}
+
+// Written by the tool before text format versions, float training and lazy normalization:
+// no version line, no precision in spec, normalized layers are stored
+TEST(LoadVersion1TextModel) {
+    TDoc2Vec model = LoadTextModel(GetTestDataPath("baseline_model.txt"));
+    ASSERT(model.GetPrecision() == EPrecision::Double);
+
+    unsigned int docIndex, wordIndex;
+    ASSERT(model.GetDocumentIndex("_*1", docIndex));
+    ASSERT(model.GetWordIndex("w3", wordIndex));
+    TWord word;
+    ASSERT(model.GetWord(wordIndex, word));
+    ASSERT_EQUAL(word.Frequency, 45u);
+
+    // Vectors and similar objects printed by the tool which wrote the model
+    const double docVector[] = {-0.563482, -0.528409, 0.234202, 0.416341, 0.0239371, 0.167868, 0.249642, 0.289841};
+    const double wordVector[] = {-0.311814, -0.685515, 0.405885, -0.41834, -0.0415611, 0.285391, 0.0921643, -0.037688};
+    const TNeuralNetwork<double>& network = model.GetNeuralNetwork<double>();
+    vector<double> docNorm = Normalized(docVector), wordNorm = Normalized(wordVector);
+    for (unsigned int i = 0; i < 8; ++i) {
+        ASSERT_NEAR(network.GetDocumentNormVector(docIndex)[i], docNorm[i], 1e-5);
+        ASSERT_NEAR(network.GetWordNormVector(wordIndex)[i], wordNorm[i], 1e-5);
+    }
+
+    auto docs = FindSimilarDocs(model, docIndex, 3);
+    ASSERT_EQUAL(docs.size(), 3u);
+    const string docTags[] = {"_*21", "_*46", "_*11"};
+    const double docSimilarities[] = {0.799387, 0.7723, 0.75357};
+    for (size_t i = 0; i < docs.size(); ++i) {
+        ASSERT_EQUAL(docs[i].Document->GetTag(), docTags[i]);
+        ASSERT_NEAR(docs[i].Similarity, docSimilarities[i], 1e-5);
+    }
+
+    auto words = FindSimilarWords(model, "w3", 3);
+    ASSERT_EQUAL(words.size(), 3u);
+    const string similarWords[] = {"t3_4", "t2_1", "w11"};
+    const double wordSimilarities[] = {0.937164, 0.904248, 0.871929};
+    for (size_t i = 0; i < words.size(); ++i) {
+        ASSERT_EQUAL(words[i].Word.Word, similarWords[i]);
+        ASSERT_NEAR(words[i].Similarity, wordSimilarities[i], 1e-5);
+    }
+}
+
+TEST(TrainRejectsBatchNegativesWithCBOW) {
+    TTrainSpec spec = GetSmallSpec(EPrecision::Float);
+    spec.BatchNegatives = true;
+    TDoc2Vec model(spec);
+    ASSERT_THROWS(model.Train());
+    spec.CBOW = false;
+    spec.HierarchicalSoftmax = true;
+    spec.NegativeSampleNum = 0;
+    TDoc2Vec hsModel(spec);
+    ASSERT_THROWS(hsModel.Train());
+}
+
+TEST(TextModelRoundTripFloat) {
+    AssertTextRoundTrip<float>(EPrecision::Float);
+}
+
+TEST(TextModelRoundTripDouble) {
+    AssertTextRoundTrip<double>(EPrecision::Double);
+}
+
+TEST(LoadTextModelOfUnknownVersion) {
+    string filename = GetTempPath("future.txt");
+    {
+        ofstream out(filename);
+        out << "TDoc2Vec" << endl << TEXT_MODEL_VERSION + 1 << endl << "TTrainSpec" << endl;
+    }
+    ASSERT_THROWS(LoadTextModel(filename));
+}
+
+TEST(BinaryModelRoundTrip) {
+    TDoc2Vec model(GetSmallSpec(EPrecision::Float));
+    model.Train();
+    string filename = GetTempPath("round_trip.bin");
+    SaveBinaryModel(model, filename);
+    ASSERT(IsBinaryModel(filename));
+
+    TDoc2Vec mapped;
+    mapped.LoadBinary(filename);
+    ASSERT(mapped.GetPrecision() == EPrecision::Float);
+    for (unsigned int i = 0; ; ++i) {
+        TWord word, mappedWord;
+        if (!model.GetWord(i, word)) {
+            ASSERT(!mapped.GetWord(i, mappedWord));
+            break;
+        }
+        ASSERT(mapped.GetWord(i, mappedWord));
+        ASSERT_EQUAL(word.Word, mappedWord.Word);
+        ASSERT_EQUAL(word.Frequency, mappedWord.Frequency);
+        unsigned int index;
+        ASSERT(mapped.GetWordIndex(word.Word, index));
+        ASSERT_EQUAL(index, i);
+    }
+    for (unsigned int doc = 0; doc < 48; ++doc) {
+        ASSERT_EQUAL(model.GetDocument(doc)->GetRawDocument(), mapped.GetDocument(doc)->GetRawDocument());
+        unsigned int index;
+        ASSERT(mapped.GetDocumentIndex(model.GetDocument(doc)->GetTag(), index));
+        ASSERT_EQUAL(index, doc);
+    }
+    // Normalized layers are written, mapped ones are the same bits
+    AssertLayersEqual(model.GetNeuralNetwork<float>().GetWordsNormLayer(), mapped.GetNeuralNetwork<float>().GetWordsNormLayer());
+    AssertLayersEqual(model.GetNeuralNetwork<float>().GetDocsNormLayer(), mapped.GetNeuralNetwork<float>().GetDocsNormLayer());
+    AssertSameSimilar(model, mapped);
+}
+
+TEST(BinaryModelRoundTripWithIndexes) {
+    TDoc2Vec model(GetSmallSpec(EPrecision::Double));
+    model.Train();
+    model.Quantize(EQuantization::Int8);
+    model.BuildDocsIndex(2);
+    string filename = GetTempPath("indexes.bin");
+    SaveBinaryModel(model, filename);
+
+    TDoc2Vec mapped;
+    mapped.LoadBinary(filename);
+    ASSERT(mapped.GetPrecision() == EPrecision::Double);
+    ASSERT(mapped.GetWordsQuantizedLayer() && mapped.GetDocsQuantizedLayer());
+    ASSERT(mapped.GetDocsQuantizedLayer()->GetQuantization() == EQuantization::Int8);
+    ASSERT(mapped.GetDocsIndex() && mapped.GetDocsIndex()->GetSubspaceNum() == 2);
+    AssertSameSimilar(model, mapped);
+}
+
+TEST(BinaryModelRejectsUnknownPrecision) {
+    TDoc2Vec model(GetSmallSpec(EPrecision::Float));
+    string filename = GetTempPath("precision.bin");
+    SaveBinaryModel(model, filename);
+    uint64_t specOffset;
+    {
+        TBinaryModelReader reader(filename);
+        specOffset = reader.GetSection(EBinarySection::Spec).Offset;
+    }
+    uint32_t precision = 7;
+    PatchFile(filename, specOffset + offsetof(TBinarySpec, Precision), &precision, sizeof(precision));
+    TDoc2Vec mapped;
+    ASSERT_THROWS(mapped.LoadBinary(filename));
+}
+
+TEST(BinaryModelRejectsOtherVersion) {
+    TDoc2Vec model(GetSmallSpec(EPrecision::Float));
+    string filename = GetTempPath("version.bin");
+    SaveBinaryModel(model, filename);
+    uint32_t version = BINARY_MODEL_VERSION - 1;
+    PatchFile(filename, offsetof(TBinaryHeader, Version), &version, sizeof(version));
+    TDoc2Vec mapped;
+    ASSERT_THROWS(mapped.LoadBinary(filename));
+}
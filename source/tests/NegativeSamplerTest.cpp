@@ -0,0 +1,63 @@
+#include "Test.h"
+#include "NegativeSampler.h"
+
+#include <string>
+#include <vector>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+    // Frequencies from single occurrences to a dominant word, like stop words of a corpus
+    void FillVocabulary(TVocabulary& vocabulary, vector<unsigned int>& frequencies) {
+        for (unsigned int i = 0; i < 30; ++i) {
+            frequencies.push_back(i == 0 ? 100000 : 1 + (i * i * 37) % 5000);
+            vocabulary.AddNormalizedWord("w" + to_string(i), frequencies.back());
+        }
+    }
+}
+
+// Old unigram table had every word in proportion to frequency^NEGATIVE_SAMPLE_POWER,
+// alias table should give the same distribution
+TEST(NegativeSamplerDistribution) {
+    TVocabulary vocabulary;
+    vector<unsigned int> frequencies;
+    FillVocabulary(vocabulary, frequencies);
+    TNegativeSampler sampler(vocabulary);
+    ASSERT_EQUAL(sampler.Size(), frequencies.size());
+
+    vector<double> probabilities;
+    double totalWeight = 0;
+    for (unsigned int frequency : frequencies) {
+        probabilities.push_back(pow(frequency, NEGATIVE_SAMPLE_POWER));
+        totalWeight += probabilities.back();
+    }
+
+    const int drawNum = 2000000;
+    vector<int> counts(frequencies.size(), 0);
+    TFastRandom random(1);
+    for (int i = 0; i < drawNum; ++i) {
+        unsigned int word = sampler.Sample(random);
+        ASSERT(word < counts.size());
+        ++counts[word];
+    }
+    for (size_t word = 0; word < counts.size(); ++word) {
+        double p = probabilities[word] / totalWeight;
+        double deviation = sqrt(drawNum * p * (1 - p));
+        ASSERT_NEAR(counts[word], drawNum * p, 5 * deviation + 1);
+    }
+}
+
+TEST(NegativeSamplerSingleWord) {
+    TVocabulary vocabulary;
+    vocabulary.AddNormalizedWord("word", 3);
+    TNegativeSampler sampler(vocabulary);
+    TFastRandom random(1);
+    for (int i = 0; i < 1000; ++i)
+        ASSERT_EQUAL(sampler.Sample(random), 0u);
+}
+
+TEST(NegativeSamplerRejectsEmptyVocabulary) {
+    TVocabulary vocabulary;
+    ASSERT_THROWS(TNegativeSampler sampler(vocabulary));
+}
@@ -0,0 +1,144 @@
+#include "Test.h"
+#include "NeuralNetwork.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+    const unsigned int WORD_NUM = 6, DOC_NUM = 4, DIM = 7;
+    // Rows which are zero before normalization
+    const unsigned int ZERO_WORD = 2, ZERO_DOC = 3;
+
+    // Raw vectors with known values, zero rows included
+    void FillNetwork(TNeuralNetwork<double>& network) {
+        for (unsigned int i = 0; i < WORD_NUM; ++i) {
+            TLayerVector<double> row = network.GetWordVector(i);
+            for (unsigned int j = 0; j < DIM; ++j)
+                row[j] = i == ZERO_WORD ? 0 : sin(i * DIM + j + 1.0) * (i + 1);
+        }
+        for (unsigned int i = 0; i < DOC_NUM; ++i) {
+            TLayerVector<double> row = network.GetDocumentVector(i);
+            for (unsigned int j = 0; j < DIM; ++j)
+                row[j] = i == ZERO_DOC ? 0 : cos(i * DIM + j + 1.0) * (i + 2);
+        }
+    }
+
+    vector<double> CopyRow(const TLayerVector<double>& row) {
+        vector<double> res;
+        for (unsigned int j = 0; j < DIM; ++j)
+            res.push_back(row[j]);
+        return res;
+    }
+
+    vector<vector<double>> CopyWords(TNeuralNetwork<double>& network) {
+        vector<vector<double>> res;
+        for (unsigned int i = 0; i < WORD_NUM; ++i)
+            res.push_back(CopyRow(network.GetWordVector(i)));
+        return res;
+    }
+
+    vector<vector<double>> CopyDocs(TNeuralNetwork<double>& network) {
+        vector<vector<double>> res;
+        for (unsigned int i = 0; i < DOC_NUM; ++i)
+            res.push_back(CopyRow(network.GetDocumentVector(i)));
+        return res;
+    }
+
+    // Scalar reference of NormalizeVector
+    vector<double> ReferenceNormalized(const vector<double>& vec) {
+        double len = 0;
+        for (double value : vec)
+            len += value * value;
+        len = sqrt(len);
+        vector<double> res;
+        for (double value : vec)
+            res.push_back(len > 0 ? value / len : 0);
+        return res;
+    }
+
+    void AssertNormalized(const TLayer<double>& layer, const vector<vector<double>>& raw, unsigned int zeroRow) {
+        ASSERT_EQUAL(layer.Size(), raw.size());
+        for (size_t i = 0; i < raw.size(); ++i) {
+            vector<double> expected = ReferenceNormalized(raw[i]);
+            for (unsigned int j = 0; j < DIM; ++j) {
+                ASSERT(!std::isnan(layer.Row(i)[j]));
+                ASSERT_NEAR(layer.Row(i)[j], expected[j], 1e-12);
+                if (i == zeroRow)
+                    ASSERT_EQUAL(layer.Row(i)[j], 0.0);
+            }
+        }
+    }
+
+    void AssertRowsEqual(const vector<vector<double>>& a, const vector<vector<double>>& b) {
+        ASSERT_EQUAL(a.size(), b.size());
+        for (size_t i = 0; i < a.size(); ++i) {
+            for (unsigned int j = 0; j < DIM; ++j)
+                ASSERT_EQUAL(a[i][j], b[i][j]);
+        }
+    }
+}
+
+TEST(NormalizedLayersAreCopies) {
+    TNeuralNetwork<double> network(WORD_NUM, DOC_NUM, DIM);
+    FillNetwork(network);
+    vector<vector<double>> words = CopyWords(network), docs = CopyDocs(network);
+
+    const TNeuralNetwork<double>& constNetwork = network;
+    AssertNormalized(constNetwork.GetWordsNormLayer(), words, ZERO_WORD);
+    AssertNormalized(constNetwork.GetDocsNormLayer(), docs, ZERO_DOC);
+    ASSERT_EQUAL(constNetwork.GetWordNormVector(ZERO_WORD)[0], 0.0);
+    // Queries leave raw weights untouched
+    AssertRowsEqual(CopyWords(network), words);
+    AssertRowsEqual(CopyDocs(network), docs);
+
+    // and text model written after queries keeps raw weights
+    string filename = GetTempPath("network.txt");
+    {
+        ofstream out(filename);
+        network.Save(out);
+    }
+    TNeuralNetwork<double> loaded;
+    {
+        ifstream in(filename);
+        loaded.Load(in);
+    }
+    vector<vector<double>> loadedWords = CopyWords(loaded);
+    for (unsigned int i = 0; i < WORD_NUM; ++i) {
+        for (unsigned int j = 0; j < DIM; ++j)
+            ASSERT_NEAR(loadedWords[i][j], words[i][j], 1e-5 * (i + 1));
+    }
+}
+
+TEST(FinishTrainingNormalizesInPlace) {
+    TNeuralNetwork<double> network(WORD_NUM, DOC_NUM, DIM);
+    FillNetwork(network);
+    vector<vector<double>> words = CopyWords(network), docs = CopyDocs(network);
+    network.FinishTraining();
+
+    AssertNormalized(network.GetWordsNormLayer(), words, ZERO_WORD);
+    AssertNormalized(network.GetDocsNormLayer(), docs, ZERO_DOC);
+    // Normalized layers are the raw ones now, not copies
+    ASSERT(network.GetWordNormVector(1).Begin() == network.GetWordVector(1).Begin());
+    ASSERT(network.GetDocumentNormVector(1).Begin() == network.GetDocumentVector(1).Begin());
+    AssertNormalized(network.GetWordsNormLayer(), CopyWords(network), ZERO_WORD);
+
+    // Raw vectors are lost, text model can't be written anymore
+    ofstream out(GetTempPath("finished.txt"));
+    ASSERT_THROWS(network.Save(out));
+}
+
+TEST(FinishTrainingAfterQueries) {
+    TNeuralNetwork<double> network(WORD_NUM, DOC_NUM, DIM);
+    FillNetwork(network);
+    vector<vector<double>> words = CopyWords(network), docs = CopyDocs(network);
+    // Copy built by the query replaces raw layer
+    network.GetWordsNormLayer();
+    network.FinishTraining();
+    AssertNormalized(network.GetWordsNormLayer(), words, ZERO_WORD);
+    AssertNormalized(network.GetDocsNormLayer(), docs, ZERO_DOC);
+    ASSERT(network.GetWordNormVector(1).Begin() == network.GetWordVector(1).Begin());
+}
@@ -0,0 +1,91 @@
+#include "Test.h"
+#include "Algorithm.h"
+#include "ProductQuantization.h"
+
+#include <vector>
+#include <set>
+#include <random>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+    const unsigned int ROW_NUM = 2000, DIM = 32, CLUSTER_NUM = 40;
+    const unsigned int QUERY_NUM = 50, RECALL_NUM = 10;
+
+    // Normalized rows scattered around random cluster centers, like documents of a few topics
+    TLayer<float> CreateClusteredLayer() {
+        mt19937 generator(1);
+        normal_distribution<float> normal;
+        vector<vector<float>> centers(CLUSTER_NUM, vector<float>(DIM));
+        for (auto& center : centers) {
+            for (float& value : center)
+                value = normal(generator);
+        }
+        return TLayer<float>(ROW_NUM, DIM, [&](size_t i, float* row, unsigned int dim) {
+            const vector<float>& center = centers[i % CLUSTER_NUM];
+            float len = 0;
+            for (unsigned int j = 0; j < dim; ++j) {
+                row[j] = center[j] + 0.5f * normal(generator);
+                len += row[j] * row[j];
+            }
+            for (unsigned int j = 0; j < dim; ++j)
+                row[j] /= sqrt(len);
+        }, TLayerOptions());
+    }
+
+    // Recall@RECALL_NUM of index search against exact scan
+    double EvaluateRecall(const TProductQuantizer& index, const TLayer<float>& layer, unsigned int rerankNum) {
+        size_t found = 0, total = 0;
+        for (unsigned int q = 0; q < QUERY_NUM; ++q) {
+            unsigned int target = q * (ROW_NUM / QUERY_NUM);
+            set<unsigned int> exact;
+            for (const auto& object : FindSimilarObjects(target, layer, RECALL_NUM))
+                exact.insert(object.Index);
+            auto approximate = FindSimilarObjects(target, index, layer, RECALL_NUM, rerankNum);
+            ASSERT_EQUAL(approximate.size(), static_cast<size_t>(RECALL_NUM));
+            for (const auto& object : approximate)
+                found += exact.count(object.Index);
+            total += exact.size();
+        }
+        return static_cast<double>(found) / total;
+    }
+}
+
+TEST(ProductQuantizationScores) {
+    TLayer<float> layer = CreateClusteredLayer();
+    TProductQuantizer index(layer, 8);
+    ASSERT_EQUAL(index.Size(), ROW_NUM);
+    vector<float> scores;
+    index.Score(layer.Row(0), scores);
+    ASSERT_EQUAL(scores.size(), static_cast<size_t>(ROW_NUM));
+    // Scores approximate exact dot products of normalized rows
+    double errorSum = 0;
+    for (unsigned int i = 0; i < ROW_NUM; ++i) {
+        double exact = 0;
+        for (unsigned int j = 0; j < DIM; ++j)
+            exact += layer.Row(0)[j] * layer.Row(i)[j];
+        errorSum += fabs(scores[i] - exact);
+    }
+    ASSERT(errorSum / ROW_NUM < 0.1);
+}
+
+TEST(ProductQuantizationRecall) {
+    TLayer<float> layer = CreateClusteredLayer();
+    TProductQuantizer index(layer, 8);
+    double recall = EvaluateRecall(index, layer, 0);
+    double rerankedRecall = EvaluateRecall(index, layer, RECALL_NUM * 10);
+    cout << "recall " << recall << ", with rerank " << rerankedRecall << endl;
+    ASSERT(recall >= 0.5);
+    ASSERT(rerankedRecall >= 0.95);
+    ASSERT(rerankedRecall >= recall);
+    // More subspaces keep more of every row
+    TProductQuantizer fineIndex(layer, 16);
+    ASSERT(EvaluateRecall(fineIndex, layer, 0) >= recall);
+}
+
+TEST(ProductQuantizationRejectsWrongSubspaces) {
+    TLayer<float> layer = CreateClusteredLayer();
+    ASSERT_THROWS(TProductQuantizer(layer, 0));
+    ASSERT_THROWS(TProductQuantizer(layer, DIM + 1));
+}
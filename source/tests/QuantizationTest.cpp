@@ -0,0 +1,95 @@
+#include "Test.h"
+#include "Quantization.h"
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+    // Deterministic values in [-1, 1], zero row included
+    TLayer<float> CreateLayer(unsigned int rows, unsigned int dim) {
+        return TLayer<float>(rows, dim, [](size_t i, float* row, unsigned int dim) {
+            for (unsigned int j = 0; j < dim; ++j)
+                row[j] = i == 3 ? 0 : static_cast<float>(sin(i * 131.0 + j * 17.0 + 1));
+        }, TLayerOptions());
+    }
+
+    double Dot(const float* a, const float* b, unsigned int dim) {
+        double res = 0;
+        for (unsigned int j = 0; j < dim; ++j)
+            res += static_cast<double>(a[j]) * b[j];
+        return res;
+    }
+
+    // Scores of quantized layer are compared with exact dot products of the float layer,
+    // error of every coordinate is at most maxError(row)
+    template <class MaxError>
+    void AssertScores(unsigned int rows, unsigned int dim, EQuantization quantization, MaxError maxError) {
+        TLayer<float> layer = CreateLayer(rows, dim);
+        TQuantizedLayer quantized(layer, quantization);
+        const float* query = layer.Row(5);
+        vector<float> scores;
+        quantized.Score(query, scores);
+        ASSERT_EQUAL(scores.size(), static_cast<size_t>(rows));
+        double queryL1 = 0;
+        for (unsigned int j = 0; j < dim; ++j)
+            queryL1 += fabs(query[j]);
+        for (unsigned int i = 0; i < rows; ++i) {
+            const float* row = layer.Row(i);
+            ASSERT_NEAR(scores[i], Dot(query, row, dim), queryL1 * maxError(row, dim) + 1e-4);
+        }
+        ASSERT_EQUAL(scores[3], 0.0f);
+    }
+
+    double Int8MaxError(const float* row, unsigned int dim) {
+        float maxAbs = 0;
+        for (unsigned int j = 0; j < dim; ++j)
+            maxAbs = max(maxAbs, fabs(row[j]));
+        return maxAbs / 127 / 2;
+    }
+
+    double Fp16MaxError(const float*, unsigned int) {
+        // values are below 1, half keeps 11 significant bits
+        return 1.0 / 2048;
+    }
+}
+
+// Rows are scored by blocks, row counts which aren't multiple of block cover the tail
+TEST(Int8ScoresOfSpecializedDimension) {
+    AssertScores(QUANTIZED_SCORE_BLOCK_ROWS * 3 + 5, 100, EQuantization::Int8, Int8MaxError);
+}
+
+TEST(Int8ScoresOfGenericDimension) {
+    AssertScores(QUANTIZED_SCORE_BLOCK_ROWS + 1, 37, EQuantization::Int8, Int8MaxError);
+}
+
+TEST(Fp16ScoresOfSpecializedDimension) {
+    AssertScores(QUANTIZED_SCORE_BLOCK_ROWS * 3 + 5, 100, EQuantization::Fp16, Fp16MaxError);
+}
+
+TEST(Fp16ScoresOfGenericDimension) {
+    AssertScores(QUANTIZED_SCORE_BLOCK_ROWS + 1, 37, EQuantization::Fp16, Fp16MaxError);
+}
+
+// Every finite half is a row of one coordinate, scoring it by 1 must give exactly HalfToFloat of it
+TEST(Fp16ScoresAllFiniteHalves) {
+    vector<uint16_t> halves;
+    for (uint32_t half = 0; half <= 0xffff; ++half) {
+        if (((half >> 10) & 0x1f) != 0x1f)
+            halves.push_back(static_cast<uint16_t>(half));
+    }
+    TLayer<float> layer(halves.size(), 1, [&halves](size_t i, float* row, unsigned int) {
+        row[0] = HalfToFloat(halves[i]);
+    }, TLayerOptions());
+    TQuantizedLayer quantized(layer, EQuantization::Fp16);
+    const float query[] = {1};
+    vector<float> scores;
+    quantized.Score(query, scores);
+    for (size_t i = 0; i < halves.size(); ++i) {
+        ASSERT_EQUAL(FloatToHalf(layer.Row(i)[0]), halves[i]);
+        ASSERT_EQUAL(scores[i], layer.Row(i)[0]);
+    }
+}
@@ -0,0 +1,57 @@
+#include "Test.h"
+#include "Random.h"
+
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+namespace {
+    // Rejection sampling of the multiply-shift draw written from its definition: product of a raw output and bound
+    // is rejected while its low 32 bits fall below 2^32 mod bound
+    uint32_t ReferenceNextIndex(TFastRandom& random, uint32_t bound) {
+        const uint64_t threshold = (1ULL << 32) % bound;
+        while (true) {
+            uint64_t product = static_cast<uint64_t>(random.Next()) * bound;
+            if ((product & 0xffffffffULL) >= threshold)
+                return static_cast<uint32_t>(product >> 32);
+        }
+    }
+}
+
+TEST(NextIndexMatchesReference) {
+    // Powers of two never reject, 2^31 + 1 rejects almost half of raw outputs
+    for (uint32_t bound : {1u, 2u, 3u, 7u, 10u, 1000u, 1u << 20, (1u << 31) + 1, UINT32_MAX}) {
+        TFastRandom random(5, 3), reference(5, 3);
+        for (int i = 0; i < 10000; ++i) {
+            uint32_t index = random.NextIndex(bound);
+            ASSERT(index < bound);
+            ASSERT_EQUAL(index, ReferenceNextIndex(reference, bound));
+        }
+        // Both consumed the same raw outputs
+        ASSERT_EQUAL(random.Next(), reference.Next());
+    }
+}
+
+TEST(NextIndexIsUniform) {
+    const uint32_t bound = 6;
+    const int drawNum = 600000;
+    vector<int> counts(bound, 0);
+    TFastRandom random(1);
+    for (int i = 0; i < drawNum; ++i)
+        ++counts[random.NextIndex(bound)];
+    // Each count is binomial with mean 100000 and deviation about 289
+    for (int count : counts)
+        ASSERT_NEAR(count, drawNum / bound, 5 * 289);
+}
+
+TEST(StreamsDiffer) {
+    TFastRandom first(1, 0), second(1, 1), same(1, 0);
+    int equalNum = 0;
+    for (int i = 0; i < 100; ++i) {
+        uint32_t value = first.Next();
+        equalNum += value == second.Next();
+        ASSERT_EQUAL(value, same.Next());
+    }
+    ASSERT(equalNum < 5);
+}
@@ -0,0 +1,65 @@
+#include "Test.h"
+#include "Sigmoid.h"
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+    const int OLD_EXP_TABLE_SIZE = 1000;
+
+    double ExactSigmoid(double x) {
+        return 1 / (1 + exp(-x));
+    }
+
+    // Lookup of the exp table of the old training code, x in (-MAX_EXP, MAX_EXP)
+    double OldTableSigmoid(double x) {
+        size_t index = static_cast<size_t>((x + MAX_EXP) * (OLD_EXP_TABLE_SIZE / MAX_EXP / 2));
+        double e = exp((static_cast<double>(index) / OLD_EXP_TABLE_SIZE * 2 - 1) * MAX_EXP);
+        return e / (e + 1);
+    }
+
+    vector<double> GetPoints(double bound) {
+        vector<double> xs;
+        for (int i = -100000; i <= 100000; ++i)
+            xs.push_back(bound * i / 100001);
+        return xs;
+    }
+}
+
+// Interpolated table is much closer to the logistic function than the step table it replaced
+TEST(TableSigmoidError) {
+    TSigmoid sigmoid(ESigmoid::Table);
+    double oldError = 0, error = 0;
+    for (double x : GetPoints(MAX_EXP)) {
+        oldError = max(oldError, fabs(OldTableSigmoid(x) - ExactSigmoid(x)));
+        error = max(error, fabs(sigmoid(x) - ExactSigmoid(x)));
+        ASSERT_NEAR(sigmoid(static_cast<float>(x)), ExactSigmoid(x), 2e-6);
+    }
+    ASSERT(error < 2e-6);
+    ASSERT(error < oldError / 100);
+}
+
+TEST(TableSigmoidSaturation) {
+    TSigmoid sigmoid(ESigmoid::Table);
+    ASSERT_EQUAL(sigmoid(-MAX_EXP - 0.5), 0.0);
+    ASSERT_EQUAL(sigmoid(static_cast<double>(-MAX_EXP)), 0.0);
+    ASSERT_EQUAL(sigmoid(MAX_EXP + 0.5), 1.0);
+    ASSERT_EQUAL(sigmoid(static_cast<double>(MAX_EXP)), 1.0);
+    // The last interval is interpolated up to its right end
+    ASSERT_NEAR(sigmoid(nextafter(static_cast<double>(MAX_EXP), 0.0)), ExactSigmoid(MAX_EXP), 1e-6);
+    ASSERT_EQUAL(sigmoid(numeric_limits<double>::quiet_NaN()), 1.0);
+}
+
+TEST(RationalSigmoidError) {
+    TSigmoid sigmoid(ESigmoid::Rational);
+    for (double x : GetPoints(4 * MAX_EXP)) {
+        ASSERT_NEAR(sigmoid(x), ExactSigmoid(x), 1e-6);
+        ASSERT_NEAR(sigmoid(static_cast<float>(x)), ExactSigmoid(x), 1e-6);
+    }
+    ASSERT_NEAR(sigmoid(1e30), 1.0, 1e-6);
+    ASSERT_NEAR(sigmoid(-1e30), 0.0, 1e-6);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <stdexcept>
+#include <cmath>
+
+/*
+ * Minimal test framework of doc2vec_test: TEST(Name) { ... } registers a test case, assertions throw TTestFailure.
+ * Test cases are run one by one by TestMain.cpp, output of the tested code is shown only for failed cases.
+ */
+
+typedef void (*TTestFunc)();
+
+struct TTestCase {
+    std::string Name;
+    TTestFunc Func;
+};
+
+std::vector<TTestCase>& GetTestCases();
+
+struct TTestRegistrator {
+    TTestRegistrator(const char* name, TTestFunc func) {
+        GetTestCases().push_back({name, func});
+    }
+};
+
+#define TEST(Name) \
+    static void Name(); \
+    static TTestRegistrator Name##Registrator(#Name, Name); \
+    static void Name()
+
+class TTestFailure : public std::runtime_error {
+public:
+    TTestFailure(const char* file, int line, const std::string& message)
+        : std::runtime_error(std::string(file) + ":" + std::to_string(line) + ": " + message)
+    {}
+};
+
+#define ASSERT(cond) \
+    do { \
+        if (!(cond)) \
+            throw TTestFailure(__FILE__, __LINE__, "assertion failed: " #cond); \
+    } while (false)
+
+#define ASSERT_EQUAL(a, b) \
+    do { \
+        auto assertA = (a); \
+        auto assertB = (b); \
+        if (!(assertA == assertB)) { \
+            std::ostringstream assertMessage; \
+            assertMessage << #a " == " #b " failed: " << assertA << " != " << assertB; \
+            throw TTestFailure(__FILE__, __LINE__, assertMessage.str()); \
+        } \
+    } while (false)
+
+#define ASSERT_NEAR(a, b, eps) \
+    do { \
+        double assertA = (a); \
+        double assertB = (b); \
+        if (!(std::fabs(assertA - assertB) <= (eps))) { \
+            std::ostringstream assertMessage; \
+            assertMessage << #a " ~ " #b " failed: " << assertA << " and " << assertB << " differ by more than " << (eps); \
+            throw TTestFailure(__FILE__, __LINE__, assertMessage.str()); \
+        } \
+    } while (false)
+
+#define ASSERT_THROWS(expr) \
+    do { \
+        bool assertThrown = false; \
+        try { \
+            expr; \
+        } catch (const TTestFailure&) { \
+            throw; \
+        } catch (const std::exception&) { \
+            assertThrown = true; \
+        } \
+        if (!assertThrown) \
+            throw TTestFailure(__FILE__, __LINE__, "no exception from " #expr); \
+    } while (false)
+
+// Fixtures directory, the first argument of doc2vec_test
+std::string GetTestDataPath(const std::string& name);
+// Path in a temporary directory which is removed with everything in it after all tests
+std::string GetTempPath(const std::string& name);
@@ -0,0 +1,88 @@
+#include "Test.h"
+#include "Common.h"
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <exception>
+#include <cstdlib>
+#include <dirent.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+    string DataDir = "tests/data";
+    string TempDir;
+
+    void RemoveTempDir() {
+        if (TempDir.empty())
+            return;
+        if (DIR* dir = opendir(TempDir.c_str())) {
+            while (dirent* entry = readdir(dir)) {
+                string name = entry->d_name;
+                if (name != "." && name != "..")
+                    unlink((TempDir + "/" + name).c_str());
+            }
+            closedir(dir);
+        }
+        rmdir(TempDir.c_str());
+    }
+}
+
+vector<TTestCase>& GetTestCases() {
+    static vector<TTestCase> testCases;
+    return testCases;
+}
+
+string GetTestDataPath(const string& name) {
+    return DataDir + "/" + name;
+}
+
+string GetTempPath(const string& name) {
+    if (TempDir.empty()) {
+        char pattern[] = "/tmp/doc2vec_test.XXXXXX";
+        if (!mkdtemp(pattern))
+            throw runtime_error("Cannot create temporary directory.");
+        TempDir = pattern;
+    }
+    return TempDir + "/" + name;
+}
+
+// Usage: doc2vec_test [fixtures directory [test name substring]]
+int main(int argc, char* argv[]) {
+    if (argc > 1)
+        DataDir = argv[1];
+    string filter = argc > 2 ? argv[2] : "";
+
+    // Output of the tested code goes to the buffer, report goes to the real stdout
+    ostream report(cout.rdbuf());
+    streambuf* cerrBuf = cerr.rdbuf();
+    size_t runNum = 0, failNum = 0;
+    for (const TTestCase& testCase : GetTestCases()) {
+        if (testCase.Name.find(filter) == string::npos)
+            continue;
+        ++runNum;
+        ostringstream output;
+        cout.rdbuf(output.rdbuf());
+        cerr.rdbuf(output.rdbuf());
+        string error;
+        try {
+            testCase.Func();
+        } catch (const exception& e) {
+            error = e.what();
+        }
+        cout.rdbuf(report.rdbuf());
+        cerr.rdbuf(cerrBuf);
+        if (error.empty()) {
+            report << "[  OK  ] " << testCase.Name << endl;
+        } else {
+            ++failNum;
+            report << "[ FAIL ] " << testCase.Name << endl << output.str() << endl << error << endl;
+        }
+    }
+    RemoveTempDir();
+    report << runNum - failNum << " of " << runNum << " tests passed." << endl;
+    return failNum == 0 && runNum > 0 ? SUCCESS_RETURN : FAIL_RETURN;
+}
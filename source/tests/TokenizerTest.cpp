@@ -0,0 +1,67 @@
+#include "Test.h"
+#include "Tokenizer.h"
+#include "Vocabulary.h"
+#include "Random.h"
+
+#include <string>
+#include <vector>
+#include <regex>
+#include <cctype>
+
+using namespace std;
+
+namespace {
+    // Words of the old tokenizer
+    vector<string> RegexWords(const string& text) {
+        static const regex wordRegex("\\w+");
+        vector<string> words;
+        for (sregex_iterator it(text.begin(), text.end(), wordRegex), end; it != end; ++it)
+            words.push_back(it->str());
+        return words;
+    }
+
+    vector<string> TableWords(const string& text) {
+        vector<string> words;
+        ForEachWord(text.data(), text.data() + text.size(), [&words](const char* begin, const char* end) {
+            words.emplace_back(begin, end);
+        });
+        return words;
+    }
+}
+
+// Byte classes are the ones of \w and tolower in "C" locale, bytes of UTF-8 characters included
+TEST(CharacterTableMatchesLocale) {
+    const regex wordCharacter("\\w");
+    for (int c = 0; c < 256; ++c) {
+        string byte(1, static_cast<char>(c));
+        ASSERT_EQUAL(IsWordCharacter(byte[0]), regex_match(byte, wordCharacter));
+        ASSERT_EQUAL(static_cast<int>(static_cast<uint8_t>(ToLowerCharacter(byte[0]))), tolower(c));
+    }
+}
+
+TEST(TokenizerMatchesRegex) {
+    // Fixed cases: edges of the text, runs of separators, UTF-8 and control bytes
+    for (const char* text : {"", " ", "a", "_", "word", " Word, w0rd_2!", "a\tb\nc\rd", "\xd0\xbf\xd1\x80\xd0\xb8 x",
+        "end_", "__init__", "1.5e10", "caf\xc3\xa9 au lait"})
+    {
+        ASSERT(TableWords(text) == RegexWords(text));
+    }
+
+    // Random bytes biased to word characters, so words of different lengths appear
+    const string alphabet = "aZ_09 ,.\t\n-'";
+    TFastRandom random(7);
+    for (int i = 0; i < 2000; ++i) {
+        string text(random.NextIndex(64), ' ');
+        for (char& c : text)
+            c = random.NextIndex(4) == 0 ? static_cast<char>(random.NextIndex(256)) : alphabet[random.NextIndex(alphabet.size())];
+        ASSERT(TableWords(text) == RegexWords(text));
+    }
+}
+
+TEST(NormalizeWordLowersAscii) {
+    ASSERT_EQUAL(NormalizeWord("MiXeD_Case09"), "mixed_case09");
+    ASSERT_EQUAL(NormalizeWord("\xd0\x9f"), "\xd0\x9f");
+    string buffer = "longer buffer";
+    AssignNormalizedWord("AB", "AB" + 2, buffer);
+    ASSERT_EQUAL(buffer, "ab");
+}
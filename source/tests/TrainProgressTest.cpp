@@ -0,0 +1,58 @@
+#include "Test.h"
+#include "TrainProgress.h"
+#include "Doc2Vec.h"
+#include "Corpus.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Alpha decays linearly with words added by all threads and stops at ALPHA_MAX_REDUCE_COEFFICENT of its initial value
+TEST(TrainProgressFollowsLinearSchedule) {
+    const double initial = 0.1;
+    auto alpha = make_shared<TAlpha>(initial);
+    TTrainProgress progress(alpha, 4, 1000);
+    progress.Start();
+    vector<thread> threads;
+    for (unsigned int t = 0; t < 4; ++t) {
+        threads.emplace_back([&progress, t]() {
+            for (unsigned int i = 0; i < 50; ++i)
+                progress.Add(t, t + 1);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    progress.Stop();
+    ASSERT_EQUAL(progress.GetWordCount(), 500u);
+    ASSERT_NEAR(alpha->Get(), initial * 0.5, 1e-15);
+
+    alpha->Update(1);
+    ASSERT_NEAR(alpha->Get(), initial * ALPHA_MAX_REDUCE_COEFFICENT, 1e-15);
+    alpha->Update(0.99999);
+    ASSERT_NEAR(alpha->Get(), initial * ALPHA_MAX_REDUCE_COEFFICENT, 1e-15);
+}
+
+// Train threads together report every corpus token of every iteration, so alpha ends at the final value of the schedule
+TEST(TrainProgressCountsEveryToken) {
+    TCorpus corpus;
+    TDocumentsHolder documents;
+    TVocabulary vocabulary;
+    corpus.Read(GetTestDataPath("dataset.txt"), documents, vocabulary);
+
+    for (unsigned int threadCount : {1u, 3u}) {
+        TTrainSpec spec;
+        spec.DimensionSize = 8;
+        spec.IterationNumber = 3;
+        spec.ThreadCount = threadCount;
+        spec.TrainFilename = GetTestDataPath("dataset.txt");
+        TDoc2Vec model(spec);
+        ASSERT(model.GetTrainProgress() == nullptr);
+        model.Train();
+        ASSERT(model.GetTrainProgress() != nullptr);
+        ASSERT_EQUAL(model.GetTrainProgress()->GetWordCount(), spec.IterationNumber * corpus.GetTokenCount());
+        // Spec copies share alpha with the model
+        ASSERT_NEAR(spec.Alpha->Get(), DEFAULT_ALPHA * ALPHA_MAX_REDUCE_COEFFICENT, 1e-15);
+    }
+}
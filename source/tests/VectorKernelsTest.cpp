@@ -0,0 +1,163 @@
+#include "Test.h"
+#include "VectorKernels.h"
+#include "Sigmoid.h"
+
+#include <vector>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+    // Instruction sets supported by the running CPU, kernels of others aren't tested
+    vector<ESimd> GetSupportedSimds() {
+        vector<ESimd> res;
+        for (ESimd simd : {ESimd::Scalar, ESimd::Sse2, ESimd::Avx2, ESimd::Avx512}) {
+            SelectSimd(simd);
+            if (GetSelectedSimd() == simd)
+                res.push_back(simd);
+        }
+        SelectSimd(ESimd::Auto);
+        return res;
+    }
+
+    // Values in [-1, 1], vectors start one element after an aligned buffer
+    template <typename T>
+    vector<T> CreateVector(size_t n, unsigned int seed) {
+        vector<T> res(n + 1);
+        for (size_t i = 0; i < res.size(); ++i)
+            res[i] = static_cast<T>(sin(i * 1.7 + seed * 0.3));
+        return res;
+    }
+
+    // Kernels are compared with plain loops of the old training code in double,
+    // error of float kernels grows with sum of absolute products
+    template <typename T>
+    void AssertKernels(const TVectorKernels<T>& kernels, size_t n) {
+        const double eps = sizeof(T) == sizeof(float) ? 1e-5 : 1e-12;
+        vector<T> x = CreateVector<T>(n, 1), y = CreateVector<T>(n, 2), e = CreateVector<T>(n, 3);
+        const T alpha = static_cast<T>(0.375);
+
+        double dot = 0, scale = 0;
+        for (size_t i = 1; i <= n; ++i) {
+            dot += static_cast<double>(x[i]) * y[i];
+            scale += fabs(static_cast<double>(x[i]) * y[i]);
+        }
+        ASSERT_NEAR(kernels.Dot(&x[1], &y[1], n), dot, eps * (scale + 1));
+
+        vector<T> axpy = y;
+        kernels.Axpy(alpha, &x[1], &axpy[1], n);
+        for (size_t i = 1; i <= n; ++i)
+            ASSERT_NEAR(axpy[i], y[i] + static_cast<double>(alpha) * x[i], eps);
+        ASSERT_EQUAL(axpy[0], y[0]);
+
+        vector<T> scaled = x;
+        kernels.Scale(alpha, &scaled[1], n);
+        for (size_t i = 1; i <= n; ++i)
+            ASSERT_NEAR(scaled[i], static_cast<double>(alpha) * x[i], eps);
+
+        // error += g * out with the old out, then out += g * hidden
+        vector<T> out = y, error = e;
+        kernels.AxpyPair(alpha, &x[1], &out[1], &error[1], n);
+        for (size_t i = 1; i <= n; ++i) {
+            ASSERT_NEAR(error[i], e[i] + static_cast<double>(alpha) * y[i], eps);
+            ASSERT_NEAR(out[i], y[i] + static_cast<double>(alpha) * x[i], eps);
+        }
+        ASSERT_EQUAL(out[0], y[0]);
+        ASSERT_EQUAL(error[0], e[0]);
+    }
+
+    // Matrix kernels are compared with the loops they replace: a dot product for every pair of rows
+    // and an axpy of every row of x into every row of y. Row counts cover full register tiles and their tails.
+    template <typename T>
+    void AssertMatrixKernels(const TVectorKernels<T>& kernels, size_t n) {
+        const double eps = sizeof(T) == sizeof(float) ? 1e-5 : 1e-12;
+        for (size_t aRows = 0; aRows <= 9; ++aRows) {
+            for (size_t bRows = 0; bRows <= 7; ++bRows) {
+                vector<T> a = CreateVector<T>(aRows * n, 4), b = CreateVector<T>(bRows * n, 5);
+                vector<T> c(aRows * bRows + 1, 0);
+                kernels.DotMatrix(&a[1], aRows, &b[1], bRows, &c[1], n);
+                for (size_t i = 0; i < aRows; ++i) {
+                    for (size_t j = 0; j < bRows; ++j) {
+                        double dot = 0, scale = 0;
+                        for (size_t k = 0; k < n; ++k) {
+                            dot += static_cast<double>(a[1 + i * n + k]) * b[1 + j * n + k];
+                            scale += fabs(static_cast<double>(a[1 + i * n + k]) * b[1 + j * n + k]);
+                        }
+                        ASSERT_NEAR(c[1 + i * bRows + j], dot, eps * (scale + 1));
+                    }
+                }
+                ASSERT_EQUAL(c[0], static_cast<T>(0));
+
+                // y += G * b with G of aRows x bRows, then yt += G^T * a with the same G
+                vector<T> g = CreateVector<T>(aRows * bRows, 6);
+                vector<T> y = CreateVector<T>(aRows * n, 7), yt = CreateVector<T>(bRows * n, 8);
+                vector<T> resY = y, resYt = yt;
+                kernels.AxpyMatrix(&g[1], bRows, 1, &b[1], bRows, &resY[1], aRows, n);
+                kernels.AxpyMatrix(&g[1], 1, bRows, &a[1], aRows, &resYt[1], bRows, n);
+                for (size_t k = 0; k < n; ++k) {
+                    for (size_t i = 0; i < aRows; ++i) {
+                        double expected = y[1 + i * n + k];
+                        for (size_t j = 0; j < bRows; ++j)
+                            expected += static_cast<double>(g[1 + i * bRows + j]) * b[1 + j * n + k];
+                        ASSERT_NEAR(resY[1 + i * n + k], expected, eps * (bRows + 1));
+                    }
+                    for (size_t j = 0; j < bRows; ++j) {
+                        double expected = yt[1 + j * n + k];
+                        for (size_t i = 0; i < aRows; ++i)
+                            expected += static_cast<double>(g[1 + i * bRows + j]) * a[1 + i * n + k];
+                        ASSERT_NEAR(resYt[1 + j * n + k], expected, eps * (aRows + 1));
+                    }
+                }
+                ASSERT_EQUAL(resY[0], y[0]);
+                ASSERT_EQUAL(resYt[0], yt[0]);
+            }
+        }
+    }
+
+    template <typename T>
+    void AssertAllKernels() {
+        for (ESimd simd : GetSupportedSimds()) {
+            SelectSimd(simd);
+            // Generic kernels with tails of every vector width
+            for (size_t n = 0; n <= 40; ++n)
+                AssertKernels(GetVectorKernels<T>(), n);
+            AssertKernels(GetVectorKernels<T>(), 1000);
+            for (size_t n : {0, 1, 5, 16, 37})
+                AssertMatrixKernels(GetVectorKernels<T>(), n);
+            // Unrolled kernels of specialized dimensions
+            for (unsigned int dim : SPECIALIZED_DIMENSIONS) {
+                const TVectorKernels<T>& kernels = GetVectorKernels<T>(dim);
+                ASSERT_EQUAL(kernels.FixedSize, static_cast<size_t>(dim));
+                AssertKernels(kernels, dim);
+                AssertMatrixKernels(kernels, dim);
+            }
+            ASSERT_EQUAL(GetVectorKernels<T>(37).FixedSize, 0u);
+
+            // Vector sigmoid is the scalar rational one
+            vector<T> xs;
+            for (int i = -2000; i <= 2000; ++i)
+                xs.push_back(static_cast<T>(i * 0.01));
+            vector<T> sigmoids = xs;
+            GetVectorKernels<T>().Sigmoid(sigmoids.data(), sigmoids.size());
+            for (size_t i = 0; i < xs.size(); ++i)
+                ASSERT_NEAR(sigmoids[i], RationalSigmoid(xs[i]), 1e-6);
+        }
+        SelectSimd(ESimd::Auto);
+    }
+}
+
+TEST(FloatVectorKernels) {
+    AssertAllKernels<float>();
+}
+
+TEST(DoubleVectorKernels) {
+    AssertAllKernels<double>();
+}
+
+TEST(UnsupportedSimdIsDowngraded) {
+    ESimd detected = DetectSimd();
+    SelectSimd(ESimd::Avx512);
+    ASSERT(GetSelectedSimd() == (detected < ESimd::Avx512 ? detected : ESimd::Avx512));
+    SelectSimd(ESimd::Auto);
+    ASSERT(GetSelectedSimd() == detected);
+}
@@ -0,0 +1,189 @@
+#include "Test.h"
+#include "VocabularyBuilder.h"
+#include "Vocabulary.h"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <regex>
+#include <cctype>
+
+using namespace std;
+
+namespace {
+    // Dataset lines with empty lines, lines of a tag only, mixed case, punctuation and no final line break
+    string CreateText() {
+        string text;
+        for (unsigned int i = 0; i < 200; ++i) {
+            if (i % 37 == 5) {
+                text += "\n";
+                continue;
+            }
+            text += "_*" + to_string(i);
+            if (i % 41 == 7) {
+                text += "\n";
+                continue;
+            }
+            for (unsigned int j = 0; j < 3 + i % 11; ++j) {
+                text += j % 4 == 0 ? " W" : " w";
+                text += to_string((i * 31 + j * 17) % 60);
+                if (j % 5 == 2)
+                    text += ", x_" + to_string(j) + "!";
+            }
+            text += "\n";
+        }
+        return text + "_*last Tail words, TAIL";
+    }
+
+    // Parsing the old way: lines one by one, words of every line after its tag matched by \w+
+    // and added to vocabulary in text order
+    void ParseReference(const string& text, TVocabulary& vocabulary, vector<vector<uint32_t>>& lines) {
+        const regex wordRegex("\\w+");
+        size_t position = 0;
+        while (position <= text.size()) {
+            size_t lineEnd = text.find('\n', position);
+            if (lineEnd == string::npos)
+                lineEnd = text.size();
+            string line = text.substr(position, lineEnd - position);
+            lines.emplace_back();
+            size_t firstSpace = line.find(' ');
+            if (firstSpace != string::npos) {
+                string words = line.substr(firstSpace + 1);
+                for (sregex_iterator it(words.begin(), words.end(), wordRegex), end; it != end; ++it)
+                    lines.back().push_back(vocabulary.AddWord(it->str()));
+            }
+            if (lineEnd == text.size())
+                break;
+            position = lineEnd + 1;
+        }
+    }
+}
+
+// Every part count, more parts than lines included, gives the vocabulary, lines and tokens of serial parsing
+TEST(VocabularyBuilderMatchesSerialParsing) {
+    string text = CreateText();
+    TVocabulary reference;
+    vector<vector<uint32_t>> referenceLines;
+    ParseReference(text, reference, referenceLines);
+
+    for (size_t partNum : {1, 2, 3, 7, 16, 500}) {
+        TVocabularyBuilder builder(/*keepTokens*/ true);
+        builder.Parse(text.data(), text.size(), partNum);
+        ASSERT_EQUAL(builder.GetLineCount(), referenceLines.size());
+        TVocabulary vocabulary;
+        builder.Merge(vocabulary);
+        ASSERT_EQUAL(vocabulary.GetSize(), reference.GetSize());
+        ASSERT_EQUAL(vocabulary.GetTrainWordsCount(), reference.GetTrainWordsCount());
+        for (auto it = reference.Begin(); it != reference.End(); ++it) {
+            TWord word;
+            ASSERT(vocabulary.GetWord(it->first, word));
+            ASSERT_EQUAL(word.Index, it->second->Index);
+            ASSERT_EQUAL(word.Frequency, it->second->Frequency);
+        }
+
+        vector<uint32_t> tokens;
+        vector<uint64_t> offsets(1, 0);
+        builder.AppendTokens(tokens, offsets);
+        ASSERT_EQUAL(offsets.size(), referenceLines.size() + 1);
+        for (size_t line = 0; line < referenceLines.size(); ++line) {
+            ASSERT_EQUAL(offsets[line + 1] - offsets[line], referenceLines[line].size());
+            for (size_t i = 0; i < referenceLines[line].size(); ++i)
+                ASSERT_EQUAL(tokens[offsets[line] + i], referenceLines[line][i]);
+        }
+
+        // Sources point to lines without line breaks
+        vector<string> lines(builder.GetLineCount());
+        builder.ParallelForEachLine([&text, &lines](size_t line, const TDocumentSource& source, size_t) {
+            lines[line] = text.substr(source.Offset, source.Length);
+        });
+        size_t position = 0;
+        for (const string& line : lines) {
+            ASSERT_EQUAL(text.substr(position, line.size()), line);
+            position += line.size() + 1;
+        }
+        ASSERT_EQUAL(position, text.size() + 1);
+    }
+}
+
+namespace {
+    vector<shared_ptr<TDocument>> CreateDocuments(size_t num, size_t firstDuplicate, size_t secondDuplicate) {
+        vector<shared_ptr<TDocument>> docs;
+        for (size_t i = 0; i < num; ++i) {
+            size_t tag = i == secondDuplicate ? firstDuplicate : i;
+            docs.push_back(make_shared<TDocument>("_*" + to_string(tag) + " words", i));
+        }
+        return docs;
+    }
+
+    string GetAddError(TDocumentsHolder& holder, vector<shared_ptr<TDocument>>&& docs, bool parallel) {
+        try {
+            if (parallel) {
+                holder.AddDocuments(move(docs));
+            } else {
+                for (const auto& doc : docs)
+                    holder.AddDocument(doc);
+            }
+        } catch (const exception& e) {
+            return e.what();
+        }
+        return "";
+    }
+}
+
+// Documents added together get the tag index of documents added one by one
+TEST(DocumentTagIndexMatchesSerial) {
+    const size_t docNum = 1000;
+    TDocumentsHolder holder, reference;
+    ASSERT_EQUAL(GetAddError(holder, CreateDocuments(docNum, docNum, docNum), true), "");
+    ASSERT_EQUAL(GetAddError(reference, CreateDocuments(docNum, docNum, docNum), false), "");
+    ASSERT_EQUAL(holder.GetSize(), reference.GetSize());
+    for (size_t i = 0; i < docNum; ++i) {
+        TDocument doc, referenceDoc;
+        string tag = "_*" + to_string(i);
+        ASSERT(holder.GetDocument(tag, doc) && reference.GetDocument(tag, referenceDoc));
+        ASSERT_EQUAL(doc.GetIndex(), referenceDoc.GetIndex());
+        ASSERT_EQUAL(holder.GetDocument(i)->GetTag(), tag);
+    }
+    TDocument missing;
+    ASSERT(!holder.GetDocument("_*" + to_string(docNum), missing));
+}
+
+// The first repeated tag in document order is reported, as if documents were added one by one
+TEST(DocumentTagIndexReportsFirstDuplicate) {
+    for (size_t second : {1, 500, 999}) {
+        TDocumentsHolder holder, reference;
+        string error = GetAddError(holder, CreateDocuments(1000, second / 2, second), true);
+        ASSERT(!error.empty());
+        ASSERT_EQUAL(error, GetAddError(reference, CreateDocuments(1000, second / 2, second), false));
+    }
+    // Two duplicates: the one which repeats first in order wins, not the one of the lower shard
+    vector<shared_ptr<TDocument>> docs = CreateDocuments(1000, 10, 900);
+    docs[300] = make_shared<TDocument>("_*20 words", 300);
+    TDocumentsHolder holder;
+    ASSERT_EQUAL(GetAddError(holder, move(docs), true), "There are several documents with same tag <_*20>");
+}
+
+// Failed AddDocuments leaves the holder as it was, like a failed AddDocument
+TEST(DocumentTagIndexUnchangedOnDuplicate) {
+    TDocumentsHolder holder;
+    ASSERT_EQUAL(GetAddError(holder, CreateDocuments(10, 10, 10), true), "");
+    vector<shared_ptr<TDocument>> docs, duplicated;
+    for (size_t i = 10; i < 1010; ++i)
+        docs.push_back(make_shared<TDocument>("_*" + to_string(i + 1000) + " words", i));
+    duplicated = docs;
+    duplicated[700] = make_shared<TDocument>("_*1300 words", 700);
+    ASSERT(!GetAddError(holder, move(duplicated), true).empty());
+    ASSERT_EQUAL(holder.GetSize(), 10u);
+    for (size_t i = 0; i < 10; ++i) {
+        TDocument doc;
+        ASSERT(holder.GetDocument("_*" + to_string(i), doc));
+        ASSERT_EQUAL(doc.GetIndex(), i);
+    }
+    for (const auto& doc : docs) {
+        TDocument found;
+        ASSERT(!holder.GetDocument(doc->GetTag(), found));
+    }
+    // Tags of the failed call don't block adding the documents again
+    ASSERT_EQUAL(GetAddError(holder, move(docs), true), "");
+    ASSERT_EQUAL(holder.GetSize(), 1010u);
+}
@@ -0,0 +1,117 @@
+#include "Test.h"
+#include "Vocabulary.h"
+#include "Random.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+    // Uneven frequencies with ties, so that merges of equal counts are exercised
+    void FillVocabulary(TVocabulary& vocabulary, unsigned int wordNum) {
+        for (unsigned int i = 0; i < wordNum; ++i)
+            vocabulary.AddNormalizedWord("w" + to_string(i), 1 + (i * 7919) % 97 + (i % 5 == 0 ? 1000 : 0));
+    }
+}
+
+// Packed table has the codes and points of words built the old way, so hierarchical softmax
+// visits the same inner nodes with the same labels and trains the same weights
+TEST(HuffmanTableMatchesWordCodes) {
+    TVocabulary vocabulary;
+    const unsigned int wordNum = 300;
+    FillVocabulary(vocabulary, wordNum);
+    vocabulary.BuildHuffmanTree();
+    const THuffmanTable& table = vocabulary.GetHuffmanTable();
+    ASSERT_EQUAL(table.Size(), static_cast<size_t>(wordNum));
+
+    for (unsigned int i = 0; i < wordNum; ++i) {
+        TWord word;
+        ASSERT(vocabulary.GetWord(i, word));
+        ASSERT_EQUAL(table.GetCodeLength(i), word.Code.size());
+        ASSERT(table.GetCodeLength(i) > 0 && table.GetCodeLength(i) <= MAX_CODE_LENGTH);
+        for (size_t d = 0; d < word.Code.size(); ++d) {
+            ASSERT_EQUAL(static_cast<int>(table.GetCodes(i)[d]), word.Code[d]);
+            ASSERT_EQUAL(static_cast<int>(table.GetPoints(i)[d]), word.Point[d]);
+        }
+    }
+}
+
+// Codes form one binary tree: the root is the first point of every word, the same branch from the same
+// inner node leads to the same node and no code is a prefix of another
+TEST(HuffmanTableIsTree) {
+    TVocabulary vocabulary;
+    const unsigned int wordNum = 300;
+    FillVocabulary(vocabulary, wordNum);
+    vocabulary.BuildHuffmanTree();
+    const THuffmanTable& table = vocabulary.GetHuffmanTable();
+
+    // (inner node, branch) -> inner node, or word with -1 - index
+    map<pair<uint32_t, uint8_t>, long long> edges;
+    double kraftSum = 0;
+    for (unsigned int i = 0; i < wordNum; ++i) {
+        unsigned int length = table.GetCodeLength(i);
+        const uint8_t* codes = table.GetCodes(i);
+        const uint32_t* points = table.GetPoints(i);
+        ASSERT_EQUAL(points[0], wordNum - 2);
+        for (unsigned int d = 0; d < length; ++d) {
+            ASSERT(codes[d] <= 1);
+            ASSERT(points[d] < wordNum - 1);
+            long long next = d + 1 < length ? static_cast<long long>(points[d + 1]) : -1 - static_cast<long long>(i);
+            auto edge = edges.insert(make_pair(make_pair(points[d], codes[d]), next));
+            ASSERT_EQUAL(edge.first->second, next);
+        }
+        kraftSum += ldexp(1.0, -static_cast<int>(length));
+    }
+    // Every inner node has both branches
+    ASSERT_EQUAL(edges.size(), static_cast<size_t>(2 * (wordNum - 1)));
+    ASSERT_NEAR(kraftSum, 1.0, 1e-12);
+}
+
+// Keep probability of a word is the one the old per-token check compared with a uniform random number
+TEST(KeepThresholdsMatchOldSubsampling) {
+    TVocabulary vocabulary;
+    FillVocabulary(vocabulary, 300);
+    vocabulary.AddNormalizedWord("dominant", 1000000);
+    const double sample = 1e-3;
+    vocabulary.BuildKeepThresholds(sample);
+    const vector<uint32_t>& thresholds = vocabulary.GetKeepThresholds();
+    ASSERT_EQUAL(thresholds.size(), vocabulary.GetSize());
+
+    double total = sample * vocabulary.GetTrainWordsCount();
+    size_t subsampledNum = 0;
+    for (unsigned int i = 0; i < thresholds.size(); ++i) {
+        TWord word;
+        ASSERT(vocabulary.GetWord(i, word));
+        double oldKeep = (sqrt(word.Frequency / total) + 1) * total / word.Frequency;
+        // Token is kept when a 32 bit random number is not greater than threshold
+        double keep = (static_cast<double>(thresholds[i]) + 1) / 4294967296.0;
+        ASSERT_NEAR(keep, min(oldKeep, 1.0), 1.0 / 4294967296.0);
+        subsampledNum += oldKeep < 1;
+    }
+    // Both kinds of words are present
+    ASSERT(subsampledNum > 0 && subsampledNum < thresholds.size());
+
+    TFastRandom random(1);
+    unsigned int dominant;
+    ASSERT(vocabulary.GetNormalizedWordIndex("dominant", dominant));
+    const int drawNum = 1000000;
+    int keptNum = 0;
+    for (int i = 0; i < drawNum; ++i)
+        keptNum += random.Next() <= thresholds[dominant];
+    double keep = (static_cast<double>(thresholds[dominant]) + 1) / 4294967296.0;
+    ASSERT_NEAR(keptNum, drawNum * keep, 5 * sqrt(drawNum * keep * (1 - keep)));
+}
+
+TEST(KeepThresholdsWithoutSubsampling) {
+    TVocabulary vocabulary;
+    FillVocabulary(vocabulary, 10);
+    vocabulary.BuildKeepThresholds(0);
+    for (uint32_t threshold : vocabulary.GetKeepThresholds())
+        ASSERT_EQUAL(threshold, UINT32_MAX);
+}